@@ -0,0 +1,121 @@
+// Command latency while discovery keeps republishing the UDN cache.
+//
+//   adapter_resolve_bench [command-threads] [seconds] [devices] [list-ms] 2>/dev/null
+//
+// Runs the OpenWemo adapter against the in-process fake engine.  Command
+// threads send SetOnOff() to random devices back to back while another
+// thread runs Discover() in a loop, each pass taking list-ms in the engine.
+// Every command resolves its device through the published snapshots, so a
+// slow or blocking resolve shows up as command latency.  A command that did
+// not resolve counts as a miss; there should be none.  The adapter logs
+// every engine call on stderr, hence the redirect.
+
+#include "fake_wemo_engine/fake_wemo_engine.h"
+#include "wemo_bridge/wemo_adapter_openwemo.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+std::string Udn(int i)
+{
+    return "uuid:Lightswitch-1_0-" + std::to_string(100000 + i);
+}
+
+} // namespace
+
+int main(int argc, char ** argv)
+{
+    const int threads = (argc > 1) ? std::atoi(argv[1]) : 16;
+    const int seconds = (argc > 2) ? std::atoi(argv[2]) : 2;
+    const int devices = (argc > 3) ? std::atoi(argv[3]) : 64;
+    const int listMs  = (argc > 4) ? std::atoi(argv[4]) : 1;
+    if (threads <= 0 || seconds <= 0 || devices <= 0 || devices > 64 || listMs < 0)
+    {
+        std::fprintf(stderr, "usage: %s [command-threads] [seconds] [devices (1-64)] [list-ms]\n", argv[0]);
+        return 2;
+    }
+
+    std::vector<std::pair<std::string, int>> listed;
+    std::vector<std::string> udns;
+    for (int i = 0; i < devices; i++)
+    {
+        listed.emplace_back(Udn(i), i + 1);
+        udns.push_back(Udn(i));
+    }
+    fake_wemo_engine::SetDevices(listed);
+    fake_wemo_engine::SetListDelay(std::chrono::milliseconds(listMs));
+
+    wemo_bridge::WemoAdapterOpenWemo adapter("127.0.0.1:49153");
+    adapter.SetCommandRateLimit(0, 1);
+    adapter.Discover();
+    const auto handles = adapter.ResolveMany(udns);
+
+    std::atomic<bool> stop { false };
+    std::atomic<long> passes { 0 };
+    std::thread discovery([&] {
+        while (!stop.load())
+        {
+            adapter.Discover();
+            passes++;
+        }
+    });
+
+    std::vector<std::vector<double>> latencies(static_cast<size_t>(threads));
+    std::atomic<long> misses { 0 };
+    std::vector<std::thread> commanders;
+    for (int t = 0; t < threads; t++)
+    {
+        commanders.emplace_back([&, t] {
+            std::mt19937 rng(static_cast<unsigned>(t));
+            auto & mine = latencies[static_cast<size_t>(t)];
+            while (!stop.load())
+            {
+                const auto device = handles[rng() % handles.size()];
+                const auto start  = Clock::now();
+                const auto result = adapter.SetOnOff(device, (rng() & 1) != 0);
+                mine.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+                if (result.status == wemo_bridge::CommandStatus::kUnresolved)
+                {
+                    misses++;
+                }
+            }
+        });
+    }
+
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    stop = true;
+    for (auto & commander : commanders)
+    {
+        commander.join();
+    }
+    discovery.join();
+    adapter.Shutdown();
+
+    std::vector<double> all;
+    for (const auto & mine : latencies)
+    {
+        all.insert(all.end(), mine.begin(), mine.end());
+    }
+    std::sort(all.begin(), all.end());
+    const auto at = [&](double p) {
+        return all.empty() ? 0.0 : all[std::min(all.size() - 1, static_cast<size_t>(p * static_cast<double>(all.size())))];
+    };
+
+    std::printf("%d command threads, %d devices, %d ms list, %d s\n", threads, devices, listMs, seconds);
+    std::printf("discovery passes %ld  commands %zu (%.0f/s)  misses %ld\n", passes.load(), all.size(),
+                static_cast<double>(all.size()) / seconds, misses.load());
+    std::printf("command latency p50 %.1f us  p99 %.1f us  max %.1f us\n", at(0.50), at(0.99), all.empty() ? 0.0 : all.back());
+    return 0;
+}
@@ -0,0 +1,114 @@
+// Wall time of a scene-style batch: one command per device, sent one after
+// another versus ApplyBatch() on the adapter's worker pool.
+//
+//   apply_batch_bench [devices] [rtt-ms] [workers...] 2>/dev/null
+//
+// Runs the OpenWemo adapter against the in-process fake engine with the
+// rate limit disabled.  Every device gets an OnOff command and device 0 also
+// gets a level command, so its strand needs two round trips.  The adapter
+// logs every engine call on stderr, hence the redirect.
+
+#include "fake_wemo_engine/fake_wemo_engine.h"
+#include "wemo_bridge/wemo_adapter_openwemo.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+std::string Udn(int i)
+{
+    return "uuid:Lightswitch-1_0-" + std::to_string(100000 + i);
+}
+
+std::vector<wemo_bridge::DeviceCommand> MakeScene(wemo_bridge::WemoAdapterOpenWemo & adapter, int devices)
+{
+    std::vector<std::string> udns;
+    for (int i = 0; i < devices; i++)
+    {
+        udns.push_back(Udn(i));
+    }
+    adapter.Discover();
+    std::vector<wemo_bridge::DeviceCommand> scene;
+    for (const auto & handle : adapter.ResolveMany(udns))
+    {
+        scene.push_back(wemo_bridge::DeviceCommand::OnOff(handle, true));
+    }
+    scene.push_back(wemo_bridge::DeviceCommand::Level(scene.front().device, 60));
+    return scene;
+}
+
+void Report(const char * label, Clock::time_point start, const std::vector<wemo_bridge::CommandResult> & results)
+{
+    const auto ok = std::count_if(results.begin(), results.end(), [](const auto & result) { return result.Succeeded(); });
+    std::printf("%-20s %6lld ms  %ld/%zu ok\n", label,
+                static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count()),
+                static_cast<long>(ok), results.size());
+}
+
+} // namespace
+
+int main(int argc, char ** argv)
+{
+    const int devices = (argc > 1) ? std::atoi(argv[1]) : 40;
+    const int rttMs   = (argc > 2) ? std::atoi(argv[2]) : 30;
+    std::vector<size_t> workerCounts;
+    for (int i = 3; i < argc; i++)
+    {
+        workerCounts.push_back(static_cast<size_t>(std::atoi(argv[i])));
+    }
+    if (workerCounts.empty())
+    {
+        workerCounts = { wemo_bridge::CommandExecutor::kDefaultWorkerCount, static_cast<size_t>(devices) };
+    }
+    if (devices <= 0 || devices > 64 || rttMs < 0 ||
+        std::find(workerCounts.begin(), workerCounts.end(), size_t { 0 }) != workerCounts.end())
+    {
+        std::fprintf(stderr, "usage: %s [devices (1-64)] [rtt-ms] [workers...]\n", argv[0]);
+        return 2;
+    }
+
+    std::vector<std::pair<std::string, int>> listed;
+    for (int i = 0; i < devices; i++)
+    {
+        listed.emplace_back(Udn(i), i + 1);
+    }
+    fake_wemo_engine::SetDevices(listed);
+    fake_wemo_engine::SetActionDelay(std::chrono::milliseconds(rttMs));
+    std::printf("%d devices plus one extra command on device 0, %d ms round trip\n", devices, rttMs);
+
+    {
+        wemo_bridge::WemoAdapterOpenWemo adapter("127.0.0.1:49153");
+        adapter.SetCommandRateLimit(0, 1);
+        const auto scene = MakeScene(adapter, devices);
+        const auto start = Clock::now();
+        std::vector<wemo_bridge::CommandResult> results;
+        for (const auto & command : scene)
+        {
+            results.push_back(adapter.Apply(command));
+        }
+        Report("sequential", start, results);
+    }
+
+    for (const size_t workers : workerCounts)
+    {
+        wemo_bridge::WemoAdapterOpenWemo adapter("127.0.0.1:49153");
+        adapter.SetCommandRateLimit(0, 1);
+        adapter.SetCommandConcurrency(workers);
+        const auto scene   = MakeScene(adapter, devices);
+        const auto start   = Clock::now();
+        const auto results = adapter.ApplyBatch(scene);
+        char label[32];
+        std::snprintf(label, sizeof(label), "batch, %zu workers", workers);
+        Report(label, start, results);
+        adapter.Shutdown();
+    }
+    return 0;
+}
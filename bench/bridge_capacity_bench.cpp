@@ -0,0 +1,217 @@
+// Memory and full-read cost of the per-light bridge state at a given
+// device capacity.
+//
+//   bridge_capacity_bench [reads] [capacity...]
+//
+// Each capacity runs in a forked child so it starts from the same RSS.  The
+// child builds what the bridge keeps per light: the core tables
+// (EndpointSlots, DirtyAttributeSet, LightStateTable, WemoEventRing), a
+// slab-allocated entry shaped like BridgedWemoLight with its DataVersion
+// array, a stand-in Device block, and the wemo id and UDN indexes.  The
+// Matter SDK's own endpoint tables are not included.  It then reports RSS
+// above the starting point and the time to encode every light's OnOff,
+// CurrentLevel and Reachable attributes into 1 KiB report chunks, the shape
+// of a wildcard read.
+
+#include "wemo_bridge/dirty_attribute_set.h"
+#include "wemo_bridge/endpoint_slots.h"
+#include "wemo_bridge/light_state_table.h"
+#include "wemo_bridge/slab_pool.h"
+#include "wemo_bridge/wemo_event_ring.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t kChunkBytes      = 1024;
+constexpr size_t kBridgedClusters = 4;   // OnOff, LevelControl, Descriptor, BridgedDeviceBasicInformation
+constexpr size_t kDeviceBytes     = 256; // estimate for DeviceDimmable, whose size needs the SDK headers
+
+// Same fields as BridgedWemoLight in matter-bridge-app/main.cpp.
+struct Light
+{
+    uint32_t position = 0;
+    int wemo_id       = 0;
+    std::string udn;
+    uint32_t handle  = 0;
+    bool is_dimmable = false;
+    void * device    = nullptr;
+    std::array<uint32_t, kBridgedClusters> dataVersions {};
+    Clock::time_point missing_since {};
+    uint8_t failed_commands = 0;
+};
+
+struct DeviceBlock
+{
+    unsigned char bytes[kDeviceBytes];
+};
+
+long RssKiB()
+{
+    long pages   = 0;
+    long rss     = 0;
+    FILE * statm = std::fopen("/proc/self/statm", "r");
+    if (statm != nullptr)
+    {
+        if (std::fscanf(statm, "%ld %ld", &pages, &rss) != 2)
+        {
+            rss = 0;
+        }
+        std::fclose(statm);
+    }
+    return rss * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+// Encodes every light's attributes into 1 KiB chunks; returns the chunk count.
+size_t EncodeAll(const std::vector<Light *> & lights, const wemo_bridge::LightStateTable & state)
+{
+    char chunk[kChunkBytes];
+    size_t used   = 0;
+    size_t chunks = 1;
+    for (const Light * light : lights)
+    {
+        const uint32_t word = state.state[light->position];
+        char report[96];
+        const int length    = std::snprintf(report, sizeof(report), "ep%u/6/0=%d;ep%u/8/0=%d;ep%u/57/17=%d;",
+                                            light->position + 2, (word & wemo_bridge::kLightOnBit) ? 1 : 0,
+                                            light->position + 2, wemo_bridge::LightLevel(word), light->position + 2,
+                                            (word & wemo_bridge::kLightReachableBit) ? 1 : 0);
+        const size_t size   = static_cast<size_t>(length);
+        if (used + size > kChunkBytes)
+        {
+            chunks++;
+            used = 0;
+        }
+        std::memcpy(chunk + used, report, size);
+        used += size;
+    }
+    return chunks;
+}
+
+// Builds the tables for `capacity` lights and, when print is set, reports
+// them.
+void Run(size_t capacity, int reads, bool print)
+{
+    const long rssBefore = RssKiB();
+
+    wemo_bridge::EndpointSlots slots(capacity);
+    wemo_bridge::DirtyAttributeSet dirty(capacity, [] {});
+    wemo_bridge::LightStateTable state;
+    state.Resize(capacity);
+    wemo_bridge::WemoEventRing events(capacity, [] {});
+    wemo_bridge::SlabPoolFor<Light> lightPool;
+    wemo_bridge::SlabPoolFor<DeviceBlock> devicePool;
+    std::vector<wemo_bridge::SlabPtr<Light>> entries;
+    std::vector<Light *> byEndpointIndex(capacity, nullptr);
+    std::vector<uint32_t> byWemoId;
+    std::vector<uint32_t> byHandle;
+    std::unordered_map<std::string, uint32_t> byUdn;
+
+    for (size_t i = 0; i < capacity; i++)
+    {
+        auto light         = wemo_bridge::MakeInSlab<Light>(lightPool);
+        light->position    = static_cast<uint32_t>(i);
+        light->wemo_id     = static_cast<int>(i);
+        light->udn         = "uuid:Dimmer-1_0-" + std::to_string(221500000000 + i);
+        light->handle      = static_cast<uint32_t>(i);
+        light->is_dimmable = true;
+        light->device      = std::memset(devicePool.Allocate(), 0, sizeof(DeviceBlock));
+        state.state[i]     = wemo_bridge::PackLightState(true, (i & 1) != 0, static_cast<uint8_t>(i % 255));
+
+        const uint16_t slot   = slots.Acquire(light.get());
+        byEndpointIndex[slot] = light.get();
+        byWemoId.push_back(static_cast<uint32_t>(i));
+        byHandle.push_back(static_cast<uint32_t>(i));
+        byUdn.emplace(light->udn, static_cast<uint32_t>(i));
+        dirty.Mark(slot, 0x01);
+        events.Publish(wemo_bridge::WemoStateEvent { light->wemo_id, true, 1, 50 });
+        entries.push_back(std::move(light));
+    }
+    dirty.Flush([](size_t, uint8_t) {});
+    events.Drain([](const wemo_bridge::WemoStateEvent &) {});
+
+    const long rssAfter = RssKiB();
+
+    std::vector<Light *> lights;
+    for (Light * light : byEndpointIndex)
+    {
+        if (light != nullptr)
+        {
+            lights.push_back(light);
+        }
+    }
+    std::vector<double> us;
+    size_t chunks = 0;
+    for (int r = 0; r < reads; r++)
+    {
+        const auto start = Clock::now();
+        chunks           = EncodeAll(lights, state);
+        us.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+    }
+    std::sort(us.begin(), us.end());
+    if (!print)
+    {
+        return;
+    }
+
+    std::printf("n=%5zu  rss %+6ld KiB (%4.2f KiB per light)  %4zu chunks  read p50 %7.1f us  p99 %7.1f us\n", capacity,
+                rssAfter - rssBefore, static_cast<double>(rssAfter - rssBefore) / static_cast<double>(capacity), chunks,
+                us[us.size() / 2], us[std::min(us.size() - 1, us.size() * 99 / 100)]);
+}
+
+} // namespace
+
+int main(int argc, char ** argv)
+{
+    const int reads = (argc > 1) ? std::atoi(argv[1]) : 1000;
+    std::vector<size_t> capacities;
+    for (int i = 2; i < argc; i++)
+    {
+        capacities.push_back(static_cast<size_t>(std::atol(argv[i])));
+    }
+    if (capacities.empty())
+    {
+        capacities = { 16, 64, 256, 1024 };
+    }
+    if (reads <= 0 || std::find(capacities.begin(), capacities.end(), size_t { 0 }) != capacities.end() ||
+        *std::max_element(capacities.begin(), capacities.end()) > 65000)
+    {
+        std::fprintf(stderr, "usage: %s [reads] [capacity (1-65000)...]\n", argv[0]);
+        return 2;
+    }
+
+    for (const size_t capacity : capacities)
+    {
+        std::fflush(stdout);
+        const pid_t child = fork();
+        if (child == 0)
+        {
+            // A first pass with one light pages in the code and the malloc
+            // arena, so RSS only grows by what the lights cost.
+            Run(1, 1, false);
+            Run(capacity, reads, true);
+            std::fflush(stdout);
+            _exit(0);
+        }
+        int status = 0;
+        if (child < 0 || waitpid(child, &status, 0) != child || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            std::fprintf(stderr, "run for capacity %zu failed\n", capacity);
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,154 @@
+// Startup preparation of bridged lights: one device at a time versus the
+// pipelined bulk path of PrepareWemoLights().
+//
+//   bulk_prepare_bench [devices] [runs] [dir]
+//
+// For every UDN the bridge needs an endpoint id from the registry, a command
+// handle from the adapter and a Device.  "sequential" does all three per
+// device: GetOrAssign(), Resolve() and a Device allocation.  "pipelined" does
+// what the bridge now does: GetOrAssignMany() on a helper thread while the
+// calling thread runs ResolveMany() and builds the Devices.  The adapter runs
+// against the in-process fake engine and the Device is a stand-in block from
+// a SlabPool, since the real one needs the Matter SDK.  "cold" starts from an
+// empty registry, "warm" from one that already maps every UDN; each run gets
+// a fresh adapter, as after a restart.  Endpoint registration itself needs
+// the SDK and is not measured.
+
+#include "wemo_bridge/endpoint_registry.h"
+#include "wemo_bridge/endpoint_store.h"
+#include "wemo_bridge/slab_pool.h"
+#include "wemo_bridge/wemo_adapter_openwemo.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct DeviceBlock
+{
+    char name[64];
+    char location[64];
+    unsigned char state[128];
+};
+
+using DevicePool = wemo_bridge::SlabPoolFor<DeviceBlock>;
+
+std::string Udn(int i)
+{
+    return "uuid:Lightswitch-1_0-" + std::to_string(100000 + i);
+}
+
+wemo_bridge::SlabPtr<DeviceBlock> MakeDevice(DevicePool & pool, int i)
+{
+    auto device = wemo_bridge::MakeInSlab<DeviceBlock>(pool);
+    std::snprintf(device->name, sizeof(device->name), "WeMo Light %d", i);
+    std::snprintf(device->location, sizeof(device->location), "Home");
+    return device;
+}
+
+double Sequential(wemo_bridge::EndpointRegistry & registry, const std::vector<std::string> & udns)
+{
+    wemo_bridge::WemoAdapterOpenWemo adapter("127.0.0.1:49153");
+    DevicePool pool;
+    std::vector<wemo_bridge::SlabPtr<DeviceBlock>> devices;
+
+    const auto start = Clock::now();
+    for (size_t i = 0; i < udns.size(); i++)
+    {
+        if (!registry.GetOrAssign(udns[i]).has_value() || !adapter.Resolve(udns[i]).IsValid())
+        {
+            std::fprintf(stderr, "prepare failed for %s\n", udns[i].c_str());
+            std::exit(1);
+        }
+        devices.push_back(MakeDevice(pool, static_cast<int>(i)));
+    }
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+double Pipelined(wemo_bridge::EndpointRegistry & registry, const std::vector<std::string> & udns)
+{
+    wemo_bridge::WemoAdapterOpenWemo adapter("127.0.0.1:49153");
+    DevicePool pool;
+    std::vector<wemo_bridge::SlabPtr<DeviceBlock>> devices;
+
+    const auto start = Clock::now();
+    std::vector<std::optional<uint16_t>> endpointIds;
+    std::thread ids([&] { endpointIds = registry.GetOrAssignMany(udns); });
+    const auto handles = adapter.ResolveMany(udns);
+    for (size_t i = 0; i < udns.size(); i++)
+    {
+        devices.push_back(MakeDevice(pool, static_cast<int>(i)));
+    }
+    ids.join();
+    const double us = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+
+    if (endpointIds.size() != udns.size() ||
+        std::any_of(endpointIds.begin(), endpointIds.end(), [](const auto & id) { return !id.has_value(); }) ||
+        std::any_of(handles.begin(), handles.end(), [](const auto & handle) { return !handle.IsValid(); }))
+    {
+        std::fprintf(stderr, "bulk prepare failed\n");
+        std::exit(1);
+    }
+    return us;
+}
+
+void Report(const char * label, std::vector<double> & us)
+{
+    std::sort(us.begin(), us.end());
+    std::printf("  %-11s min %8.1f us  median %8.1f us  max %8.1f us\n", label, us.front(), us[us.size() / 2], us.back());
+}
+
+} // namespace
+
+int main(int argc, char ** argv)
+{
+    const int devices     = (argc > 1) ? std::atoi(argv[1]) : 100;
+    const int runs        = (argc > 2) ? std::atoi(argv[2]) : 5;
+    const std::string dir = (argc > 3) ? argv[3] : std::filesystem::temp_directory_path().string();
+    if (devices <= 0 || devices > 30000 || runs <= 0)
+    {
+        std::fprintf(stderr, "usage: %s [devices (1-30000)] [runs] [dir]\n", argv[0]);
+        return 2;
+    }
+
+    std::vector<std::string> udns;
+    for (int i = 0; i < devices; i++)
+    {
+        udns.push_back(Udn(i));
+    }
+    const std::string path = dir + "/bulk_prepare_bench.sqlite3";
+
+    std::printf("%d devices, %d runs\n", devices, runs);
+    for (const bool warm : { false, true })
+    {
+        std::vector<double> sequential;
+        std::vector<double> pipelined;
+        for (int r = 0; r < runs; r++)
+        {
+            for (const bool bulk : { false, true })
+            {
+                std::error_code ec;
+                std::filesystem::remove(path, ec);
+                wemo_bridge::EndpointRegistry registry(wemo_bridge::MakeEndpointStore(path));
+                if (warm)
+                {
+                    registry.GetOrAssignMany(udns);
+                }
+                (bulk ? pipelined : sequential).push_back(bulk ? Pipelined(registry, udns) : Sequential(registry, udns));
+            }
+        }
+        std::printf("%s registry\n", warm ? "warm" : "cold");
+        Report("sequential", sequential);
+        Report("pipelined", pipelined);
+    }
+    return 0;
+}
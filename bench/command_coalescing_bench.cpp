@@ -0,0 +1,123 @@
+// IPC calls and settle time for a brightness drag on one dimmer.
+//
+//   command_coalescing_bench [writes] [drag-ms] [rtt-ms]
+//
+// Runs the OpenWemo adapter against the in-process fake engine.  The drag
+// sends `writes` evenly spaced level writes, ending at 100%, and each engine
+// call takes the simulated round trip.  Compared:
+//   - fifo: every write sent in order on one strand, no coalescing or pacing
+//   - latest-wins: SetLevelPercentAsync() with the rate limit disabled
+//   - latest-wins + bucket: SetLevelPercentAsync() with the default limit
+// "settled" is when the last write's command finished, i.e. when the device
+// reached the final level.  The adapter logs every engine call on stderr.
+
+#include "fake_wemo_engine/fake_wemo_engine.h"
+#include "wemo_bridge/command_executor.h"
+#include "wemo_bridge/wemo_adapter_openwemo.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const char kUdn[] = "uuid:Dimmer-1_0-100000";
+
+enum class Mode
+{
+    kFifo,
+    kLatestWins,
+    kLatestWinsBucket,
+};
+
+uint8_t LevelAt(int i, int writes)
+{
+    return static_cast<uint8_t>(100 * (i + 1) / writes);
+}
+
+void Run(const char * label, Mode mode, int writes, int dragMs)
+{
+    wemo_bridge::WemoAdapterOpenWemo adapter("127.0.0.1:49153");
+    if (mode != Mode::kLatestWinsBucket)
+    {
+        adapter.SetCommandRateLimit(0, 1);
+    }
+    adapter.Discover();
+    const auto device = adapter.Resolve(kUdn);
+    fake_wemo_engine::ResetCounters();
+
+    std::mutex mutex;
+    std::condition_variable done;
+    int finished = 0;
+    Clock::time_point settled;
+    auto onDone = [&](bool last) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (last)
+        {
+            settled = Clock::now();
+        }
+        if (++finished == writes)
+        {
+            done.notify_all();
+        }
+    };
+
+    wemo_bridge::CommandExecutor fifo(1);
+    const auto start = Clock::now();
+    for (int i = 0; i < writes; i++)
+    {
+        std::this_thread::sleep_until(start + std::chrono::milliseconds(dragMs) * i / writes);
+        const uint8_t level = LevelAt(i, writes);
+        const bool last     = (i == writes - 1);
+        if (mode == Mode::kFifo)
+        {
+            fifo.TrySubmit(0, [&, level, last] {
+                adapter.SetLevelPercent(device, level);
+                onDone(last);
+            });
+        }
+        else
+        {
+            adapter.SetLevelPercentAsync(device, level, [&, last](const wemo_bridge::CommandResult &) { onDone(last); });
+        }
+    }
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [&] { return finished == writes; });
+    }
+    fifo.Shutdown();
+    adapter.Shutdown();
+
+    const auto levels = fake_wemo_engine::ActionLevels();
+    std::printf("%-22s IPC calls %3zu  final level %3d  settled at %5lld ms\n", label, levels.size(),
+                levels.empty() ? -1 : levels.back(),
+                static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(settled - start).count()));
+}
+
+} // namespace
+
+int main(int argc, char ** argv)
+{
+    const int writes = (argc > 1) ? std::atoi(argv[1]) : 50;
+    const int dragMs = (argc > 2) ? std::atoi(argv[2]) : 1000;
+    const int rttMs  = (argc > 3) ? std::atoi(argv[3]) : 30;
+    if (writes <= 0 || dragMs < 0 || rttMs < 0)
+    {
+        std::fprintf(stderr, "usage: %s [writes] [drag-ms] [rtt-ms]\n", argv[0]);
+        return 2;
+    }
+
+    fake_wemo_engine::SetDevices({ { kUdn, 1 } });
+    fake_wemo_engine::SetActionDelay(std::chrono::milliseconds(rttMs));
+    std::printf("%d level writes over %d ms, %d ms round trip\n", writes, dragMs, rttMs);
+
+    Run("fifo", Mode::kFifo, writes, dragMs);
+    Run("latest-wins", Mode::kLatestWins, writes, dragMs);
+    Run("latest-wins + bucket", Mode::kLatestWinsBucket, writes, dragMs);
+    return 0;
+}
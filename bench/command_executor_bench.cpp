@@ -0,0 +1,137 @@
+// Dispatch latency of CommandExecutor under a steady write rate.
+//
+//   command_executor_bench [writes-per-second] [seconds] [devices] [rtt-ms] [workers]
+//
+// Writes are spread round-robin over the devices and each one sleeps for the
+// simulated engine round trip.  Dispatch latency is the time from submission
+// to the task starting.  The same load is also run the old way, one detached
+// thread per write, for comparison.  workers 0 runs only the thread baseline.
+
+#include "wemo_bridge/command_executor.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Result
+{
+    std::vector<double> dispatchUs;
+    size_t rejected    = 0;
+    size_t threads     = 0;
+    double wallSeconds = 0;
+};
+
+double Percentile(std::vector<double> & values, double p)
+{
+    if (values.empty())
+    {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, static_cast<size_t>(p * static_cast<double>(values.size())))];
+}
+
+// Calls submit(device, task) for every write at a fixed pace and waits for
+// every accepted task to finish.
+template <typename SubmitFn>
+Result Drive(int rate, int seconds, int devices, int rttMs, SubmitFn submit)
+{
+    Result result;
+    std::mutex mutex;
+    std::condition_variable done;
+    size_t outstanding = 0;
+    const int writes   = rate * seconds;
+    result.dispatchUs.reserve(static_cast<size_t>(writes));
+
+    const auto start = Clock::now();
+    for (int i = 0; i < writes; i++)
+    {
+        std::this_thread::sleep_until(start + std::chrono::microseconds(1000000LL * i / rate));
+        const auto submitted = Clock::now();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            outstanding++;
+        }
+        const bool accepted = submit(static_cast<uint64_t>(i % devices), [&, submitted] {
+            const double us = std::chrono::duration<double, std::micro>(Clock::now() - submitted).count();
+            std::this_thread::sleep_for(std::chrono::milliseconds(rttMs));
+            std::lock_guard<std::mutex> lock(mutex);
+            result.dispatchUs.push_back(us);
+            if (--outstanding == 0)
+            {
+                done.notify_all();
+            }
+        });
+        if (!accepted)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            outstanding--;
+            result.rejected++;
+        }
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [&] { return outstanding == 0; });
+    result.wallSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return result;
+}
+
+void Print(const char * label, Result & result)
+{
+    const double p50 = Percentile(result.dispatchUs, 0.50);
+    const double p99 = Percentile(result.dispatchUs, 0.99);
+    const double max = result.dispatchUs.empty() ? 0 : result.dispatchUs.back();
+    std::printf("%-22s threads %6zu  ran %6zu  rejected %5zu  dispatch p50 %8.1f us  p99 %9.1f us  max %9.1f us  "
+                "wall %.2f s\n",
+                label, result.threads, result.dispatchUs.size(), result.rejected, p50, p99, max, result.wallSeconds);
+}
+
+} // namespace
+
+int main(int argc, char ** argv)
+{
+    const int rate    = (argc > 1) ? std::atoi(argv[1]) : 500;
+    const int seconds = (argc > 2) ? std::atoi(argv[2]) : 4;
+    const int devices = (argc > 3) ? std::atoi(argv[3]) : 20;
+    const int rttMs   = (argc > 4) ? std::atoi(argv[4]) : 8;
+    const int workers = (argc > 5) ? std::atoi(argv[5]) : static_cast<int>(wemo_bridge::CommandExecutor::kDefaultWorkerCount);
+    if (rate <= 0 || seconds <= 0 || devices <= 0 || rttMs < 0 || workers < 0)
+    {
+        std::fprintf(stderr, "usage: %s [writes-per-second] [seconds] [devices] [rtt-ms] [workers]\n", argv[0]);
+        return 2;
+    }
+
+    std::printf("%d writes/s for %d s over %d devices, %d ms round trip\n", rate, seconds, devices, rttMs);
+
+    size_t spawned  = 0;
+    Result detached = Drive(rate, seconds, devices, rttMs, [&](uint64_t, std::function<void()> task) {
+        std::thread(std::move(task)).detach();
+        spawned++;
+        return true;
+    });
+    detached.threads = spawned;
+    Print("detached threads", detached);
+
+    if (workers > 0)
+    {
+        wemo_bridge::CommandExecutor executor(static_cast<size_t>(workers));
+        Result pooled = Drive(rate, seconds, devices, rttMs, [&](uint64_t device, std::function<void()> task) {
+            return executor.TrySubmit(device, std::move(task));
+        });
+        executor.Shutdown();
+        pooled.threads = static_cast<size_t>(workers);
+        char label[32];
+        std::snprintf(label, sizeof(label), "executor, %d workers", workers);
+        Print(label, pooled);
+    }
+    return 0;
+}
@@ -0,0 +1,181 @@
+// Attribute-change reporting for a burst in which every dimmer changes
+// OnOff and CurrentLevel: one allocated loop task per change versus
+// DirtyAttributeSet.
+//
+//   dirty_attribute_bench [bursts] [lights...]
+//
+// The Matter event loop is a stand-in queue of work items run after the
+// burst.  "per-change" allocates a context and schedules a task for every
+// attribute change, as the bridge used to; "dirty set" marks bits and lets
+// the set schedule one flush that reports every marked slot.  Reports heap
+// allocations and loop tasks per dimmer and the time per dimmer for marking
+// and running the tasks, averaged over the bursts.
+
+#include "wemo_bridge/dirty_attribute_set.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+std::atomic<long> gAllocations { 0 };
+
+constexpr uint8_t kOnOffBit = 0x01;
+constexpr uint8_t kLevelBit = 0x02;
+
+struct EventLoop
+{
+    std::deque<std::function<void()>> queue;
+    long tasks = 0;
+
+    void Schedule(std::function<void()> work) { queue.push_back(std::move(work)); }
+
+    void RunAll()
+    {
+        while (!queue.empty())
+        {
+            auto work = std::move(queue.front());
+            queue.pop_front();
+            tasks++;
+            work();
+        }
+    }
+};
+
+struct ChangeContext
+{
+    uint16_t endpoint;
+    uint8_t attribute;
+};
+
+struct Result
+{
+    double allocations = 0;
+    double tasks       = 0;
+    double ns          = 0;
+};
+
+// Runs `bursts` bursts through burst(loop, reported) and returns per-dimmer
+// averages.  reported counts attribute reports.
+template <typename BurstFn>
+Result Measure(size_t lights, int bursts, BurstFn burst)
+{
+    EventLoop loop;
+    long reported = 0;
+    burst(loop, reported); // warm up: queue nodes, first flush
+    loop.RunAll();
+    loop.tasks = 0;
+    reported   = 0;
+
+    const long before = gAllocations.load();
+    const auto start  = Clock::now();
+    for (int b = 0; b < bursts; b++)
+    {
+        burst(loop, reported);
+        loop.RunAll();
+    }
+    const double elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    if (reported != static_cast<long>(2 * lights) * bursts)
+    {
+        std::fprintf(stderr, "reported %ld of %ld changes\n", reported, static_cast<long>(2 * lights) * bursts);
+        std::exit(1);
+    }
+
+    const double perDimmer = static_cast<double>(lights) * bursts;
+    Result result;
+    result.allocations = static_cast<double>(gAllocations.load() - before) / perDimmer;
+    result.tasks       = static_cast<double>(loop.tasks) / perDimmer;
+    result.ns          = elapsed / perDimmer;
+    return result;
+}
+
+} // namespace
+
+void * operator new(size_t size)
+{
+    gAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void * p = std::malloc(size ? size : 1))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void * p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void * p, size_t) noexcept
+{
+    std::free(p);
+}
+
+int main(int argc, char ** argv)
+{
+    const int bursts = (argc > 1) ? std::atoi(argv[1]) : 200;
+    std::vector<size_t> counts;
+    for (int i = 2; i < argc; i++)
+    {
+        counts.push_back(static_cast<size_t>(std::atol(argv[i])));
+    }
+    if (counts.empty())
+    {
+        counts = { 16, 256, 4096 };
+    }
+    for (const size_t lights : counts)
+    {
+        if (bursts <= 0 || lights == 0 || lights > UINT16_MAX)
+        {
+            std::fprintf(stderr, "usage: %s [bursts] [lights (1-65535)...]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    std::printf("%d bursts, every dimmer changes OnOff and CurrentLevel; per dimmer:\n", bursts);
+    for (const size_t lights : counts)
+    {
+        const Result perChange = Measure(lights, bursts, [&](EventLoop & loop, long & reported) {
+            for (size_t i = 0; i < lights; i++)
+            {
+                for (const uint8_t attribute : { kOnOffBit, kLevelBit })
+                {
+                    auto context = std::make_unique<ChangeContext>(ChangeContext { static_cast<uint16_t>(i), attribute });
+                    loop.Schedule([&reported, ctx = context.release()] {
+                        reported++;
+                        delete ctx;
+                    });
+                }
+            }
+        });
+
+        EventLoop * current = nullptr;
+        long * counter      = nullptr;
+        wemo_bridge::DirtyAttributeSet dirty(lights, [&] { current->Schedule([&] {
+            dirty.Flush([&](size_t, uint8_t bits) { *counter += ((bits & kOnOffBit) ? 1 : 0) + ((bits & kLevelBit) ? 1 : 0); });
+        }); });
+        const Result dirtySet = Measure(lights, bursts, [&](EventLoop & loop, long & reported) {
+            current = &loop;
+            counter = &reported;
+            for (size_t i = 0; i < lights; i++)
+            {
+                dirty.Mark(i, kOnOffBit);
+                dirty.Mark(i, kLevelBit);
+            }
+        });
+
+        std::printf("n=%5zu  per-change: %.2f allocs %.3f tasks %5.1f ns   dirty set: %.2f allocs %.4f tasks %5.1f ns\n", lights,
+                    perChange.allocations, perChange.tasks, perChange.ns, dirtySet.allocations, dirtySet.tasks, dirtySet.ns);
+    }
+    return 0;
+}
@@ -0,0 +1,103 @@
+// Per-call latency of EndpointRegistry on each store backend.
+//
+//   endpoint_registry_bench [udns] [dir]
+//
+// The registry keeps one open store (one SQLite connection with cached
+// prepared statements, or one mapped log) for its lifetime, so only the
+// first call pays for opening and schema setup.  Measures assigning every
+// UDN one call at a time (one durable commit each), assigning them again
+// (already mapped), lookups, and one GetOrAssignMany() for a fresh set.
+
+#include "wemo_bridge/endpoint_registry.h"
+#include "wemo_bridge/endpoint_store.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+std::string Udn(int i)
+{
+    return "uuid:Lightswitch-1_0-" + std::to_string(100000 + i);
+}
+
+double MicrosPerCall(Clock::time_point start, int calls)
+{
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count() / calls;
+}
+
+bool Run(const std::string & path, int udns)
+{
+    std::error_code ec;
+    std::filesystem::remove(path, ec);
+
+    const auto openStart = Clock::now();
+    wemo_bridge::EndpointRegistry registry(wemo_bridge::MakeEndpointStore(path));
+    const double openUs = MicrosPerCall(openStart, 1);
+
+    auto start = Clock::now();
+    for (int i = 0; i < udns; i++)
+    {
+        if (!registry.GetOrAssign(Udn(i)).has_value())
+        {
+            std::fprintf(stderr, "GetOrAssign failed on %s\n", path.c_str());
+            return false;
+        }
+    }
+    const double assignUs = MicrosPerCall(start, udns);
+
+    start = Clock::now();
+    for (int i = 0; i < udns; i++)
+    {
+        (void) registry.GetOrAssign(Udn(i));
+    }
+    const double reassignUs = MicrosPerCall(start, udns);
+
+    start = Clock::now();
+    for (int i = 0; i < udns; i++)
+    {
+        (void) registry.Lookup(Udn(i));
+    }
+    const double lookupUs = MicrosPerCall(start, udns);
+
+    std::vector<std::string> batch;
+    for (int i = 0; i < udns; i++)
+    {
+        batch.push_back(Udn(udns + i));
+    }
+    start               = Clock::now();
+    const auto ids      = registry.GetOrAssignMany(batch);
+    const double manyUs = MicrosPerCall(start, udns);
+    if (ids.empty() || !ids.back().has_value())
+    {
+        std::fprintf(stderr, "GetOrAssignMany failed on %s\n", path.c_str());
+        return false;
+    }
+
+    std::printf("%-8s %6d udns: open %8.1f us, GetOrAssign new %7.2f us, existing %6.2f us, Lookup %6.3f us, "
+                "GetOrAssignMany %6.2f us per udn\n",
+                std::filesystem::path(path).extension().c_str(), udns, openUs, assignUs, reassignUs, lookupUs, manyUs);
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char ** argv)
+{
+    const int udns        = (argc > 1) ? std::atoi(argv[1]) : 2000;
+    const std::string dir = (argc > 2) ? argv[2] : std::filesystem::temp_directory_path().string();
+    if (udns <= 0 || udns > 30000)
+    {
+        std::fprintf(stderr, "usage: %s [udns (1-30000)] [dir]\n", argv[0]);
+        return 2;
+    }
+
+    const bool ok = Run(dir + "/endpoint_registry_bench.sqlite3", udns) && Run(dir + "/endpoint_registry_bench.log", udns);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,148 @@
+// Endpoint slot churn: EndpointSlots versus the linear scans it replaced.
+//
+//   endpoint_slots_bench [operations] [capacity...]
+//
+// Each table starts 90% full; every step releases a random owner and
+// acquires a slot for a new one.  "linear" is the old scheme over a
+// gDevices-style array: scan for the first null slot to add, scan for the
+// owner to remove.  The EndpointSlots steps are then replayed, untimed, and
+// every result is checked against a linear table, which keeps the same
+// lowest-free-slot order.  Reports ns per step.
+
+#include "wemo_bridge/endpoint_slots.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// The bridge's old gDevices handling.
+struct LinearSlots
+{
+    std::vector<const void *> owners;
+
+    explicit LinearSlots(size_t capacity) : owners(capacity, nullptr) {}
+
+    uint16_t Acquire(const void * owner)
+    {
+        for (size_t i = 0; i < owners.size(); i++)
+        {
+            if (owners[i] == nullptr)
+            {
+                owners[i] = owner;
+                return static_cast<uint16_t>(i);
+            }
+        }
+        return wemo_bridge::EndpointSlots::kNoSlot;
+    }
+
+    uint16_t Release(const void * owner)
+    {
+        for (size_t i = 0; i < owners.size(); i++)
+        {
+            if (owners[i] == owner)
+            {
+                owners[i] = nullptr;
+                return static_cast<uint16_t>(i);
+            }
+        }
+        return wemo_bridge::EndpointSlots::kNoSlot;
+    }
+};
+
+// Runs the churn on `slots` and returns ns per step.  The owners are the
+// addresses of `tokens`; live holds the ones currently in the table.
+template <typename Slots, typename CheckFn>
+double Churn(Slots & slots, size_t capacity, int operations, CheckFn check)
+{
+    std::vector<char> tokens(capacity * 2);
+    std::vector<const void *> live;
+    std::vector<const void *> idle;
+    for (size_t i = 0; i < tokens.size(); i++)
+    {
+        idle.push_back(&tokens[i]);
+    }
+    const size_t fill = capacity * 9 / 10;
+    for (size_t i = 0; i < fill; i++)
+    {
+        live.push_back(idle.back());
+        idle.pop_back();
+        check(true, live.back(), slots.Acquire(live.back()));
+    }
+
+    std::mt19937 rng(7);
+    const auto start = Clock::now();
+    for (int op = 0; op < operations; op++)
+    {
+        const size_t victim = rng() % live.size();
+        const void * gone   = live[victim];
+        live[victim]        = live.back();
+        live.pop_back();
+        check(false, gone, slots.Release(gone));
+        idle.push_back(gone);
+
+        const size_t pick  = rng() % idle.size();
+        const void * added = idle[pick];
+        idle[pick]         = idle.back();
+        idle.pop_back();
+        check(true, added, slots.Acquire(added));
+        live.push_back(added);
+    }
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / operations;
+}
+
+} // namespace
+
+int main(int argc, char ** argv)
+{
+    const int operations = (argc > 1) ? std::atoi(argv[1]) : 20000;
+    std::vector<size_t> capacities;
+    for (int i = 2; i < argc; i++)
+    {
+        capacities.push_back(static_cast<size_t>(std::atol(argv[i])));
+    }
+    if (capacities.empty())
+    {
+        capacities = { 256, 4096, 16384, 65000 };
+    }
+    for (const size_t capacity : capacities)
+    {
+        if (operations <= 0 || capacity < 2 || capacity >= wemo_bridge::EndpointSlots::kNoSlot)
+        {
+            std::fprintf(stderr, "usage: %s [operations] [capacity (2-65534)...]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    std::printf("%d steps at 90%% full, ns per step (one release plus one acquire)\n", operations);
+    for (const size_t capacity : capacities)
+    {
+        LinearSlots linear(capacity);
+        const double linearNs = Churn(linear, capacity, operations, [](bool, const void *, uint16_t) {});
+
+        wemo_bridge::EndpointSlots slots(capacity);
+        const double slotNs = Churn(slots, capacity, operations, [](bool, const void *, uint16_t) {});
+
+        // Replays the same steps, untimed, against a shadow linear table.
+        wemo_bridge::EndpointSlots checked(capacity);
+        LinearSlots shadow(capacity);
+        long mismatches = 0;
+        Churn(checked, capacity, operations, [&](bool acquire, const void * owner, uint16_t slot) {
+            const uint16_t expected = acquire ? shadow.Acquire(owner) : shadow.Release(owner);
+            mismatches += (slot != expected) ? 1 : 0;
+        });
+
+        std::printf("capacity %5zu: linear %8.0f ns  slots %6.0f ns  mismatches %ld\n", capacity, linearNs, slotNs,
+                    mismatches);
+        if (mismatches != 0)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
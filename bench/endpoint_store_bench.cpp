@@ -0,0 +1,85 @@
+// Commit throughput of the endpoint store backends.
+//
+//   endpoint_store_bench [transactions] [records-per-transaction] [dir]
+//
+// Each transaction inserts fresh mappings and touches as many existing ones,
+// the mix a discovery pass produces.  Every Commit() is durable, so results
+// depend heavily on the filesystem; run it on the device's real storage.
+
+#include "wemo_bridge/endpoint_store.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+
+namespace {
+
+std::string Udn(int i)
+{
+    return "uuid:Lightswitch-1_0-" + std::to_string(100000 + i);
+}
+
+bool Run(const std::string & path, int transactions, int records)
+{
+    std::error_code ec;
+    std::filesystem::remove(path, ec);
+
+    auto store = wemo_bridge::MakeEndpointStore(path);
+    if (!store->Open())
+    {
+        std::fprintf(stderr, "cannot open %s\n", path.c_str());
+        return false;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    int next         = 0;
+    for (int t = 0; t < transactions; t++)
+    {
+        if (!store->Begin())
+        {
+            return false;
+        }
+        for (int r = 0; r < records; r++)
+        {
+            if (next > 0 && !store->TouchMapping(Udn(std::rand() % next), t))
+            {
+                return false;
+            }
+            if (!store->InsertMapping(Udn(next), static_cast<uint16_t>(next % 60000 + 2), t))
+            {
+                return false;
+            }
+            next++;
+        }
+        if (!store->Commit())
+        {
+            return false;
+        }
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::printf("%-8s %6d txns x %3d records: %8.1f txn/s, %8.3f ms/txn, %zu KiB on disk\n",
+                std::filesystem::path(path).extension().c_str(), transactions, records, transactions / seconds,
+                1000.0 * seconds / transactions, static_cast<size_t>(std::filesystem::file_size(path) / 1024));
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char ** argv)
+{
+    const int transactions = (argc > 1) ? std::atoi(argv[1]) : 200;
+    const int records      = (argc > 2) ? std::atoi(argv[2]) : 16;
+    const std::string dir  = (argc > 3) ? argv[3] : std::filesystem::temp_directory_path().string();
+    if (transactions <= 0 || records <= 0)
+    {
+        std::fprintf(stderr, "usage: %s [transactions] [records-per-transaction] [dir]\n", argv[0]);
+        return 2;
+    }
+
+    const bool ok = Run(dir + "/endpoint_store_bench.sqlite3", transactions, records) &&
+        Run(dir + "/endpoint_store_bench.log", transactions, records);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,172 @@
+// Discovery reconcile of light state: a per-device walk over virtual Device
+// objects versus DiffLightStates() over the packed state words.
+//
+//   light_state_diff_bench [runs] [changed-percent]
+//
+// The bridge app needs the Matter SDK, so Devices are stand-ins with the
+// same virtual getters and setters.  "per-device walk" reads each Device's
+// reachable, on and level state and calls the setters that differ, as the
+// reconcile used to.  "SoA reconcile" diffs the packed reported state
+// (packed outside the timing) against the table with DiffLightStates() and
+// calls the setters only for the lights it returns.  "diff alone" is the DiffLightStates() call.  A
+// few percent of lights change per pass; best of `runs`.
+
+#include "wemo_bridge/light_state_table.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+class Device
+{
+public:
+    virtual ~Device() = default;
+    virtual bool IsReachable() const { return mReachable; }
+    virtual bool IsOn() const { return mOn; }
+    virtual uint8_t Level() const { return mLevel; }
+    virtual void SetReachable(bool reachable) { mReachable = reachable; }
+    virtual void SetOnOff(bool on) { mOn = on; }
+    virtual void SetLevel(uint8_t level) { mLevel = level; }
+
+private:
+    bool mReachable = true;
+    bool mOn        = false;
+    uint8_t mLevel  = 0;
+    char mName[32]  = {};
+};
+
+struct Reported
+{
+    bool online;
+    bool on;
+    uint8_t level;
+};
+
+struct Fleet
+{
+    std::vector<std::unique_ptr<Device>> devices;
+    std::vector<uint32_t> state; // LightStateTable::state
+    size_t setterCalls = 0;
+
+    explicit Fleet(size_t count) : state(count, wemo_bridge::PackLightState(true, false, 0))
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            devices.push_back(std::make_unique<Device>());
+        }
+    }
+
+    void Apply(size_t i, const Reported & report)
+    {
+        Device & dev = *devices[i];
+        if (dev.IsReachable() != report.online)
+        {
+            dev.SetReachable(report.online);
+            setterCalls++;
+        }
+        if (dev.IsOn() != report.on)
+        {
+            dev.SetOnOff(report.on);
+            setterCalls++;
+        }
+        if (dev.Level() != report.level)
+        {
+            dev.SetLevel(report.level);
+            setterCalls++;
+        }
+        state[i] = wemo_bridge::PackLightState(report.online, report.on, report.level);
+    }
+};
+
+template <typename Fn>
+double BestUs(int runs, Fn fn)
+{
+    double best = 1e18;
+    for (int r = 0; r < runs; r++)
+    {
+        const auto start = Clock::now();
+        fn();
+        best = std::min(best, std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+    }
+    return best;
+}
+
+} // namespace
+
+int main(int argc, char ** argv)
+{
+    const int runs           = (argc > 1) ? std::atoi(argv[1]) : 20;
+    const int changedPercent = (argc > 2) ? std::atoi(argv[2]) : 1;
+    if (runs <= 0 || changedPercent < 0 || changedPercent > 100)
+    {
+        std::fprintf(stderr, "usage: %s [runs] [changed-percent (0-100)]\n", argv[0]);
+        return 2;
+    }
+
+    std::printf("%d%% of lights changed per pass, best of %d runs\n", changedPercent, runs);
+    std::printf("devices  per-device walk  SoA reconcile  diff alone  setter calls per pass (walk / SoA)\n");
+    for (const size_t count : { size_t { 256 }, size_t { 1024 }, size_t { 4096 } })
+    {
+        // Reports for two passes; each pass flips a few lights relative to
+        // the other, and the runs alternate between them.
+        std::mt19937 rng(99);
+        std::vector<Reported> passes[2];
+        passes[0].assign(count, Reported { true, false, 0 });
+        passes[1] = passes[0];
+        for (size_t i = 0; i < count; i++)
+        {
+            if (static_cast<int>(rng() % 100) < changedPercent)
+            {
+                passes[1][i] = Reported { true, true, static_cast<uint8_t>(1 + rng() % 254) };
+            }
+        }
+        std::vector<uint32_t> packed[2];
+        for (int p = 0; p < 2; p++)
+        {
+            for (const auto & report : passes[p])
+            {
+                packed[p].push_back(wemo_bridge::PackLightState(report.online, report.on, report.level));
+            }
+        }
+
+        Fleet walked(count);
+        int pass            = 0;
+        const double walkUs = BestUs(runs, [&] {
+            pass ^= 1;
+            for (size_t i = 0; i < count; i++)
+            {
+                walked.Apply(i, passes[pass][i]);
+            }
+        });
+
+        Fleet diffed(count);
+        std::vector<uint32_t> changed;
+        pass               = 0;
+        const double soaUs = BestUs(runs, [&] {
+            pass ^= 1;
+            changed.clear();
+            wemo_bridge::DiffLightStates(diffed.state.data(), packed[pass].data(), count, changed);
+            for (const uint32_t i : changed)
+            {
+                diffed.Apply(i, passes[pass][i]);
+            }
+        });
+
+        const double diffUs = BestUs(runs, [&] {
+            changed.clear();
+            wemo_bridge::DiffLightStates(diffed.state.data(), packed[1].data(), count, changed);
+        });
+
+        std::printf("%7zu  %12.2f us  %10.2f us  %7.2f us  %5zu / %zu\n", count, walkUs, soaUs, diffUs,
+                    walked.setterCalls / static_cast<size_t>(runs), diffed.setterCalls / static_cast<size_t>(runs));
+    }
+    return 0;
+}
@@ -0,0 +1,168 @@
+// Heap allocations and cost of bridged light storage: SlabPool versus one
+// heap block per object.
+//
+//   slab_pool_bench [churn-operations] [lights...]
+//
+// Objects have the size of the bridge's Device (a stand-in, since the real
+// one needs the Matter SDK).  "heap" is make_unique per Device, as before;
+// "slab" is MakeInSlab() from a SlabPoolFor.  For each light count it
+// reports the heap allocations and time per light while growing to that
+// count, then allocations and time per operation for remove/re-add churn
+// at that size.  Every slab block is checked to be cache-line aligned.
+
+#include "wemo_bridge/slab_pool.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <random>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+std::atomic<long> gAllocations { 0 };
+
+class Device
+{
+public:
+    virtual ~Device() = default;
+
+private:
+    char mName[32]     = {};
+    char mLocation[32] = {};
+    unsigned char mState[120] {};
+};
+
+struct Result
+{
+    double growAllocs  = 0;
+    double growNs      = 0;
+    double churnAllocs = 0;
+    double churnNs     = 0;
+};
+
+// make() returns an owning pointer to a new Device.
+template <typename Ptr, typename MakeFn>
+Result Measure(size_t lights, int operations, MakeFn make)
+{
+    Result result;
+    std::vector<Ptr> devices;
+    devices.reserve(lights);
+
+    long before = gAllocations.load();
+    auto start  = Clock::now();
+    for (size_t i = 0; i < lights; i++)
+    {
+        devices.push_back(make());
+    }
+    result.growNs     = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / static_cast<double>(lights);
+    result.growAllocs = static_cast<double>(gAllocations.load() - before) / static_cast<double>(lights);
+
+    std::mt19937 rng(5);
+    before = gAllocations.load();
+    start  = Clock::now();
+    for (int op = 0; op < operations; op++)
+    {
+        Ptr & slot = devices[rng() % lights];
+        slot.reset();
+        slot = make();
+    }
+    result.churnNs     = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / operations;
+    result.churnAllocs = static_cast<double>(gAllocations.load() - before) / operations;
+    return result;
+}
+
+} // namespace
+
+void * operator new(size_t size)
+{
+    gAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void * p = std::malloc(size ? size : 1))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void * operator new(size_t size, std::align_val_t align)
+{
+    gAllocations.fetch_add(1, std::memory_order_relaxed);
+    const size_t alignment = static_cast<size_t>(align);
+    if (void * p = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void * p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void * p, size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void * p, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void * p, size_t, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+int main(int argc, char ** argv)
+{
+    const int operations = (argc > 1) ? std::atoi(argv[1]) : 100000;
+    std::vector<size_t> counts;
+    for (int i = 2; i < argc; i++)
+    {
+        counts.push_back(static_cast<size_t>(std::atol(argv[i])));
+    }
+    if (counts.empty())
+    {
+        counts = { 64, 256, 4096 };
+    }
+    for (const size_t lights : counts)
+    {
+        if (operations <= 0 || lights == 0)
+        {
+            std::fprintf(stderr, "usage: %s [churn-operations] [lights (1+)...]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    std::printf("Device of %zu bytes, %d churn operations\n", sizeof(Device), operations);
+    for (const size_t lights : counts)
+    {
+        const Result heap = Measure<std::unique_ptr<Device>>(lights, operations, [] { return std::make_unique<Device>(); });
+
+        wemo_bridge::SlabPoolFor<Device> pool;
+        bool aligned      = true;
+        const Result slab = Measure<wemo_bridge::SlabPtr<Device>>(lights, operations, [&] {
+            auto device = wemo_bridge::MakeInSlab<Device>(pool);
+            aligned     = aligned && reinterpret_cast<uintptr_t>(device.get()) % wemo_bridge::SlabPool::kCacheLine == 0;
+            return device;
+        });
+
+        std::printf("n=%5zu  grow: heap %.2f allocs %5.0f ns, slab %.2f allocs %5.0f ns per light;  "
+                    "churn: heap %.2f allocs %4.0f ns, slab %.2f allocs %4.0f ns per op;  %s\n",
+                    lights, heap.growAllocs, heap.growNs, slab.growAllocs, slab.growNs, heap.churnAllocs, heap.churnNs,
+                    slab.churnAllocs, slab.churnNs, aligned ? "aligned" : "MISALIGNED");
+        if (!aligned)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,262 @@
+// Engine event hand-off to a single consumer thread: per-event work items
+// versus WemoEventRing.
+//
+//   wemo_event_ring_bench [events-per-second] [seconds] [devices] [apply-us] [producers]
+//
+// The consumer is a stand-in for the Matter event loop: a thread running
+// scheduled work items one at a time, each applied event costing apply-us of
+// busy work.  "per-event" allocates a context and schedules one work item
+// per event, as the bridge used to; "ring" publishes into the ring and
+// schedules a drain only when none is pending.  Latency is from publishing a
+// device's newest state to applying it.  Allocations are counted while the
+// producers run, so they include the stand-in's own work items.
+
+#include "wemo_bridge/wemo_event_ring.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+std::atomic<long> gAllocations { 0 };
+
+int64_t NowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+void BusyFor(int us)
+{
+    const auto until = Clock::now() + std::chrono::microseconds(us);
+    while (Clock::now() < until)
+    {
+    }
+}
+
+// Runs scheduled work items on one thread, like PlatformMgr().ScheduleWork.
+class EventLoop
+{
+public:
+    EventLoop() : mThread([this] { Run(); }) {}
+
+    ~EventLoop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStopping = true;
+        }
+        mCv.notify_one();
+        mThread.join();
+    }
+
+    void Schedule(std::function<void()> work)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mQueue.push_back(std::move(work));
+        }
+        mCv.notify_one();
+    }
+
+    long Wakeups() const { return mWakeups.load(); }
+
+    // Blocks until every item scheduled so far has run.
+    void Flush()
+    {
+        std::mutex mutex;
+        std::condition_variable cv;
+        bool done = false;
+        Schedule([&] {
+            std::lock_guard<std::mutex> lock(mutex);
+            done = true;
+            cv.notify_one();
+        });
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&] { return done; });
+    }
+
+private:
+    void Run()
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        while (true)
+        {
+            mCv.wait(lock, [&] { return mStopping || !mQueue.empty(); });
+            if (mQueue.empty())
+            {
+                return;
+            }
+            auto work = std::move(mQueue.front());
+            mQueue.pop_front();
+            lock.unlock();
+            mWakeups++;
+            work();
+            lock.lock();
+        }
+    }
+
+    std::mutex mMutex;
+    std::condition_variable mCv;
+    std::deque<std::function<void()>> mQueue;
+    bool mStopping = false;
+    std::atomic<long> mWakeups { 0 };
+    std::thread mThread;
+};
+
+struct Stats
+{
+    long allocations = 0;
+    long wakeups     = 0;
+    std::vector<double> latencyUs;
+};
+
+struct Load
+{
+    int rate;
+    int seconds;
+    int devices;
+    int applyUs;
+    int producers;
+};
+
+// Publishes rate events/s split across the producers; publish(ev) hands one
+// event over.  publishedAt[device] holds the time of that device's newest
+// event.
+template <typename PublishFn>
+void Produce(const Load & load, std::vector<std::atomic<int64_t>> & publishedAt, PublishFn publish)
+{
+    std::vector<std::thread> producers;
+    const auto start = Clock::now();
+    for (int p = 0; p < load.producers; p++)
+    {
+        producers.emplace_back([&, p] {
+            const long events = static_cast<long>(load.rate) * load.seconds / load.producers;
+            for (long i = 0; i < events; i++)
+            {
+                std::this_thread::sleep_until(start +
+                                              std::chrono::microseconds(1000000LL * i * load.producers / load.rate));
+                const int device = static_cast<int>((i * load.producers + p) % load.devices);
+                publishedAt[static_cast<size_t>(device)].store(NowNs());
+                publish(wemo_bridge::WemoStateEvent { device, true, static_cast<int>(i & 1), -1 });
+            }
+        });
+    }
+    for (auto & producer : producers)
+    {
+        producer.join();
+    }
+}
+
+void Apply(const Load & load, std::vector<std::atomic<int64_t>> & publishedAt, const wemo_bridge::WemoStateEvent & ev,
+           Stats & stats)
+{
+    BusyFor(load.applyUs);
+    stats.latencyUs.push_back(static_cast<double>(NowNs() - publishedAt[static_cast<size_t>(ev.wemo_id)].load()) / 1000.0);
+}
+
+Stats RunPerEvent(const Load & load)
+{
+    Stats stats;
+    stats.latencyUs.reserve(static_cast<size_t>(load.rate) * static_cast<size_t>(load.seconds));
+    std::vector<std::atomic<int64_t>> publishedAt(static_cast<size_t>(load.devices));
+    EventLoop loop;
+    const long allocationsBefore = gAllocations.load();
+    Produce(load, publishedAt, [&](const wemo_bridge::WemoStateEvent & ev) {
+        auto context = std::make_unique<wemo_bridge::WemoStateEvent>(ev);
+        loop.Schedule([&, ctx = std::shared_ptr<wemo_bridge::WemoStateEvent>(std::move(context))] {
+            Apply(load, publishedAt, *ctx, stats);
+        });
+    });
+    stats.allocations = gAllocations.load() - allocationsBefore;
+    loop.Flush();
+    stats.wakeups = loop.Wakeups() - 1;
+    return stats;
+}
+
+Stats RunRing(const Load & load)
+{
+    Stats stats;
+    stats.latencyUs.reserve(static_cast<size_t>(load.rate) * static_cast<size_t>(load.seconds));
+    std::vector<std::atomic<int64_t>> publishedAt(static_cast<size_t>(load.devices));
+    EventLoop loop;
+    std::unique_ptr<wemo_bridge::WemoEventRing> ring;
+    ring = std::make_unique<wemo_bridge::WemoEventRing>(static_cast<size_t>(load.devices), [&] {
+        loop.Schedule([&] { ring->Drain([&](const wemo_bridge::WemoStateEvent & ev) { Apply(load, publishedAt, ev, stats); }); });
+    });
+    const long allocationsBefore = gAllocations.load();
+    Produce(load, publishedAt, [&](const wemo_bridge::WemoStateEvent & ev) { ring->Publish(ev); });
+    stats.allocations = gAllocations.load() - allocationsBefore;
+    loop.Flush();
+    stats.wakeups = loop.Wakeups() - 1;
+    return stats;
+}
+
+void Print(const char * label, Stats & stats)
+{
+    std::sort(stats.latencyUs.begin(), stats.latencyUs.end());
+    const auto at = [&](double p) {
+        const auto & v = stats.latencyUs;
+        return v.empty() ? 0.0 : v[std::min(v.size() - 1, static_cast<size_t>(p * static_cast<double>(v.size())))];
+    };
+    std::printf("%-10s allocs %7ld  wakeups %7ld  applied %7zu  latency p50 %9.1f us  p99 %9.1f us  max %9.1f us\n", label,
+                stats.allocations, stats.wakeups, stats.latencyUs.size(), at(0.50), at(0.99),
+                stats.latencyUs.empty() ? 0.0 : stats.latencyUs.back());
+}
+
+} // namespace
+
+void * operator new(size_t size)
+{
+    gAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void * p = std::malloc(size ? size : 1))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void * p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void * p, size_t) noexcept
+{
+    std::free(p);
+}
+
+int main(int argc, char ** argv)
+{
+    Load load;
+    load.rate      = (argc > 1) ? std::atoi(argv[1]) : 10000;
+    load.seconds   = (argc > 2) ? std::atoi(argv[2]) : 2;
+    load.devices   = (argc > 3) ? std::atoi(argv[3]) : 64;
+    load.applyUs   = (argc > 4) ? std::atoi(argv[4]) : 0;
+    load.producers = (argc > 5) ? std::atoi(argv[5]) : 2;
+    if (load.rate <= 0 || load.seconds <= 0 || load.devices <= 0 || load.applyUs < 0 || load.producers <= 0)
+    {
+        std::fprintf(stderr, "usage: %s [events-per-second] [seconds] [devices] [apply-us] [producers]\n", argv[0]);
+        return 2;
+    }
+
+    std::printf("%d events/s for %d s from %d producers over %d devices, apply cost %d us\n", load.rate, load.seconds,
+                load.producers, load.devices, load.applyUs);
+    Stats perEvent = RunPerEvent(load);
+    Print("per-event", perEvent);
+    Stats ring = RunRing(load);
+    Print("ring", ring);
+    return 0;
+}
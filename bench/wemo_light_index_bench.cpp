@@ -0,0 +1,170 @@
+// Light lookups on the bridge's write and event paths: linear scan versus
+// the position tables in matter-bridge-app/main.cpp.
+//
+//   wemo_light_index_bench [lookups]
+//
+// The bridge app needs the Matter SDK, so this models its light list with a
+// stand-in entry of the same shape and copies the lookup scheme: writes find
+// the light through a dense table indexed by dynamic endpoint index, events
+// through a vector indexed by wemo id, and both check the entry they land on.
+// The linear variants are the scans those tables replaced.  Reports ns per
+// random lookup for a range of device counts.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr uint32_t kNoWemoLight = UINT32_MAX;
+
+struct Device
+{
+    std::string name;
+};
+
+// Same hot fields as BridgedWemoLight.
+struct Light
+{
+    std::unique_ptr<Device> device;
+    std::string udn;
+    int wemo_id         = -1;
+    uint32_t handle     = 0;
+    bool is_dimmer      = false;
+    int failed_commands = 0;
+};
+
+struct Bridge
+{
+    std::vector<Light> lights;
+    std::vector<Device *> devices; // by dynamic endpoint index, like gDevices
+    std::vector<uint32_t> byEndpointIndex;
+    std::vector<uint32_t> byWemoId;
+
+    explicit Bridge(size_t count)
+    {
+        lights.resize(count);
+        devices.resize(count);
+        byEndpointIndex.assign(count, kNoWemoLight);
+        byWemoId.assign(count, kNoWemoLight);
+        for (size_t i = 0; i < count; i++)
+        {
+            Light & light      = lights[i];
+            light.device       = std::make_unique<Device>(Device { "Light " + std::to_string(i) });
+            light.udn          = "uuid:Lightswitch-1_0-" + std::to_string(100000 + i);
+            light.wemo_id      = static_cast<int>(i);
+            light.handle       = static_cast<uint32_t>(i);
+            devices[i]         = light.device.get();
+            byEndpointIndex[i] = static_cast<uint32_t>(i);
+            byWemoId[i]        = static_cast<uint32_t>(i);
+        }
+    }
+
+    Light * LinearByDevice(const Device * dev)
+    {
+        for (auto & light : lights)
+        {
+            if (light.device.get() == dev)
+            {
+                return &light;
+            }
+        }
+        return nullptr;
+    }
+
+    Light * LinearByWemoId(int wemoId)
+    {
+        for (auto & light : lights)
+        {
+            if (light.wemo_id == wemoId)
+            {
+                return &light;
+            }
+        }
+        return nullptr;
+    }
+
+    Light * At(uint32_t position) { return (position < lights.size()) ? &lights[position] : nullptr; }
+
+    Light * IndexedByEndpoint(uint16_t endpointIndex)
+    {
+        if (endpointIndex >= byEndpointIndex.size())
+        {
+            return nullptr;
+        }
+        Light * light = At(byEndpointIndex[endpointIndex]);
+        return (light != nullptr && light->device.get() == devices[endpointIndex]) ? light : nullptr;
+    }
+
+    Light * IndexedByWemoId(int wemoId)
+    {
+        if (wemoId < 0 || static_cast<size_t>(wemoId) >= byWemoId.size())
+        {
+            return nullptr;
+        }
+        Light * light = At(byWemoId[static_cast<size_t>(wemoId)]);
+        return (light != nullptr && light->wemo_id == wemoId) ? light : nullptr;
+    }
+};
+
+template <typename FindFn>
+double NsPerLookup(const std::vector<uint16_t> & keys, FindFn find)
+{
+    size_t found     = 0;
+    const auto start = Clock::now();
+    for (const uint16_t key : keys)
+    {
+        Light * light = find(key);
+        if (light != nullptr)
+        {
+            found += static_cast<size_t>(light->failed_commands) + 1;
+        }
+    }
+    const double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    if (found != keys.size())
+    {
+        std::fprintf(stderr, "lookup missed %zu of %zu\n", keys.size() - found, keys.size());
+        std::exit(1);
+    }
+    return ns / static_cast<double>(keys.size());
+}
+
+} // namespace
+
+int main(int argc, char ** argv)
+{
+    const int lookups = (argc > 1) ? std::atoi(argv[1]) : 65536;
+    if (lookups <= 0)
+    {
+        std::fprintf(stderr, "usage: %s [lookups]\n", argv[0]);
+        return 2;
+    }
+
+    std::printf("%d random lookups, ns per lookup\n", lookups);
+    std::printf("devices  write linear  write indexed  event linear  event indexed\n");
+    for (const size_t count : { size_t { 16 }, size_t { 256 }, size_t { 1024 }, size_t { 4096 } })
+    {
+        Bridge bridge(count);
+        std::mt19937 rng(42);
+        std::vector<uint16_t> keys(static_cast<size_t>(lookups));
+        for (auto & key : keys)
+        {
+            key = static_cast<uint16_t>(rng() % count);
+        }
+
+        const double writeLinear =
+            NsPerLookup(keys, [&](uint16_t key) { return bridge.LinearByDevice(bridge.devices[key]); });
+        const double writeIndexed = NsPerLookup(keys, [&](uint16_t key) { return bridge.IndexedByEndpoint(key); });
+        const double eventLinear  = NsPerLookup(keys, [&](uint16_t key) { return bridge.LinearByWemoId(key); });
+        const double eventIndexed = NsPerLookup(keys, [&](uint16_t key) { return bridge.IndexedByWemoId(key); });
+        std::printf("%7zu  %12.1f  %13.1f  %12.1f  %13.1f\n", count, writeLinear, writeIndexed, eventLinear, eventIndexed);
+    }
+    return 0;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace wemo_bridge {
+
+// Fixed pool of worker threads for outbound device commands.
+//
+// Tasks submitted with the same key run one at a time in submission order (a
+// strand per key); tasks with different keys run in parallel on the pool.
+// The number of unfinished tasks is bounded: TrySubmit() rejects work instead
+// of growing the queue, so callers can push back on the controller.
+// TrySubmitLatest() additionally merges commands that are superseded before
+// they start.  An optional admission function paces each strand without
+// holding a worker: a strand that is not admitted yet is set aside until the
+// time it names, and its queued tasks can still be superseded meanwhile.
+class CommandExecutor
+{
+public:
+    using Task  = std::function<void()>;
+    using Clock = std::chrono::steady_clock;
+    // Called with the strand's key before each of its tasks starts, without
+    // the executor lock held.  A time not after now admits the task (the
+    // function accounts for it); a later time retries the strand then.
+    using AdmitFn = std::function<Clock::time_point(uint64_t key)>;
+
+    static constexpr size_t kDefaultWorkerCount = 8;
+    static constexpr size_t kDefaultMaxPending  = 256;
+
+    explicit CommandExecutor(size_t worker_count = kDefaultWorkerCount, size_t max_pending = kDefaultMaxPending,
+                             AdmitFn admit = nullptr);
+    ~CommandExecutor();
+
+    CommandExecutor(const CommandExecutor &)             = delete;
+    CommandExecutor & operator=(const CommandExecutor &) = delete;
+
+    // Queues task behind every earlier task with the same key.  Returns false
+    // (and drops the task) when max_pending tasks are already unfinished or
+    // the executor is shutting down.
+    bool TrySubmit(uint64_t key, Task task);
+
+    // Latest-wins variant: a queued, not yet started task with the same key
+    // and kind is dropped and the new task is appended behind the rest of the
+    // strand, so only the newest command of each kind reaches the device and
+    // the last submitted command still runs last.  Replacing never counts
+    // against max_pending.  kind must be non-zero.  The dropped task's
+    // on_superseded (if any) runs on the submitting thread.
+    bool TrySubmitLatest(uint64_t key, uint32_t kind, Task task, Task on_superseded = nullptr);
+
+    // Stops accepting tasks, runs everything already queued (still paced by
+    // the admission function) and joins the workers.  Idempotent.
+    void Shutdown();
+
+private:
+    struct QueuedTask
+    {
+        Task task;
+        uint32_t kind = 0; // 0 = never coalesced
+        Task on_superseded;
+    };
+
+    struct Strand
+    {
+        std::deque<QueuedTask> tasks;
+    };
+
+    bool Enqueue(uint64_t key, uint32_t kind, Task task, Task on_superseded);
+    void WorkerLoop();
+    // Moves strands whose admission time has come to mReady.
+    void PromoteDueLocked(Clock::time_point now);
+
+    std::mutex mMutex;
+    std::condition_variable mCv;
+    // A key is present while it has queued or running tasks.  It sits in
+    // mReady or mDeferred exactly when it has queued tasks and none of them
+    // is running.
+    std::unordered_map<uint64_t, Strand> mStrands;
+    std::deque<uint64_t> mReady;
+    std::multimap<Clock::time_point, uint64_t> mDeferred; // by admission time
+    size_t mPending = 0; // queued + running
+    size_t mMaxPending;
+    bool mStopping = false;
+    AdmitFn mAdmit;
+    std::vector<std::thread> mWorkers;
+};
+
+} // namespace wemo_bridge
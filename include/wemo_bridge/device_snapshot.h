@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "wemo_bridge/wemo_device.h"
+
+namespace wemo_bridge {
+
+// Last known set of bridged WeMo devices, persisted so the bridge can publish
+// its endpoints at startup before live discovery has finished.
+//
+// The file is plain text, one device per line.  Saves write a temporary file
+// and rename it over the old one, so readers see either the previous or the
+// new snapshot.  wemo_id is not persisted (the engine assigns it per session);
+// loaded devices carry kSnapshotWemoId until discovery reports the real one.
+constexpr int kSnapshotWemoId = -1;
+
+// Returns an empty list when the file is missing or unreadable; malformed
+// lines are skipped.
+std::vector<WemoDevice> LoadDeviceSnapshot(const std::string & path);
+bool SaveDeviceSnapshot(const std::string & path, const std::vector<WemoDevice> & devices);
+
+} // namespace wemo_bridge
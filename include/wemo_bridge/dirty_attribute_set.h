@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+namespace wemo_bridge {
+
+// Attributes waiting to be reported, as up to eight caller-defined bits per
+// dynamic endpoint slot.
+//
+// Mark() sets bits with atomic ORs on preallocated words and never
+// allocates; the first Mark() after a flush calls schedule_flush exactly
+// once, so every change made in one event-loop turn, on any number of
+// endpoints, is reported by a single Flush().  A two-level bitmap (one bit
+// per slot, one summary bit per 64 slots) lets Flush() visit only the
+// slots that were marked.
+class DirtyAttributeSet
+{
+public:
+    using ScheduleFn = std::function<void()>;
+
+    // Heap bytes per slot, for capacity planning.
+    static constexpr size_t kBytesPerSlot = sizeof(std::atomic<uint8_t>);
+
+    DirtyAttributeSet(size_t capacity, ScheduleFn schedule_flush);
+
+    DirtyAttributeSet(const DirtyAttributeSet &)             = delete;
+    DirtyAttributeSet & operator=(const DirtyAttributeSet &) = delete;
+
+    // Safe from any thread.  Slots at or past capacity are ignored.
+    void Mark(size_t slot, uint8_t bits);
+
+    // Drops whatever is pending for slot, e.g. when its endpoint goes away
+    // before the flush.
+    void Forget(size_t slot);
+
+    // Consumer side; call from one thread only.  Calls report(slot, bits)
+    // once for every slot marked since the last flush, in slot order, and
+    // returns how many slots were reported.
+    size_t Flush(const std::function<void(size_t, uint8_t)> & report);
+
+private:
+    const size_t mCapacity;
+    const size_t mSlotWords;
+    const size_t mSummaryWords;
+    std::unique_ptr<std::atomic<uint8_t>[]> mBits;
+    std::unique_ptr<std::atomic<uint64_t>[]> mDirtySlots;   // bit set = slot has bits
+    std::unique_ptr<std::atomic<uint64_t>[]> mDirtySummary; // bit set = mDirtySlots word non-zero
+    alignas(64) std::atomic<bool> mFlushScheduled { false };
+    ScheduleFn mScheduleFlush;
+};
+
+} // namespace wemo_bridge
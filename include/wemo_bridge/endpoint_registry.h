@@ -1,21 +1,126 @@
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "wemo_bridge/endpoint_store.h"
 
 namespace wemo_bridge {
 
+// Persistent UDN -> endpoint id map on top of an EndpointStore backend
+// (SQLite by default, see MakeEndpointStore()).
+//
+// The full mapping is loaded into an immutable in-memory index at
+// construction.  Lookup() only reads the current index snapshot and never
+// touches the store; assignments write through to the store and then publish
+// a new snapshot.  The snapshot is split into hash shards and a new one
+// shares every shard the write did not touch, so publishing costs the size
+// of the touched shards rather than of the whole map.
 class EndpointRegistry
 {
 public:
-    explicit EndpointRegistry(std::string path);
+    static constexpr uint16_t kDefaultFirstEndpointId = 2;
+
+    // New ids are never allocated below first_endpoint_id, so callers can
+    // keep the registry clear of their fixed endpoints.
+    explicit EndpointRegistry(std::string path, uint16_t first_endpoint_id = kDefaultFirstEndpointId);
+    explicit EndpointRegistry(std::unique_ptr<EndpointStore> store, uint16_t first_endpoint_id = kDefaultFirstEndpointId);
+
+    EndpointRegistry(const EndpointRegistry &)             = delete;
+    EndpointRegistry & operator=(const EndpointRegistry &) = delete;
 
+    // Only reports mappings known to this process (loaded at construction or
+    // assigned/observed through GetOrAssign*).
     std::optional<uint16_t> Lookup(const std::string & udn) const;
     std::optional<uint16_t> GetOrAssign(const std::string & udn);
 
+    // Resolves or allocates every UDN in a single transaction (one commit).
+    // Results are returned in input order; on failure nothing is persisted
+    // and every entry is std::nullopt.
+    std::vector<std::optional<uint16_t>> GetOrAssignMany(const std::vector<std::string> & udns);
+
+    // Records that these UDNs were just discovered.  The stored timestamp is
+    // only rewritten when it is more than an hour old, so calling this after
+    // every discovery pass is cheap.
+    bool MarkSeen(const std::vector<std::string> & udns);
+
+    // Reserves an endpoint id that belongs to no UDN, for a device the
+    // caller publishes without a persisted mapping.  The reservation is
+    // stored like a mapping, so GetOrAssign*() in this or another process
+    // never hands the id out while it is held.
+    std::optional<uint16_t> ReserveTransient();
+    // Returns every transient id, including ones left by an earlier run, to
+    // the free list.  For startup, before any transient id is handed out.
+    bool ReleaseTransient();
+
+    // Drops the mapping for udn and returns its endpoint id to the free list.
+    bool Release(const std::string & udn);
+    // Release() for many UDNs in a single transaction.
+    bool ReleaseMany(const std::vector<std::string> & udns);
+
+    // Takes the store's cross-process owner lock for the registry's
+    // lifetime (see EndpointStore::LockOwner()).  The bridge holds it while
+    // it runs; wait blocks until a reclaim in another process finishes.
+    bool LockStore(bool wait);
+
+    // Reclamation policy: releases every mapping that has not been seen for
+    // longer than max_age.  Returns the reclaimed UDNs.
+    //
+    // Offline only: a running bridge keeps the ids it loaded and would go on
+    // using an id that was released here and then handed to another UDN.
+    // So this takes the owner lock (LockStore(false)) first and reclaims
+    // nothing, with a message on stderr, while a bridge holds the store.
+    std::vector<std::string> ReclaimUnseen(std::chrono::seconds max_age);
+
 private:
-    std::string mPath;
+    struct Entry
+    {
+        uint16_t endpoint_id = 0;
+        int64_t last_seen    = 0;
+    };
+    using Shard = std::unordered_map<std::string, Entry>;
+
+    static constexpr size_t kIndexShards = 64;
+
+    struct Index
+    {
+        Index();
+
+        const Shard & ShardFor(const std::string & udn) const { return *shards[ShardOf(udn)]; }
+        static size_t ShardOf(const std::string & udn) { return std::hash<std::string>{}(udn) % kIndexShards; }
+
+        std::array<std::shared_ptr<const Shard>, kIndexShards> shards;
+    };
+    class IndexEdit;
+
+    void LoadIndexLocked();
+    bool AssignAllLocked(const std::vector<std::string> & udns, std::vector<std::optional<uint16_t>> & out, int64_t now);
+    bool ReleaseAllLocked(const std::vector<std::string> & udns);
+    std::shared_ptr<const Index> Snapshot() const;
+    void Publish(std::shared_ptr<Index> index);
+
+    std::unique_ptr<EndpointStore> mStore;
+    uint16_t mFirstEndpointId;
+
+    // Writers hold mMutex, replace mIndex with std::atomic_store and then
+    // bump mIndexVersion.  std::atomic_load on a shared_ptr takes one of
+    // libstdc++'s pool mutexes, so readers keep a per-thread copy of the
+    // snapshot and only call it when mIndexVersion has moved since their
+    // last read (see Snapshot()).  A thread's copy keeps an old index alive
+    // until that thread reads again.
+    std::shared_ptr<const Index> mIndex;
+    std::atomic<uint64_t> mIndexVersion;
+
+    // Serializes every call into mStore.
+    std::mutex mMutex;
 };
 
 } // namespace wemo_bridge
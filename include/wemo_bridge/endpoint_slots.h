@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace wemo_bridge {
+
+// Dynamic endpoint slot allocator: hands out the indices 0..capacity-1 of
+// the SDK's dynamic endpoint table and remembers which owner (the bridge's
+// Device) holds each one.
+//
+// Free slots are tracked in a two-level bitmap (one summary bit per 64-slot
+// word), so Acquire() finds the lowest free slot with two bit scans and
+// Release() finds an owner's slot through a reverse index; neither walks the
+// table.  Not thread-safe: the bridge uses it under the CHIP stack lock.
+class EndpointSlots
+{
+public:
+    static constexpr uint16_t kNoSlot = UINT16_MAX;
+
+    // capacity must be below kNoSlot.
+    explicit EndpointSlots(size_t capacity);
+
+    // Claims the lowest free slot for owner.  Returns kNoSlot when every
+    // slot is taken or owner already holds one.
+    uint16_t Acquire(const void * owner);
+
+    // Frees owner's slot and returns it, or kNoSlot when it holds none.
+    uint16_t Release(const void * owner);
+
+    uint16_t SlotOf(const void * owner) const;
+
+    // Frees every slot.
+    void Clear();
+
+    size_t Capacity() const { return mCapacity; }
+    size_t InUse() const { return mSlotByOwner.size(); }
+
+private:
+    size_t mCapacity;
+    std::vector<uint64_t> mFree;    // bit set = slot free
+    std::vector<uint64_t> mSummary; // bit set = mFree word has a free slot
+    std::unordered_map<const void *, uint16_t> mSlotByOwner;
+};
+
+} // namespace wemo_bridge
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace wemo_bridge {
+
+struct EndpointMapping
+{
+    std::string udn;
+    uint16_t endpoint_id = 0;
+    int64_t last_seen    = 0; // unix seconds
+};
+
+// Storage backend behind EndpointRegistry.  Implementations are not required
+// to be thread-safe; the registry serializes every call.
+//
+// Writes happen inside Begin()/Commit(): reads issued inside a transaction see
+// the transaction's own uncommitted writes, and Commit() makes the whole
+// transaction durable atomically.
+class EndpointStore
+{
+public:
+    virtual ~EndpointStore() = default;
+
+    // Idempotent; returns false if the backing file cannot be opened.
+    virtual bool Open() = 0;
+
+    // Cross-process ownership of the store, held until the store is
+    // destroyed.  Idempotent.  Returns false if another process owns it,
+    // unless wait is set, in which case it blocks until the owner lets go.
+    virtual bool LockOwner(bool wait) = 0;
+    virtual bool LoadAll(std::vector<EndpointMapping> & out) = 0;
+
+    virtual bool Begin()    = 0;
+    virtual bool Commit()   = 0;
+    virtual void Rollback() = 0;
+
+    virtual std::optional<uint16_t> FindEndpointId(const std::string & udn)                      = 0;
+    virtual bool InsertMapping(const std::string & udn, uint16_t endpoint_id, int64_t last_seen) = 0;
+    virtual bool TouchMapping(const std::string & udn, int64_t last_seen)                        = 0;
+    virtual bool EraseMapping(const std::string & udn)                                           = 0;
+    virtual std::optional<std::string> GetMeta(const std::string & key)                          = 0;
+    virtual bool PutMeta(const std::string & key, const std::string & value)                     = 0;
+};
+
+// Picks a backend from the file name: paths ending in ".log" use the
+// append-only log store, anything else uses SQLite.
+std::unique_ptr<EndpointStore> MakeEndpointStore(std::string path);
+
+} // namespace wemo_bridge
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "wemo_bridge/endpoint_store.h"
+
+namespace wemo_bridge {
+
+// Memory-mapped, append-only log backend for hosts where SQLite fsync cost and
+// flash wear matter (SD-card Raspberry Pis).
+//
+// Each Commit() appends one CRC32-checksummed frame holding every record of
+// the transaction and msyncs only the pages it touched.  Open() replays frames
+// until the first torn or corrupt one and discards the rest, so a crash can
+// only lose the transaction that was being written.  A background thread
+// rewrites the log as a single snapshot frame once it grows well past the live
+// data size.
+//
+// The file is locked exclusively (flock), so unlike the SQLite backend it is
+// not shared between the CLI and a running bridge; that lock is also what
+// LockOwner() takes.
+class EndpointStoreLog final : public EndpointStore
+{
+public:
+    explicit EndpointStoreLog(std::string path);
+    ~EndpointStoreLog() override;
+
+    EndpointStoreLog(const EndpointStoreLog &)             = delete;
+    EndpointStoreLog & operator=(const EndpointStoreLog &) = delete;
+
+    bool Open() override;
+    bool LockOwner(bool wait) override;
+    bool LoadAll(std::vector<EndpointMapping> & out) override;
+
+    bool Begin() override;
+    bool Commit() override;
+    void Rollback() override;
+
+    std::optional<uint16_t> FindEndpointId(const std::string & udn) override;
+    bool InsertMapping(const std::string & udn, uint16_t endpoint_id, int64_t last_seen) override;
+    bool TouchMapping(const std::string & udn, int64_t last_seen) override;
+    bool EraseMapping(const std::string & udn) override;
+    std::optional<std::string> GetMeta(const std::string & key) override;
+    bool PutMeta(const std::string & key, const std::string & value) override;
+
+private:
+    struct MappingEntry
+    {
+        uint16_t endpoint_id = 0;
+        int64_t last_seen    = 0;
+        bool erased          = false; // tombstone; only present in pending/replay deltas
+    };
+
+    struct State
+    {
+        std::unordered_map<std::string, MappingEntry> mappings;
+        std::unordered_map<std::string, std::string> meta;
+    };
+
+    bool MapFileLocked(int fd);
+    void UnmapLocked();
+    void ReplayLocked();
+    bool EnsureCapacityLocked(size_t bytes);
+    bool AppendFrameLocked(const std::vector<uint8_t> & payload);
+    const MappingEntry * FindMappingLocked(const std::string & udn) const;
+    bool PutMappingLocked(const std::string & udn, const MappingEntry & entry);
+    void CompactionLoop();
+    bool CompactOnce();
+    // Stops and joins the compaction thread, if any; takes mMutex itself.
+    void StopCompaction();
+
+    std::string mPath;
+
+    // Guards everything below against the compaction thread.
+    std::mutex mMutex;
+    int mFd            = -1;
+    uint8_t * mMap     = nullptr;
+    size_t mCapacity   = 0;
+    size_t mEnd        = 0; // offset just past the last valid frame
+    size_t mLiveBytes  = 0; // encoded size of mState as a single snapshot
+    State mState;
+
+    bool mInTransaction = false;
+    State mPending;
+    std::vector<uint8_t> mPendingRecords;
+
+    std::condition_variable mCompactCv;
+    bool mCompactRequested = false;
+    bool mStopping         = false;
+    std::thread mCompactThread;
+};
+
+} // namespace wemo_bridge
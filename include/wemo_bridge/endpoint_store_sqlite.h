@@ -0,0 +1,56 @@
+#pragma once
+
+#include <string>
+
+#include "wemo_bridge/endpoint_store.h"
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+namespace wemo_bridge {
+
+// SQLite backend.  The connection stays open with cached prepared statements;
+// WAL mode and a busy timeout let the CLI and the bridge share the same file.
+// Ownership (LockOwner()) is an flock on a "<path>-owner" side file, since
+// SQLite's own POSIX locks on the database do not survive another
+// descriptor for it being closed.
+class EndpointStoreSqlite final : public EndpointStore
+{
+public:
+    explicit EndpointStoreSqlite(std::string path);
+    ~EndpointStoreSqlite() override;
+
+    EndpointStoreSqlite(const EndpointStoreSqlite &)             = delete;
+    EndpointStoreSqlite & operator=(const EndpointStoreSqlite &) = delete;
+
+    bool Open() override;
+    bool LockOwner(bool wait) override;
+    bool LoadAll(std::vector<EndpointMapping> & out) override;
+
+    bool Begin() override;
+    bool Commit() override;
+    void Rollback() override;
+
+    std::optional<uint16_t> FindEndpointId(const std::string & udn) override;
+    bool InsertMapping(const std::string & udn, uint16_t endpoint_id, int64_t last_seen) override;
+    bool TouchMapping(const std::string & udn, int64_t last_seen) override;
+    bool EraseMapping(const std::string & udn) override;
+    std::optional<std::string> GetMeta(const std::string & key) override;
+    bool PutMeta(const std::string & key, const std::string & value) override;
+
+private:
+    void Close();
+    bool MigrateSchema();
+
+    std::string mPath;
+    sqlite3 * mDb                  = nullptr;
+    sqlite3_stmt * mSelectStmt     = nullptr;
+    sqlite3_stmt * mInsertStmt     = nullptr;
+    sqlite3_stmt * mTouchStmt      = nullptr;
+    sqlite3_stmt * mDeleteStmt     = nullptr;
+    sqlite3_stmt * mSelectMetaStmt = nullptr;
+    sqlite3_stmt * mUpsertMetaStmt = nullptr;
+    int mOwnerFd                   = -1;
+};
+
+} // namespace wemo_bridge
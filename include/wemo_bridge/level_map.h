@@ -0,0 +1,71 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace wemo_bridge {
+
+// WeMo brightness is 0-100 %, Matter CurrentLevel 0-254.  Both directions
+// round to nearest, so every WeMo percent survives percent -> level ->
+// percent unchanged (one percent is 2.54 levels, wider than the rounding
+// error).  The reverse is lossy by nature: compare levels in percent space,
+// never against a level converted back from a report.
+constexpr uint8_t kMaxWemoPercent = 100;
+constexpr uint8_t kMaxMatterLevel = 254;
+
+namespace detail {
+
+constexpr std::array<uint8_t, kMaxWemoPercent + 1> MakePercentToLevel()
+{
+    std::array<uint8_t, kMaxWemoPercent + 1> table {};
+    for (size_t p = 0; p < table.size(); p++)
+    {
+        table[p] = static_cast<uint8_t>((p * kMaxMatterLevel + kMaxWemoPercent / 2) / kMaxWemoPercent);
+    }
+    return table;
+}
+
+constexpr std::array<uint8_t, kMaxMatterLevel + 1> MakeLevelToPercent()
+{
+    std::array<uint8_t, kMaxMatterLevel + 1> table {};
+    for (size_t m = 0; m < table.size(); m++)
+    {
+        const size_t percent = (m * kMaxWemoPercent + kMaxMatterLevel / 2) / kMaxMatterLevel;
+        // A non-zero level must not round to 0 %, which WeMo takes as off.
+        table[m] = static_cast<uint8_t>((m > 0 && percent == 0) ? 1 : percent);
+    }
+    return table;
+}
+
+constexpr std::array<uint8_t, kMaxWemoPercent + 1> kPercentToLevel = MakePercentToLevel();
+constexpr std::array<uint8_t, kMaxMatterLevel + 1> kLevelToPercent = MakeLevelToPercent();
+
+constexpr bool PercentsRoundTrip()
+{
+    for (size_t p = 0; p <= kMaxWemoPercent; p++)
+    {
+        if (kLevelToPercent[kPercentToLevel[p]] != p)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static_assert(PercentsRoundTrip(), "WeMo percent -> Matter level -> percent must be the identity");
+
+} // namespace detail
+
+// Out-of-range percents clamp to 100.
+constexpr uint8_t WemoPercentToMatterLevel(int percent)
+{
+    return detail::kPercentToLevel[static_cast<size_t>(percent < 0 ? 0 : (percent > kMaxWemoPercent ? kMaxWemoPercent : percent))];
+}
+
+constexpr uint8_t MatterLevelToWemoPercent(uint8_t level)
+{
+    return detail::kLevelToPercent[level > kMaxMatterLevel ? kMaxMatterLevel : level];
+}
+
+} // namespace wemo_bridge
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace wemo_bridge {
+
+// Packed Matter-side state of one bridged light, one 32-bit word per light
+// so a whole fleet can be compared with wide loads.
+constexpr uint32_t kLightReachableBit = 1u << 0;
+constexpr uint32_t kLightOnBit        = 1u << 1;
+constexpr uint32_t kLightLevelShift   = 8; // Matter level 0-254; 0 for on/off-only lights
+constexpr uint32_t kLightLevelMask    = 0xFFu << kLightLevelShift;
+
+constexpr uint32_t PackLightState(bool reachable, bool on, uint8_t level)
+{
+    return (reachable ? kLightReachableBit : 0u) | (on ? kLightOnBit : 0u) | (static_cast<uint32_t>(level) << kLightLevelShift);
+}
+
+constexpr uint8_t LightLevel(uint32_t state)
+{
+    return static_cast<uint8_t>((state & kLightLevelMask) >> kLightLevelShift);
+}
+
+// Command-echo suppression settle windows.  A command's window opens when
+// it is issued and lasts one timeout (learned per light, see
+// LightStateTable::SettleTimeout); it closes early as soon as the device
+// reports the commanded value, and shrinks to kEventSlack once the device
+// has acknowledged the command.
+constexpr auto kDefaultSettleTimeout = std::chrono::milliseconds(2000); // until the first RTT sample
+constexpr auto kMinSettleTimeout     = std::chrono::milliseconds(300);
+constexpr auto kMaxSettleTimeout     = std::chrono::milliseconds(5000);
+// Engine event path on top of the command round trip.
+constexpr auto kEventSlack = std::chrono::milliseconds(250);
+
+// The newest command for one attribute of one light, i.e. the desired
+// value while it is waiting for the device to report it.
+struct PendingCommand
+{
+    using TimePoint = std::chrono::steady_clock::time_point;
+
+    uint32_t seq = 0;   // 0 = none ever issued
+    int16_t value = -1; // OnOff 0/1 or WeMo percent; -1 = no command pending
+    TimePoint issued {};
+    TimePoint until {};
+
+    bool Active(TimePoint now) const { return value >= 0 && now <= until; }
+};
+
+enum class CommandAttribute : uint8_t
+{
+    kOnOff,
+    kLevel,
+};
+
+// What to do with a value the device reported for an attribute.
+enum class ReportVerdict : uint8_t
+{
+    kApply,     // nothing pending: the report is the device's state
+    kConfirmed, // matches the pending command, which is now done
+    kSuppress,  // contradicts a command still settling: stale echo
+};
+
+// Hot per-light state of the bridge as parallel arrays, indexed by the
+// light's position in the bridge's device list.  Names, UDNs and Device
+// objects stay in the cold per-light struct.  Matter thread only.
+struct LightStateTable
+{
+    using TimePoint = std::chrono::steady_clock::time_point;
+
+    std::vector<uint32_t> state; // PackLightState()
+
+    // Desired state: the newest OnOff and level commands.  Sequence numbers
+    // come from next_seq, shared by both attributes, so a completion can be
+    // matched to the command it belongs to.
+    std::vector<PendingCommand> pending_onoff;
+    std::vector<PendingCommand> pending_level; // value in WeMo percent
+    std::vector<uint32_t> next_seq;
+
+    // Smoothed command round trip and its mean deviation (RFC 6298), in
+    // microseconds; srtt_us is 0 until the first sample.
+    std::vector<uint32_t> srtt_us;
+    std::vector<uint32_t> rttvar_us;
+
+    // Heap bytes per position across all arrays, for capacity planning.
+    static constexpr size_t kBytesPerLight = sizeof(uint32_t) + 2 * sizeof(PendingCommand) + 3 * sizeof(uint32_t);
+
+    size_t Size() const { return state.size(); }
+
+    // New positions start unreachable with no pending command and no RTT
+    // history.
+    void Resize(size_t count);
+    // Drops pending commands (the light changed hands or a command failed);
+    // RTT history stays.
+    void ClearCommands(size_t position);
+
+    // Records a command for `value` and returns its sequence number.
+    uint32_t BeginCommand(size_t position, CommandAttribute attribute, int16_t value, TimePoint now);
+
+    // A command finished in the adapter.  Feeds the RTT estimate; if it is
+    // still the pending one, an acknowledgement shortens its window and a
+    // failure drops it.
+    void CommandCompleted(size_t position, CommandAttribute attribute, uint32_t seq, bool acknowledged,
+                          std::chrono::microseconds round_trip, TimePoint now);
+
+    ReportVerdict OnReport(size_t position, CommandAttribute attribute, int16_t value, TimePoint now);
+
+    // Whether an OnOff command was issued within the last settle timeout,
+    // confirmed or not.  Controllers follow an OnOff write with level
+    // writes of their own inside that time.
+    bool RecentOnOffCommand(size_t position, TimePoint now) const;
+
+    std::chrono::microseconds SettleTimeout(size_t position) const;
+
+private:
+    PendingCommand & Pending(size_t position, CommandAttribute attribute)
+    {
+        return (attribute == CommandAttribute::kOnOff) ? pending_onoff[position] : pending_level[position];
+    }
+    void AddRttSample(size_t position, std::chrono::microseconds round_trip);
+};
+
+// Appends every position where current and reported differ to `changed`
+// and returns how many were appended.  Blocks of words are compared with a
+// branch-free reduction the compiler vectorizes; only blocks that contain a
+// difference are scanned one by one, so an unchanged fleet costs one pass of
+// wide compares.
+size_t DiffLightStates(const uint32_t * current, const uint32_t * reported, size_t count, std::vector<uint32_t> & changed);
+
+} // namespace wemo_bridge
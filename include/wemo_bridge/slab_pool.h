@@ -0,0 +1,98 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace wemo_bridge {
+
+// Fixed-size blocks carved out of cache-line-aligned chunks.
+//
+// A block never moves while it is allocated, so the CHIP SDK can keep
+// pointers into it (Device objects, DataVersion arrays) however much the
+// pool grows.  Freed blocks go on a free list and are handed out again
+// before a new chunk is allocated; chunks are only released when the pool
+// is destroyed.  Thread-safe.
+class SlabPool
+{
+public:
+    static constexpr size_t kCacheLine = 64;
+
+    // block_size is rounded up to whole cache lines.
+    explicit SlabPool(size_t block_size, size_t blocks_per_chunk = 16);
+    ~SlabPool();
+
+    SlabPool(const SlabPool &)             = delete;
+    SlabPool & operator=(const SlabPool &) = delete;
+
+    void * Allocate();
+    // block must come from Allocate() on this pool.
+    void Free(void * block);
+
+    size_t BlockSize() const { return mBlockSize; }
+    size_t ChunkCount() const;
+    size_t InUse() const;
+
+private:
+    const size_t mBlockSize;
+    const size_t mBlocksPerChunk;
+
+    mutable std::mutex mMutex;
+    std::vector<void *> mChunks;
+    std::vector<void *> mFreeBlocks;
+    size_t mInUse = 0;
+};
+
+// Destroys the object and returns its block to the pool.  Converts from the
+// deleter of a derived type, so SlabPtr<Derived> moves into SlabPtr<Base>
+// (Base needs a virtual destructor, as with std::default_delete).
+template <typename T>
+struct SlabDeleter
+{
+    SlabPool * pool = nullptr;
+
+    SlabDeleter() = default;
+    explicit SlabDeleter(SlabPool * p) : pool(p) {}
+    template <typename U>
+    SlabDeleter(const SlabDeleter<U> & other) : pool(other.pool)
+    {}
+
+    void operator()(T * object) const
+    {
+        object->~T();
+        pool->Free(object);
+    }
+};
+
+template <typename T>
+using SlabPtr = std::unique_ptr<T, SlabDeleter<T>>;
+
+// A SlabPool whose blocks fit every one of Ts, so MakeInSlab() can check at
+// compile time that an object fits instead of failing at run time.
+template <typename... Ts>
+class SlabPoolFor : public SlabPool
+{
+public:
+    static_assert(sizeof...(Ts) > 0, "a pool needs at least one type");
+    static constexpr size_t kObjectSize = std::max({ sizeof(Ts)... });
+
+    explicit SlabPoolFor(size_t blocks_per_chunk = 16) : SlabPool(kObjectSize, blocks_per_chunk) {}
+};
+
+// Constructs a T in a block of `pool`; never returns null.  A T that does
+// not fit the pool's blocks does not compile.
+template <typename T, typename... Ts, typename... Args>
+SlabPtr<T> MakeInSlab(SlabPoolFor<Ts...> & pool, Args &&... args)
+{
+    static_assert(alignof(T) <= SlabPool::kCacheLine, "over-aligned type");
+    static_assert(sizeof(T) <= SlabPoolFor<Ts...>::kObjectSize, "type does not fit the pool's blocks");
+    void * block = pool.Allocate();
+    return SlabPtr<T>(new (block) T(std::forward<Args>(args)...), SlabDeleter<T>(&pool));
+}
+
+} // namespace wemo_bridge
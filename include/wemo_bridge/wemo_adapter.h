@@ -1,5 +1,7 @@
 #pragma once
 
+#include <chrono>
+#include <cstdint>
 #include <functional>
 #include <string>
 #include <vector>
@@ -18,15 +20,179 @@ struct WemoStateEvent
 
 using StateEventCallback = std::function<void(const WemoStateEvent &)>;
 
+enum class CommandStatus : uint8_t
+{
+    kOk,
+    kInvalidHandle,     // handle did not come from Resolve()
+    kUnresolved,        // discovery does not know the device
+    kEngineUnavailable, // engine not initialized or not built in
+    kEngineError,       // engine rejected the command; see engine_rc
+    kSuperseded,        // replaced by a newer command of the same kind before it ran
+    kRejected,          // command queue full or adapter shut down
+    kUnsupported,       // adapter cannot send commands (stub)
+};
+
+inline const char * CommandStatusName(CommandStatus status)
+{
+    switch (status)
+    {
+    case CommandStatus::kOk:
+        return "ok";
+    case CommandStatus::kInvalidHandle:
+        return "invalid-handle";
+    case CommandStatus::kUnresolved:
+        return "unresolved";
+    case CommandStatus::kEngineUnavailable:
+        return "engine-unavailable";
+    case CommandStatus::kEngineError:
+        return "engine-error";
+    case CommandStatus::kSuperseded:
+        return "superseded";
+    case CommandStatus::kRejected:
+        return "rejected";
+    case CommandStatus::kUnsupported:
+        return "unsupported";
+    }
+    return "unknown";
+}
+
+struct CommandResult
+{
+    CommandStatus status = CommandStatus::kOk;
+    int engine_rc        = 0; // engine return code; 0 when the engine was not called
+    // Time spent in the engine call alone; excludes queueing and rate limiting.
+    std::chrono::microseconds round_trip { 0 };
+
+    bool Succeeded() const { return status == CommandStatus::kOk; }
+};
+
+using CommandCallback = std::function<void(const CommandResult &)>;
+
+// Opaque reference to a device, obtained once per UDN from
+// WemoAdapter::Resolve().  Trivially copyable and valid for the lifetime of
+// the adapter, including across rediscovery; commands through a handle skip
+// the UDN string lookup.
+struct DeviceHandle
+{
+    static constexpr uint32_t kInvalid = UINT32_MAX;
+
+    uint32_t value = kInvalid;
+
+    bool IsValid() const { return value != kInvalid; }
+    bool operator==(const DeviceHandle & other) const { return value == other.value; }
+    bool operator!=(const DeviceHandle & other) const { return value != other.value; }
+};
+
+// One entry of WemoAdapter::ApplyBatch().
+struct DeviceCommand
+{
+    enum class Kind : uint8_t
+    {
+        kOnOff,
+        kLevel,
+    };
+
+    DeviceHandle device;
+    Kind kind             = Kind::kOnOff;
+    bool on               = false; // kOnOff
+    uint8_t level_percent = 0;     // kLevel
+
+    static DeviceCommand OnOff(DeviceHandle device, bool on) { return { device, Kind::kOnOff, on, 0 }; }
+    static DeviceCommand Level(DeviceHandle device, uint8_t percent) { return { device, Kind::kLevel, false, percent }; }
+};
+
 class WemoAdapter
 {
 public:
     virtual ~WemoAdapter() = default;
 
+    // Blocks until the backing engine answers or `budget` runs out.  Returns
+    // false on timeout; calling it again starts a new wait.
+    virtual bool WaitUntilReady(std::chrono::milliseconds budget)
+    {
+        (void) budget;
+        return true;
+    }
     virtual std::vector<WemoDevice> Discover() = 0;
     virtual void Refresh() {}
-    virtual bool SetOnOff(const std::string & udn, bool on) = 0;
-    virtual bool SetLevelPercent(const std::string & udn, uint8_t percent) = 0;
+
+    // Returns the handle for udn; the same UDN always maps to the same
+    // handle.  The device does not have to be discovered yet.  Returns an
+    // invalid handle for an empty UDN or when the adapter cannot address
+    // devices at all (stub).
+    virtual DeviceHandle Resolve(const std::string & udn) = 0;
+
+    // Resolve() for many UDNs at once; one handle per UDN, in input order.
+    virtual std::vector<DeviceHandle> ResolveMany(const std::vector<std::string> & udns)
+    {
+        std::vector<DeviceHandle> handles;
+        handles.reserve(udns.size());
+        for (const auto & udn : udns)
+        {
+            handles.push_back(Resolve(udn));
+        }
+        return handles;
+    }
+
+    // Synchronous commands; block the caller for the engine round trip.
+    virtual CommandResult SetOnOff(DeviceHandle device, bool on) = 0;
+    virtual CommandResult SetLevelPercent(DeviceHandle device, uint8_t percent) = 0;
+
+    // UDN-based convenience wrappers.  Implementations override the handle
+    // overloads and bring these into scope with a using-declaration.
+    CommandResult SetOnOff(const std::string & udn, bool on) { return SetOnOff(Resolve(udn), on); }
+    CommandResult SetLevelPercent(const std::string & udn, uint8_t percent) { return SetLevelPercent(Resolve(udn), percent); }
+
+    CommandResult Apply(const DeviceCommand & command)
+    {
+        return (command.kind == DeviceCommand::Kind::kLevel) ? SetLevelPercent(command.device, command.level_percent)
+                                                             : SetOnOff(command.device, command.on);
+    }
+
+    // Runs every command and returns one result per command, in input order.
+    // Commands for different devices may run in parallel; commands for the
+    // same device run in input order.  Blocks until all of them completed,
+    // so it must not be called from a CommandCallback.  The default runs
+    // them one after another.
+    virtual std::vector<CommandResult> ApplyBatch(const std::vector<DeviceCommand> & commands)
+    {
+        std::vector<CommandResult> results;
+        results.reserve(commands.size());
+        for (const auto & command : commands)
+        {
+            results.push_back(Apply(command));
+        }
+        return results;
+    }
+
+    // Asynchronous commands.  Return false without calling `done` when the
+    // command cannot be queued; otherwise `done` (if set) runs exactly once
+    // with the result, on a thread owned by the adapter.  A queued command
+    // that is overtaken by a newer one of the same kind for the same device
+    // completes with kSuperseded, reported on the thread that queued the
+    // newer one.  The default runs the command inline.
+    virtual bool SetOnOffAsync(DeviceHandle device, bool on, CommandCallback done)
+    {
+        const CommandResult result = SetOnOff(device, on);
+        if (done)
+        {
+            done(result);
+        }
+        return true;
+    }
+    virtual bool SetLevelPercentAsync(DeviceHandle device, uint8_t percent, CommandCallback done)
+    {
+        const CommandResult result = SetLevelPercent(device, percent);
+        if (done)
+        {
+            done(result);
+        }
+        return true;
+    }
+
+    // Finishes queued asynchronous commands and stops accepting new ones.
+    virtual void Shutdown() {}
+
     virtual void RegisterStateCallback(StateEventCallback cb) = 0;
 };
 
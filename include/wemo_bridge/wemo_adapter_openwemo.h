@@ -1,9 +1,19 @@
 #pragma once
 
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
 #include <mutex>
+#include <optional>
 #include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
+#include "wemo_bridge/command_executor.h"
 #include "wemo_bridge/wemo_adapter.h"
 
 namespace wemo_bridge {
@@ -12,17 +22,129 @@ class WemoAdapterOpenWemo final : public WemoAdapter
 {
 public:
     explicit WemoAdapterOpenWemo(std::string engine_socket);
+    ~WemoAdapterOpenWemo() override;
 
+    // Probes the engine with exponential backoff until it answers.
+    bool WaitUntilReady(std::chrono::milliseconds budget) override;
     std::vector<WemoDevice> Discover() override;
     void Refresh() override;
-    bool SetOnOff(const std::string & udn, bool on) override;
-    bool SetLevelPercent(const std::string & udn, uint8_t percent) override;
+
+    using WemoAdapter::SetLevelPercent;
+    using WemoAdapter::SetOnOff;
+
+    DeviceHandle Resolve(const std::string & udn) override;
+    // Allocates handles for every unknown UDN in one index update instead
+    // of copying the index once per UDN.
+    std::vector<DeviceHandle> ResolveMany(const std::vector<std::string> & udns) override;
+    CommandResult SetOnOff(DeviceHandle device, bool on) override;
+    CommandResult SetLevelPercent(DeviceHandle device, uint8_t percent) override;
+
+    // Runs on a worker pool started on first use, one strand per device;
+    // queued commands of the same kind coalesce (latest wins).  Returns false
+    // when CommandExecutor::kDefaultMaxPending commands are outstanding or
+    // after Shutdown().
+    bool SetOnOffAsync(DeviceHandle device, bool on, CommandCallback done) override;
+    bool SetLevelPercentAsync(DeviceHandle device, uint8_t percent, CommandCallback done) override;
+    // Fans out to the same pool, one task per command queued behind that
+    // device's pending commands.  Wall time is about one round trip per
+    // ceil(devices / workers) plus rate limiting.
+    std::vector<CommandResult> ApplyBatch(const std::vector<DeviceCommand> & commands) override;
+    void Shutdown() override;
+
+    // Size of the command worker pool, i.e. how many devices are commanded
+    // in parallel.  Only takes effect before the first asynchronous or batch
+    // command.
+    void SetCommandConcurrency(size_t workers);
+
     void RegisterStateCallback(StateEventCallback cb) override;
 
+    // Per-device token bucket for SetOnOff/SetLevelPercent: up to `burst`
+    // commands back to back, refilled at `per_second`.  A synchronous
+    // command without a token blocks the calling thread until one is
+    // available; an asynchronous or batch command stays queued (and can be
+    // superseded) until its device has one, without holding a worker.
+    // per_second <= 0 disables the limit.
+    static constexpr double kDefaultCommandsPerSecond = 4.0;
+    static constexpr double kDefaultCommandBurst      = 2.0;
+    void SetCommandRateLimit(double per_second, double burst);
+
 private:
+    struct TokenBucket
+    {
+        double tokens = 0;
+        std::chrono::steady_clock::time_point refilled;
+    };
+
+    // UDN resolution cache.  Each UDN is interned once into a dense
+    // DeviceHandle that never changes; wemo ids are stored in a table indexed
+    // by handle.  Both are immutable snapshots replaced atomically, so command
+    // threads resolve without taking a lock and never observe a partially
+    // rebuilt (or empty) cache.  Handles are only ever added.  The id table
+    // is rebuilt from every complete device list (Discover() and the miss
+    // path of ResolveWemoId()), so a UDN the engine stops reporting goes
+    // back to kUnresolvedWemoId rather than keeping a stale id the engine
+    // may since have given to another device.
+    struct HandleIndex
+    {
+        std::unordered_map<std::string, uint32_t> by_udn;
+        std::vector<std::string> udns; // indexed by handle
+    };
+    using WemoIdTable = std::vector<int>;
+    static constexpr int kUnresolvedWemoId = -1;
+
+    // Misses are resolved with one discovery pass shared by every concurrent
+    // caller; devices that still do not resolve fail fast for kUnresolvedTtl.
+    static constexpr auto kUnresolvedTtl          = std::chrono::seconds(30);
+    static constexpr size_t kMaxUnresolvedEntries = 256;
+
+    // Coalescing kinds for the command strands.
+    static constexpr uint32_t kCommandKindOnOff = 1;
+    static constexpr uint32_t kCommandKindLevel = 2;
+
+    CommandExecutor * AcquireExecutor();
+    bool SubmitCommand(const DeviceCommand & command, uint32_t kind, CommandCallback done);
+    // Sends one command; await_token is false on the executor, which took
+    // the token when it admitted the task.
+    CommandResult Send(const DeviceCommand & command, bool await_token);
+    TokenBucket & RefillTokensLocked(DeviceHandle device, std::chrono::steady_clock::time_point now);
+    // Blocks until the device has a token and takes it.
+    void AwaitCommandToken(DeviceHandle device);
+    // Takes a token and returns now if the device has one; otherwise returns
+    // when it will, without reserving it.
+    std::chrono::steady_clock::time_point TryTakeCommandToken(DeviceHandle device);
+    std::optional<int> LookupWemoId(DeviceHandle device) const;
+    std::optional<int> ResolveWemoId(DeviceHandle device);
+    std::string UdnOf(DeviceHandle device) const;
+    // Interns every UDN and records its wemo id; kUnresolvedWemoId entries
+    // are only interned and never overwrite a known id.  With complete set,
+    // resolved is the engine's whole device list and every UDN missing from
+    // it is left unresolved.
+    void PublishWemoIds(const std::vector<std::pair<std::string, int>> & resolved, bool complete);
+
     std::string mEngineSocket;
-    mutable std::mutex mCacheMutex;
-    std::unordered_map<std::string, int> mUdnToWemoId;
+
+    // Readers use std::atomic_load; writers hold mPublishMutex and publish
+    // the id table before the handle index so every visible handle has a
+    // slot.
+    std::shared_ptr<const HandleIndex> mHandles;
+    std::shared_ptr<const WemoIdTable> mWemoIds;
+    std::mutex mPublishMutex;
+
+    std::mutex mResolveMutex;
+    std::condition_variable mResolveCv;
+    bool mResolveInFlight       = false;
+    uint64_t mResolveGeneration = 0; // completed miss-resolution passes
+    std::unordered_map<uint32_t, std::chrono::steady_clock::time_point> mUnresolvedUntil; // by handle
+
+    std::mutex mRateMutex;
+    double mCommandsPerSecond = kDefaultCommandsPerSecond;
+    double mCommandBurst      = kDefaultCommandBurst;
+    std::unordered_map<uint32_t, TokenBucket> mTokenBuckets; // by handle
+
+    std::mutex mExecutorMutex;
+    std::unique_ptr<CommandExecutor> mExecutor;
+    size_t mCommandWorkers = CommandExecutor::kDefaultWorkerCount;
+    bool mShutDown         = false;
 };
 
 } // namespace wemo_bridge
@@ -7,9 +7,13 @@ namespace wemo_bridge {
 class WemoAdapterStub final : public WemoAdapter
 {
 public:
+    using WemoAdapter::SetLevelPercent;
+    using WemoAdapter::SetOnOff;
+
     std::vector<WemoDevice> Discover() override;
-    bool SetOnOff(const std::string & udn, bool on) override;
-    bool SetLevelPercent(const std::string & udn, uint8_t percent) override;
+    DeviceHandle Resolve(const std::string & udn) override;
+    CommandResult SetOnOff(DeviceHandle device, bool on) override;
+    CommandResult SetLevelPercent(DeviceHandle device, uint8_t percent) override;
 };
 
 } // namespace wemo_bridge
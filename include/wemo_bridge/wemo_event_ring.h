@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+#include "wemo_bridge/wemo_adapter.h"
+
+namespace wemo_bridge {
+
+// Preallocated hand-off of WeMo state events from engine threads to a single
+// consumer (the Matter thread).
+//
+// Events are coalesced per wemo_id: each device owns one slot holding only
+// its newest state, and a slot sits in the queue at most once no matter how
+// many events arrive before the consumer gets to it.  Publish() is lock-free
+// and never allocates.  The first Publish() after a drain calls
+// schedule_drain exactly once; the consumer then calls Drain() to apply
+// everything queued so far in one batch.
+class WemoEventRing
+{
+public:
+    using ScheduleFn = std::function<void()>;
+
+    // capacity is rounded up to a power of two and bounds the number of
+    // distinct wemo ids the ring can track.
+    WemoEventRing(size_t capacity, ScheduleFn schedule_drain);
+
+    WemoEventRing(const WemoEventRing &)             = delete;
+    WemoEventRing & operator=(const WemoEventRing &) = delete;
+
+    // Safe from any number of threads.  Returns false (and counts a drop)
+    // when every slot is taken by other wemo ids.
+    bool Publish(const WemoStateEvent & ev);
+
+    // Consumer side; call from one thread only.  Applies the newest state of
+    // every device that changed since the last drain, in the order the
+    // devices first changed, and returns how many were applied.
+    size_t Drain(const std::function<void(const WemoStateEvent &)> & apply);
+
+    uint64_t DroppedCount() const { return mDropped.load(std::memory_order_relaxed); }
+
+    // Bytes of the preallocated slot and queue arrays.
+    size_t MemoryBytes() const { return (mMask + 1) * (sizeof(Slot) + sizeof(Cell)); }
+
+private:
+    static constexpr int kEmptyWemoId = INT32_MIN;
+
+    struct Slot
+    {
+        std::atomic<int> wemo_id { kEmptyWemoId };
+        // Packed newest state plus kQueuedBit while the slot is in the queue.
+        std::atomic<uint64_t> state { 0 };
+    };
+
+    // Cell of the bounded MPSC queue of slot indices (Vyukov).
+    struct Cell
+    {
+        std::atomic<size_t> sequence { 0 };
+        uint32_t slot = 0;
+    };
+
+    Slot * FindOrClaimSlot(int wemo_id);
+    void Enqueue(uint32_t slot);
+    bool Dequeue(uint32_t & slot);
+
+    size_t mMask;
+    std::unique_ptr<Slot[]> mSlots;
+    std::unique_ptr<Cell[]> mCells;
+    alignas(64) std::atomic<size_t> mEnqueuePos { 0 };
+    alignas(64) size_t mDequeuePos = 0; // consumer only
+    alignas(64) std::atomic<bool> mDrainScheduled { false };
+    std::atomic<uint64_t> mDropped { 0 };
+    ScheduleFn mScheduleDrain;
+};
+
+} // namespace wemo_bridge
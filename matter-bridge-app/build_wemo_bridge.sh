@@ -42,6 +42,25 @@ if [[ -f "$PATCH_FILE" ]]; then
   fi
 fi
 
+# Bridged device capacity (dynamic endpoint count); defaults to 256 in
+# include/CHIPProjectAppConfig.h.  The override goes through a header so the
+# SDK libraries and the app agree on the size of the endpoint tables.
+CAPACITY_HEADER="include/WemoBridgeCapacity.h"
+if [[ -n "${WEMO_BRIDGE_MAX_DEVICES:-}" ]]; then
+  if ! [[ "${WEMO_BRIDGE_MAX_DEVICES}" =~ ^[1-9][0-9]*$ ]] || (( WEMO_BRIDGE_MAX_DEVICES > 65000 )); then
+    echo "WEMO_BRIDGE_MAX_DEVICES must be between 1 and 65000" >&2
+    exit 1
+  fi
+  CAPACITY_LINE="#define WEMO_BRIDGE_MAX_DEVICES ${WEMO_BRIDGE_MAX_DEVICES}"
+  # Rewrite only on change so an unchanged capacity does not rebuild the SDK.
+  if [[ ! -f "$CAPACITY_HEADER" ]] || ! grep -qxF "$CAPACITY_LINE" "$CAPACITY_HEADER"; then
+    printf '#pragma once\n// Generated by build_wemo_bridge.sh; do not edit.\n%s\n' "$CAPACITY_LINE" >"$CAPACITY_HEADER"
+  fi
+  echo "Bridged device capacity: ${WEMO_BRIDGE_MAX_DEVICES}"
+else
+  rm -f "$CAPACITY_HEADER"
+fi
+
 HOME=/tmp /bin/bash "${CHIP_ROOT}/scripts/examples/gn_build_example.sh" . out/ethernet
 
 echo "Built: $(pwd)/out/ethernet/wemo-bridge-app"
@@ -1,7 +1,20 @@
 #pragma once
 
-// Bridge endpoint capacity used by the Linux bridge-app model.
-#define CHIP_DEVICE_CONFIG_DYNAMIC_ENDPOINT_COUNT 16
+// Optional per-build override, written by build_wemo_bridge.sh when
+// WEMO_BRIDGE_MAX_DEVICES is set.  Every SDK translation unit includes this
+// header, so the endpoint tables are sized the same everywhere; never pass
+// the count as a define on a single target.
+#if __has_include(<WemoBridgeCapacity.h>)
+#include <WemoBridgeCapacity.h>
+#endif
+
+// Number of bridged WeMo lights, one dynamic endpoint each.  Each endpoint
+// costs well under 1 KiB of bridge and SDK RAM (ApplicationInit logs the
+// breakdown), so sites with hundreds of devices fit comfortably.
+#ifndef WEMO_BRIDGE_MAX_DEVICES
+#define WEMO_BRIDGE_MAX_DEVICES 256
+#endif
+#define CHIP_DEVICE_CONFIG_DYNAMIC_ENDPOINT_COUNT WEMO_BRIDGE_MAX_DEVICES
 #define CHIP_CONFIG_USE_ENDPOINT_UNIQUE_ID 0
 
 // Advertise this node as an Aggregator so commissioners/controllers classify
@@ -43,12 +43,23 @@
 
 #include <pthread.h>
 #include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
 
 #include "CommissionableInit.h"
 #include "Device.h"
 #include "DeviceDimmable.h"
 #include "main.h"
+#include "wemo_bridge/device_snapshot.h"
+#include "wemo_bridge/dirty_attribute_set.h"
+#include "wemo_bridge/endpoint_registry.h"
+#include "wemo_bridge/endpoint_slots.h"
+#include "wemo_bridge/level_map.h"
+#include "wemo_bridge/light_state_table.h"
+#include "wemo_bridge/slab_pool.h"
 #include "wemo_bridge/wemo_adapter_openwemo.h"
+#include "wemo_bridge/wemo_event_ring.h"
 #include <app/server/Server.h>
 
 #include <app/clusters/identify-server/IdentifyCluster.h>
@@ -59,14 +70,22 @@
 #include <algorithm>
 #include <array>
 #include <cassert>
+#include <cerrno>
 #include <cinttypes>
 #include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <future>
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <string>
 #include <thread>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 using namespace chip;
@@ -96,6 +115,20 @@ EndpointId gFirstDynamicEndpointId;
 // Power source is on the same endpoint as the composed device
 Device * gDevices[CHIP_DEVICE_CONFIG_DYNAMIC_ENDPOINT_COUNT + 1];
 
+// Dynamic endpoint indices are uint16_t in the ember API.
+static_assert(CHIP_DEVICE_CONFIG_DYNAMIC_ENDPOINT_COUNT < UINT16_MAX, "too many dynamic endpoints");
+
+// Which gDevices slots are free, and which slot each Device holds.
+wemo_bridge::EndpointSlots gEndpointSlots(CHIP_DEVICE_CONFIG_DYNAMIC_ENDPOINT_COUNT);
+
+void FlushDirtyAttributes(intptr_t);
+
+// Attributes changed since the last report flush, by gDevices slot.  Every
+// change in one event-loop turn is reported by one FlushDirtyAttributes().
+wemo_bridge::DirtyAttributeSet gDirtyAttributes(CHIP_DEVICE_CONFIG_DYNAMIC_ENDPOINT_COUNT, [] {
+    TEMPORARY_RETURN_IGNORED PlatformMgr().ScheduleWork(FlushDirtyAttributes, 0);
+});
+
 const int16_t minMeasuredValue     = -27315;
 const int16_t maxMeasuredValue     = 32766;
 const int16_t initialMeasuredValue = 100;
@@ -243,30 +276,287 @@ DeviceOnOff ActionLight4("Action Light 4", "Room 2");
 // WeMo bridge adapter talking to wemo_ctrl/openwemo engine.
 wemo_bridge::WemoAdapterOpenWemo gWemoAdapter("127.0.0.1:49153");
 
+#ifndef WEMO_ENDPOINT_REGISTRY_PATH
+#define WEMO_ENDPOINT_REGISTRY_PATH "/tmp/wemo-bridge/chip/endpoint-map.sqlite3"
+#endif
+
+// Persistent UDN -> endpoint id map.  Created in ApplicationInit once the
+// first dynamic endpoint id is known so assigned ids never overlap the fixed
+// endpoints.
+std::unique_ptr<wemo_bridge::EndpointRegistry> gEndpointRegistry;
+
+EndpointId NextTransientEndpointId();
+
+#ifndef WEMO_DEVICE_SNAPSHOT_PATH
+#define WEMO_DEVICE_SNAPSHOT_PATH "/tmp/wemo-bridge/chip/devices.snapshot"
+#endif
+
 // Max cluster count across both endpoint types for DataVersion storage.
 constexpr size_t kMaxBridgedClusters = MATTER_ARRAY_SIZE(bridgedDimmableLightClusters);
 
 struct BridgedWemoLight
 {
+    uint32_t position = 0; // in gBridgedWemoLights and gWemoLightState
     int wemo_id = 0;
     std::string udn;
+    wemo_bridge::DeviceHandle handle; // resolved once from udn; used for commands
     bool is_dimmable = false;
-    std::unique_ptr<Device> device;  // DeviceOnOff or DeviceDimmable
+    wemo_bridge::SlabPtr<Device> device; // DeviceOnOff or DeviceDimmable; nullptr while vacant
     std::array<DataVersion, kMaxBridgedClusters> dataVersions {};
+    // First discovery pass that did not report the light; zero while it is reported.
+    std::chrono::steady_clock::time_point missing_since {};
+    // Commands that failed in a row; reset by any command that succeeds.
+    uint8_t failed_commands = 0;
+};
+
+// A single failed command is usually a lost packet, and an unreachable light
+// refuses writes until an event or discovery pass restores it, so it takes
+// this many failures in a row to report the light unreachable.
+constexpr uint8_t kFailedCommandsBeforeUnreachable = 3;
+
+// Slab storage for bridged lights and their Devices.  The SDK keeps
+// pointers to both (the Device through gDevices, the entry's DataVersion
+// array through the endpoint), so they must never move; slab blocks stay
+// put however far the pools grow, come from a few cache-aligned chunks
+// rather than one heap block each, and are reused when a light is removed.
+// Each pool is sized for the types it holds, so MakeInSlab() rejects
+// anything that does not fit at compile time.  Declared before
+// gBridgedWemoLights so they outlive it.
+wemo_bridge::SlabPoolFor<DeviceOnOff, DeviceDimmable> gWemoDevicePool;
+wemo_bridge::SlabPoolFor<BridgedWemoLight> gWemoLightPool;
+
+// Cold per-light data.  The hot state (mirrored Device state, pending
+// commands, round-trip estimates) lives in gWemoLightState at the same position,
+// so reconcile can diff the whole fleet without touching these entries.
+std::vector<wemo_bridge::SlabPtr<BridgedWemoLight>> gBridgedWemoLights;
+wemo_bridge::LightStateTable gWemoLightState;
+
+// Positions of removed lights.  A removed light leaves a vacant entry that
+// the next new light reuses, so positions held by the lookup tables below
+// stay meaningful.
+std::vector<uint32_t> gVacantWemoLights;
+
+size_t BridgedWemoLightCount()
+{
+    return gBridgedWemoLights.size() - gVacantWemoLights.size();
+}
+
+// O(1) lookup tables holding positions in gBridgedWemoLights, so writes,
+// events and command results never scan the light list.  A position can
+// go stale when a light is re-published or gets a new wemo id; lookups
+// check the entry they land on instead of keeping every table exact.
+constexpr uint32_t kNoWemoLight = UINT32_MAX;
+// The engine numbers devices densely from zero, so ids below this limit
+// are indexed directly; anything else falls back to a hash map.
+constexpr int kDirectWemoIdLimit = 1 << 16;
+
+std::array<uint32_t, CHIP_DEVICE_CONFIG_DYNAMIC_ENDPOINT_COUNT> gWemoLightByEndpointIndex; // by dynamic endpoint index
+std::vector<uint32_t> gWemoLightByWemoId;
+std::unordered_map<int, uint32_t> gWemoLightBySparseWemoId;
+std::vector<uint32_t> gWemoLightByHandle; // by DeviceHandle::value
+std::unordered_map<std::string, uint32_t> gWemoLightByUdn;
+
+void ResetWemoLightIndex()
+{
+    gWemoLightByEndpointIndex.fill(kNoWemoLight);
+    gWemoLightByWemoId.clear();
+    gWemoLightBySparseWemoId.clear();
+    gWemoLightByHandle.clear();
+    gWemoLightByUdn.clear();
+}
+
+uint32_t PositionOf(const BridgedWemoLight & entry)
+{
+    return entry.position;
+}
+
+BridgedWemoLight * WemoLightAt(uint32_t position)
+{
+    return (position < gBridgedWemoLights.size()) ? gBridgedWemoLights[position].get() : nullptr;
+}
+
+// Mirrors the Device state of `entry` into gWemoLightState.  Call after
+// every setter on a bridged light's Device.
+void SyncWemoLightState(const BridgedWemoLight & entry)
+{
+    auto * light        = static_cast<DeviceOnOff *>(entry.device.get());
+    const uint8_t level = entry.is_dimmable ? static_cast<DeviceDimmable *>(entry.device.get())->GetLevel() : 0;
+    gWemoLightState.state[PositionOf(entry)] = wemo_bridge::PackLightState(light->IsReachable(), light->IsOn(), level);
+}
+
+void SetIndexSlot(std::vector<uint32_t> & table, size_t key, uint32_t position)
+{
+    if (key >= table.size())
+    {
+        table.resize(key + 1, kNoWemoLight);
+    }
+    table[key] = position;
+}
 
-    // --- Command-echo suppression ---
-    // Keep commanded values for a short settle window so stale post-command
-    // events from wemo_ctrl cannot flip state back.
-    int commandedOnOff = -1;  // -1 = no pending command, 0 = OFF, 1 = ON
-    int commandedLevel = -1;  // -1 = no pending command, 0-254 = level
-    std::chrono::steady_clock::time_point commandedOnOffUntil;
-    std::chrono::steady_clock::time_point commandedLevelUntil;
+// Records the current UDN, wemo id and handle of `entry`.  Call again
+// whenever one of them changes.
+void IndexWemoLight(const BridgedWemoLight & entry)
+{
+    const uint32_t position = PositionOf(entry);
+    if (!entry.udn.empty())
+    {
+        gWemoLightByUdn[entry.udn] = position;
+    }
+    if (entry.wemo_id >= 0 && entry.wemo_id < kDirectWemoIdLimit)
+    {
+        SetIndexSlot(gWemoLightByWemoId, static_cast<size_t>(entry.wemo_id), position);
+    }
+    else if (entry.wemo_id != wemo_bridge::kSnapshotWemoId)
+    {
+        gWemoLightBySparseWemoId[entry.wemo_id] = position;
+    }
+    if (entry.handle.IsValid())
+    {
+        SetIndexSlot(gWemoLightByHandle, entry.handle.value, position);
+    }
+}
+
+void IndexWemoLightEndpoint(const BridgedWemoLight & entry, int endpointIndex)
+{
+    if (endpointIndex >= 0 && static_cast<size_t>(endpointIndex) < gWemoLightByEndpointIndex.size())
+    {
+        gWemoLightByEndpointIndex[static_cast<size_t>(endpointIndex)] = PositionOf(entry);
+    }
+}
+
+// Light published on dynamic endpoint slot `endpointIndex`, or nullptr for
+// the demo devices.
+BridgedWemoLight * FindBridgedWemoLightAtIndex(uint16_t endpointIndex)
+{
+    if (endpointIndex >= gWemoLightByEndpointIndex.size())
+    {
+        return nullptr;
+    }
+    BridgedWemoLight * entry = WemoLightAt(gWemoLightByEndpointIndex[endpointIndex]);
+    return (entry != nullptr && entry->device != nullptr && entry->device.get() == gDevices[endpointIndex]) ? entry : nullptr;
+}
+
+BridgedWemoLight * FindBridgedWemoLightByWemoId(int wemoId)
+{
+    BridgedWemoLight * entry = nullptr;
+    if (wemoId >= 0 && wemoId < kDirectWemoIdLimit)
+    {
+        if (static_cast<size_t>(wemoId) < gWemoLightByWemoId.size())
+        {
+            entry = WemoLightAt(gWemoLightByWemoId[static_cast<size_t>(wemoId)]);
+        }
+    }
+    else
+    {
+        const auto it = gWemoLightBySparseWemoId.find(wemoId);
+        if (it != gWemoLightBySparseWemoId.end())
+        {
+            entry = WemoLightAt(it->second);
+        }
+    }
+    return (entry != nullptr && entry->device != nullptr && entry->wemo_id == wemoId) ? entry : nullptr;
+}
+
+BridgedWemoLight * FindBridgedWemoLight(wemo_bridge::DeviceHandle handle)
+{
+    if (!handle.IsValid() || handle.value >= gWemoLightByHandle.size())
+    {
+        return nullptr;
+    }
+    BridgedWemoLight * entry = WemoLightAt(gWemoLightByHandle[handle.value]);
+    return (entry != nullptr && entry->handle == handle) ? entry : nullptr;
+}
+
+// A finished WeMo command, handed from the adapter worker to the Matter thread.
+struct WemoCommandResultContext
+{
+    wemo_bridge::DeviceHandle handle;
+    wemo_bridge::CommandAttribute attribute;
+    uint32_t seq;
+    wemo_bridge::CommandResult result;
 };
 
-constexpr auto kCommandSettleWindow = std::chrono::milliseconds(2000);
+const char * CommandAttributeName(wemo_bridge::CommandAttribute attribute)
+{
+    return (attribute == wemo_bridge::CommandAttribute::kOnOff) ? "OnOff" : "level";
+}
+
+void HandleWemoCommandResultOnMatterThread(intptr_t closure)
+{
+    auto * ctx = reinterpret_cast<WemoCommandResultContext *>(closure);
+    if (BridgedWemoLight * light = FindBridgedWemoLight(ctx->handle))
+    {
+        BridgedWemoLight & entry = *light;
+        const bool succeeded     = ctx->result.Succeeded();
+        gWemoLightState.CommandCompleted(PositionOf(entry), ctx->attribute, ctx->seq, succeeded, ctx->result.round_trip,
+                                         std::chrono::steady_clock::now());
+
+        // A failed command's pending state is gone, so the next report wins
+        // over the optimistic local state.  Only a run of failures reports
+        // the light unreachable; a success (or the next event or discovery
+        // pass) restores it.  An unavailable engine affects every device and
+        // is left to the engine probe.
+        if (succeeded)
+        {
+            const bool markedUnreachable = entry.failed_commands >= kFailedCommandsBeforeUnreachable;
+            entry.failed_commands        = 0;
+            if (markedUnreachable && !entry.device->IsReachable())
+            {
+                entry.device->SetReachable(true);
+                SyncWemoLightState(entry);
+            }
+        }
+        else
+        {
+            ChipLogError(DeviceLayer, "WeMo %s failed for %s: %s (rc=%d)", CommandAttributeName(ctx->attribute),
+                         entry.device->GetName(), wemo_bridge::CommandStatusName(ctx->result.status), ctx->result.engine_rc);
+            if (ctx->result.status != wemo_bridge::CommandStatus::kEngineUnavailable)
+            {
+                if (entry.failed_commands < kFailedCommandsBeforeUnreachable)
+                {
+                    entry.failed_commands++;
+                }
+                if (entry.failed_commands == kFailedCommandsBeforeUnreachable && entry.device->IsReachable())
+                {
+                    entry.device->SetReachable(false);
+                    SyncWemoLightState(entry);
+                }
+            }
+        }
+    }
+    Platform::Delete(ctx);
+}
+
+// Completion callback for command `seq` on `handle`; runs on an adapter
+// worker.  Every result but a superseded one goes to the Matter thread: an
+// acknowledgement closes most of the command's settle window and feeds the
+// light's round-trip estimate.
+wemo_bridge::CommandCallback MakeWemoCommandCallback(wemo_bridge::DeviceHandle handle, wemo_bridge::CommandAttribute attribute,
+                                                     uint32_t seq)
+{
+    return [handle, attribute, seq](const wemo_bridge::CommandResult & result) {
+        if (result.status == wemo_bridge::CommandStatus::kSuperseded)
+        {
+            return;
+        }
+        if (result.Succeeded())
+        {
+            ChipLogDetail(DeviceLayer, "WeMo %s handle=%u seq=%" PRIu32 " rtt=%lldus", CommandAttributeName(attribute),
+                          static_cast<unsigned>(handle.value), seq, static_cast<long long>(result.round_trip.count()));
+        }
 
-std::vector<BridgedWemoLight> gBridgedWemoLights;
-std::unordered_map<Device *, std::string> gWemoDeviceToUdn;
+        auto * ctx = Platform::New<WemoCommandResultContext>();
+        if (ctx == nullptr)
+        {
+            return;
+        }
+        ctx->handle    = handle;
+        ctx->attribute = attribute;
+        ctx->seq       = seq;
+        ctx->result    = result;
+        TEMPORARY_RETURN_IGNORED PlatformMgr().ScheduleWork(HandleWemoCommandResultOnMatterThread, reinterpret_cast<intptr_t>(ctx));
+    };
+}
 
 // Setup composed device with two temperature sensors and a power source
 ComposedDevice gComposedDevice("Composed Device", "Bedroom");
@@ -363,82 +653,74 @@ RegisteredServerCluster<Clusters::IdentifyCluster>
 
 // ---------------------------------------------------------------------------
 
-int AddDeviceEndpoint(Device * dev, EmberAfEndpointType * ep, const Span<const EmberAfDeviceType> & deviceTypeList,
-                      const Span<DataVersion> & dataVersionStorage,
+// The caller must hold the CHIP stack lock (DeviceLayer::StackLock), or be
+// running on the Matter thread, which already holds it.
+int AddDeviceEndpoint(Device * dev, chip::EndpointId endpointId, EmberAfEndpointType * ep,
+                      const Span<const EmberAfDeviceType> & deviceTypeList, const Span<DataVersion> & dataVersionStorage,
 #if CHIP_CONFIG_USE_ENDPOINT_UNIQUE_ID
                       chip::CharSpan epUniqueId,
 #endif
                       chip::EndpointId parentEndpointId = chip::kInvalidEndpointId)
 {
-    uint8_t index = 0;
-    while (index < CHIP_DEVICE_CONFIG_DYNAMIC_ENDPOINT_COUNT)
+    const uint16_t index = gEndpointSlots.Acquire(dev);
+    if (index == wemo_bridge::EndpointSlots::kNoSlot)
     {
-        if (nullptr == gDevices[index])
+        if (gEndpointSlots.SlotOf(dev) != wemo_bridge::EndpointSlots::kNoSlot)
         {
-            gDevices[index] = dev;
-            CHIP_ERROR err;
-            while (true)
-            {
-                // Todo: Update this to schedule the work rather than use this lock
-                DeviceLayer::StackLock lock;
-                dev->SetEndpointId(gCurrentEndpointId);
-                dev->SetParentEndpointId(parentEndpointId);
+            ChipLogError(DeviceLayer, "Device %s is already on dynamic endpoint %d", dev->GetName(), dev->GetEndpointId());
+            return -1;
+        }
+        ChipLogProgress(DeviceLayer, "Failed to add dynamic endpoint: No endpoints available!");
+        return -1;
+    }
+
+    gDevices[index] = dev;
+    dev->SetEndpointId(endpointId);
+    dev->SetParentEndpointId(parentEndpointId);
 #if !CHIP_CONFIG_USE_ENDPOINT_UNIQUE_ID
-                err =
-                    emberAfSetDynamicEndpoint(index, gCurrentEndpointId, ep, dataVersionStorage, deviceTypeList, parentEndpointId);
+    CHIP_ERROR err = emberAfSetDynamicEndpoint(index, endpointId, ep, dataVersionStorage, deviceTypeList, parentEndpointId);
 #else
-                err = emberAfSetDynamicEndpointWithEpUniqueId(index, gCurrentEndpointId, ep, dataVersionStorage, deviceTypeList,
-                                                              epUniqueId, parentEndpointId);
+    CHIP_ERROR err = emberAfSetDynamicEndpointWithEpUniqueId(index, endpointId, ep, dataVersionStorage, deviceTypeList, epUniqueId,
+                                                             parentEndpointId);
 #endif
-                if (err == CHIP_NO_ERROR)
-                {
-                    ChipLogProgress(DeviceLayer, "Added device %s to dynamic endpoint %d (index=%d)", dev->GetName(),
-                                    gCurrentEndpointId, index);
+    if (err != CHIP_NO_ERROR)
+    {
+        // Endpoint ids are assigned up front (see EndpointRegistry), so
+        // a collision is reported rather than probed around: moving the
+        // device would change its id for every controller.
+        ChipLogError(DeviceLayer, "Failed to add device %s to dynamic endpoint %d: %" CHIP_ERROR_FORMAT, dev->GetName(),
+                     endpointId, err.Format());
+        gDevices[index] = nullptr;
+        gEndpointSlots.Release(dev);
+        return -1;
+    }
 
-                    if (dev->GetUniqueId()[0] == '\0')
-                    {
-                        dev->GenerateUniqueId();
-                    }
+    ChipLogProgress(DeviceLayer, "Added device %s to dynamic endpoint %d (index=%d)", dev->GetName(), endpointId, index);
 
-                    return index;
-                }
-                if (err != CHIP_ERROR_ENDPOINT_EXISTS)
-                {
-                    gDevices[index] = nullptr;
-                    return -1;
-                }
-                // Handle wrap condition
-                if (++gCurrentEndpointId < gFirstDynamicEndpointId)
-                {
-                    gCurrentEndpointId = gFirstDynamicEndpointId;
-                }
-            }
-        }
-        index++;
+    if (dev->GetUniqueId()[0] == '\0')
+    {
+        dev->GenerateUniqueId();
     }
-    ChipLogProgress(DeviceLayer, "Failed to add dynamic endpoint: No endpoints available!");
-    return -1;
+
+    return index;
 }
 
+// Same locking rule as AddDeviceEndpoint.
 int RemoveDeviceEndpoint(Device * dev)
 {
-    uint8_t index = 0;
-    while (index < CHIP_DEVICE_CONFIG_DYNAMIC_ENDPOINT_COUNT)
+    const uint16_t index = gEndpointSlots.Release(dev);
+    if (index == wemo_bridge::EndpointSlots::kNoSlot)
     {
-        if (gDevices[index] == dev)
-        {
-            // Todo: Update this to schedule the work rather than use this lock
-            DeviceLayer::StackLock lock;
-            // Silence complaints about unused ep when progress logging
-            // disabled.
-            [[maybe_unused]] EndpointId ep = emberAfClearDynamicEndpoint(index);
-            gDevices[index]                = nullptr;
-            ChipLogProgress(DeviceLayer, "Removed device %s from dynamic endpoint %d (index=%d)", dev->GetName(), ep, index);
-            return index;
-        }
-        index++;
+        return -1;
     }
-    return -1;
+
+    // Silence complaints about unused ep when progress logging
+    // disabled.
+    [[maybe_unused]] EndpointId ep = emberAfClearDynamicEndpoint(index);
+    gDevices[index]                = nullptr;
+    gDirtyAttributes.Forget(index);
+    ChipLogProgress(DeviceLayer, "Removed device %s from dynamic endpoint %d (index=%d)", dev->GetName(), ep, index);
+    return index;
 }
 
 std::vector<EndpointListInfo> GetEndpointListInfo(chip::EndpointId parentId)
@@ -463,31 +745,79 @@ std::vector<Room *> GetRoomListInfo(chip::EndpointId parentId)
 }
 
 namespace {
-void CallReportingCallback(intptr_t closure)
+struct ReportedAttribute
 {
-    auto path = reinterpret_cast<app::ConcreteAttributePath *>(closure);
-    MatterReportingAttributeChangeCallback(*path);
-    Platform::Delete(path);
+    ClusterId cluster;
+    AttributeId attribute;
+};
+
+// Attributes reported through gDirtyAttributes; bit i of a slot's dirty
+// bits stands for kReportedAttributes[i].
+constexpr ReportedAttribute kReportedAttributes[] = {
+    { BridgedDeviceBasicInformation::Id, BridgedDeviceBasicInformation::Attributes::Reachable::Id },
+    { BridgedDeviceBasicInformation::Id, BridgedDeviceBasicInformation::Attributes::NodeLabel::Id },
+    { OnOff::Id, OnOff::Attributes::OnOff::Id },
+    { LevelControl::Id, LevelControl::Attributes::CurrentLevel::Id },
+    { TemperatureMeasurement::Id, TemperatureMeasurement::Attributes::MeasuredValue::Id },
+};
+static_assert(MATTER_ARRAY_SIZE(kReportedAttributes) <= 8, "dirty bits are a uint8_t per slot");
+
+constexpr uint8_t kDirtyReachable     = 1u << 0;
+constexpr uint8_t kDirtyNodeLabel     = 1u << 1;
+constexpr uint8_t kDirtyOnOff         = 1u << 2;
+constexpr uint8_t kDirtyCurrentLevel  = 1u << 3;
+constexpr uint8_t kDirtyMeasuredValue = 1u << 4;
+
+void ReportDirtyAttributes(size_t slot, uint8_t bits)
+{
+    // RemoveDeviceEndpoint() forgets a slot's bits, so this only guards
+    // against a slot that is empty anyway.
+    Device * dev = gDevices[slot];
+    if (dev == nullptr)
+    {
+        return;
+    }
+    for (size_t i = 0; i < MATTER_ARRAY_SIZE(kReportedAttributes); i++)
+    {
+        if (bits & (1u << i))
+        {
+            MatterReportingAttributeChangeCallback(dev->GetEndpointId(), kReportedAttributes[i].cluster,
+                                                   kReportedAttributes[i].attribute);
+        }
+    }
 }
 
-void ScheduleReportingCallback(Device * dev, ClusterId cluster, AttributeId attribute)
+// Marks attributes of `dev` for the next report flush.  Devices that are not
+// on an endpoint have nothing to report.  Same locking rule as
+// AddDeviceEndpoint, for the slot lookup.
+void MarkAttributesDirty(Device * dev, uint8_t bits)
 {
-    auto * path = Platform::New<app::ConcreteAttributePath>(dev->GetEndpointId(), cluster, attribute);
-    TEMPORARY_RETURN_IGNORED PlatformMgr().ScheduleWork(CallReportingCallback, reinterpret_cast<intptr_t>(path));
+    const uint16_t slot = gEndpointSlots.SlotOf(dev);
+    if (slot != wemo_bridge::EndpointSlots::kNoSlot)
+    {
+        gDirtyAttributes.Mark(slot, bits);
+    }
+}
+
+void FlushDirtyAttributes(intptr_t)
+{
+    gDirtyAttributes.Flush(ReportDirtyAttributes);
 }
 } // anonymous namespace
 
 void HandleDeviceStatusChanged(Device * dev, Device::Changed_t itemChangedMask)
 {
+    uint8_t dirty = 0;
     if (itemChangedMask & Device::kChanged_Reachable)
     {
-        ScheduleReportingCallback(dev, BridgedDeviceBasicInformation::Id, BridgedDeviceBasicInformation::Attributes::Reachable::Id);
+        dirty |= kDirtyReachable;
     }
 
     if (itemChangedMask & Device::kChanged_Name)
     {
-        ScheduleReportingCallback(dev, BridgedDeviceBasicInformation::Id, BridgedDeviceBasicInformation::Attributes::NodeLabel::Id);
+        dirty |= kDirtyNodeLabel;
     }
+    MarkAttributesDirty(dev, dirty);
 }
 
 void HandleDeviceOnOffStatusChanged(DeviceOnOff * dev, DeviceOnOff::Changed_t itemChangedMask)
@@ -499,7 +829,7 @@ void HandleDeviceOnOffStatusChanged(DeviceOnOff * dev, DeviceOnOff::Changed_t it
 
     if (itemChangedMask & DeviceOnOff::kChanged_OnOff)
     {
-        ScheduleReportingCallback(dev, OnOff::Id, OnOff::Attributes::OnOff::Id);
+        MarkAttributesDirty(dev, kDirtyOnOff);
     }
 }
 
@@ -510,15 +840,17 @@ void HandleDeviceDimmableStatusChanged(DeviceDimmable * dev, DeviceDimmable::Cha
         HandleDeviceStatusChanged(static_cast<Device *>(dev), (Device::Changed_t) itemChangedMask);
     }
 
+    uint8_t dirty = 0;
     if (itemChangedMask & DeviceOnOff::kChanged_OnOff)
     {
-        ScheduleReportingCallback(dev, OnOff::Id, OnOff::Attributes::OnOff::Id);
+        dirty |= kDirtyOnOff;
     }
 
     if (itemChangedMask & DeviceDimmable::kChanged_Level)
     {
-        ScheduleReportingCallback(dev, LevelControl::Id, LevelControl::Attributes::CurrentLevel::Id);
+        dirty |= kDirtyCurrentLevel;
     }
+    MarkAttributesDirty(dev, dirty);
 }
 
 void HandleDevicePowerSourceStatusChanged(DevicePowerSource * dev, DevicePowerSource::Changed_t itemChangedMask)
@@ -554,7 +886,7 @@ void HandleDeviceTempSensorStatusChanged(DeviceTempSensor * dev, DeviceTempSenso
     }
     if (itemChangedMask & DeviceTempSensor::kChanged_MeasurementValue)
     {
-        ScheduleReportingCallback(dev, TemperatureMeasurement::Id, TemperatureMeasurement::Attributes::MeasuredValue::Id);
+        MarkAttributesDirty(dev, kDirtyMeasuredValue);
     }
 }
 
@@ -624,7 +956,9 @@ Protocols::InteractionModel::Status HandleReadOnOffAttribute(DeviceOnOff * dev,
     return Protocols::InteractionModel::Status::Success;
 }
 
-Protocols::InteractionModel::Status HandleWriteOnOffAttribute(DeviceOnOff * dev, chip::AttributeId attributeId, uint8_t * buffer)
+// `entry` is the bridged WeMo light behind `dev`, or nullptr for demo devices.
+Protocols::InteractionModel::Status HandleWriteOnOffAttribute(DeviceOnOff * dev, BridgedWemoLight * entry, chip::AttributeId attributeId,
+                                                              uint8_t * buffer)
 {
     ChipLogProgress(DeviceLayer, "HandleWriteOnOffAttribute: attrId=%d", attributeId);
 
@@ -632,26 +966,33 @@ Protocols::InteractionModel::Status HandleWriteOnOffAttribute(DeviceOnOff * dev,
     {
         const bool targetOn = (*buffer != 0);
 
-        // Update internal state and respond to the controller immediately.
-        // The WeMo IPC is fired asynchronously so it does not block the
-        // Matter event loop (SQLite lookup + TCP roundtrip to wemo_ctrl).
-        dev->SetOnOff(targetOn);
-
-        auto udnIt = gWemoDeviceToUdn.find(static_cast<Device *>(dev));
-        if (udnIt != gWemoDeviceToUdn.end())
+        // Queue the WeMo IPC before touching local state so a full command
+        // queue can be reported to the controller as Busy.  The adapter runs
+        // the command on its own workers so it does not block the Matter
+        // event loop (TCP roundtrip to wemo_ctrl).
+        if (entry != nullptr && entry->handle.IsValid())
         {
-            const std::string udn = udnIt->second;
-            // Record commanded state so echo events are suppressed until confirmed.
-            for (auto & entry : gBridgedWemoLights)
+            // Record the desired state first so echo events are suppressed
+            // until the device confirms it.
+            const auto now          = std::chrono::steady_clock::now();
+            const uint32_t position = PositionOf(*entry);
+            const uint32_t seq =
+                gWemoLightState.BeginCommand(position, wemo_bridge::CommandAttribute::kOnOff, static_cast<int16_t>(targetOn ? 1 : 0), now);
+            if (!gWemoAdapter.SetOnOffAsync(entry->handle, targetOn,
+                                            MakeWemoCommandCallback(entry->handle, wemo_bridge::CommandAttribute::kOnOff, seq)))
             {
-                if (entry.device.get() == static_cast<Device *>(dev))
-                {
-                    entry.commandedOnOff = targetOn ? 1 : 0;
-                    entry.commandedOnOffUntil = std::chrono::steady_clock::now() + kCommandSettleWindow;
-                    break;
-                }
+                gWemoLightState.CommandCompleted(position, wemo_bridge::CommandAttribute::kOnOff, seq, false,
+                                                 std::chrono::microseconds::zero(), now);
+                ChipLogError(DeviceLayer, "WeMo command queue full; rejecting OnOff write for %s", dev->GetName());
+                return Protocols::InteractionModel::Status::Busy;
             }
-            std::thread([udn, targetOn]() { gWemoAdapter.SetOnOff(udn, targetOn); }).detach();
+        }
+
+        // Update internal state and respond to the controller immediately.
+        dev->SetOnOff(targetOn);
+        if (entry != nullptr)
+        {
+            SyncWemoLightState(*entry);
         }
     }
     else
@@ -699,8 +1040,8 @@ Protocols::InteractionModel::Status HandleReadLevelControlAttribute(DeviceDimmab
     return Protocols::InteractionModel::Status::Success;
 }
 
-Protocols::InteractionModel::Status HandleWriteLevelControlAttribute(DeviceDimmable * dev, chip::AttributeId attributeId,
-                                                                      uint8_t * buffer)
+Protocols::InteractionModel::Status HandleWriteLevelControlAttribute(DeviceDimmable * dev, BridgedWemoLight * matched,
+                                                                      chip::AttributeId attributeId, uint8_t * buffer)
 {
     ChipLogProgress(DeviceLayer, "HandleWriteLevelControlAttribute: attrId=0x%04x", attributeId);
 
@@ -708,26 +1049,14 @@ Protocols::InteractionModel::Status HandleWriteLevelControlAttribute(DeviceDimma
     {
         const auto now = std::chrono::steady_clock::now();
         const uint8_t matterLevel = *buffer;
-        BridgedWemoLight * matched = nullptr;
-
-        for (auto & entry : gBridgedWemoLights)
-        {
-            if (entry.device.get() == static_cast<Device *>(dev))
-            {
-                matched = &entry;
-                break;
-            }
-        }
+        const uint32_t position   = (matched != nullptr) ? PositionOf(*matched) : 0;
+        auto & hot                = gWemoLightState;
 
         // Some controllers emit LevelControl writes as part of an OnOff toggle.
         // Preserve the current brightness in that window; level should only
         // change when user explicitly changes brightness.
-        if (matched != nullptr && matched->commandedOnOff >= 0 && now > matched->commandedOnOffUntil)
-        {
-            matched->commandedOnOff = -1;
-        }
-
-        if (matched != nullptr && matched->commandedOnOff >= 0 && now <= matched->commandedOnOffUntil)
+        const bool recentOnOff = (matched != nullptr) && hot.RecentOnOffCommand(position, now);
+        if (recentOnOff)
         {
             ChipLogProgress(DeviceLayer, "Ignoring transient level write during OnOff settle for %s", dev->GetName());
             return Protocols::InteractionModel::Status::Success;
@@ -736,37 +1065,33 @@ Protocols::InteractionModel::Status HandleWriteLevelControlAttribute(DeviceDimma
         // Google Home "Off" can generate an internal MoveToLevel(1) before
         // OnOff=0. Ignore that synthetic min-level write so brightness is
         // preserved across Off/On toggles.
-        if (matched != nullptr && matched->commandedOnOff < 0 && matterLevel <= 1)
+        if (matched != nullptr && matterLevel <= 1)
         {
             ChipLogProgress(DeviceLayer, "Ignoring synthetic min-level write for %s", dev->GetName());
             return Protocols::InteractionModel::Status::Success;
         }
 
-        dev->SetLevel(matterLevel);
-
         // Convert Matter 0-254 -> WeMo 0-100 and dispatch asynchronously.
-        uint8_t wemoPercent = static_cast<uint8_t>(static_cast<uint16_t>(matterLevel) * 100u / 254u);
-        // Preserve "on" semantics for tiny non-zero Matter levels (e.g. 1),
-        // which would otherwise truncate to 0% and turn the device off.
-        if (matterLevel > 0 && wemoPercent == 0)
-        {
-            wemoPercent = 1;
-        }
-        auto udnIt = gWemoDeviceToUdn.find(static_cast<Device *>(dev));
-        if (udnIt != gWemoDeviceToUdn.end())
+        // The desired level is kept in percent, the unit the device reports
+        // back in, so its confirmation matches exactly.
+        const uint8_t wemoPercent = wemo_bridge::MatterLevelToWemoPercent(matterLevel);
+        if (matched != nullptr && matched->handle.IsValid())
         {
-            const std::string udn = udnIt->second;
-            // Record commanded level so echo events are suppressed until confirmed.
-            for (auto & entry : gBridgedWemoLights)
+            const uint32_t seq = hot.BeginCommand(position, wemo_bridge::CommandAttribute::kLevel, wemoPercent, now);
+            if (!gWemoAdapter.SetLevelPercentAsync(matched->handle, wemoPercent,
+                                                   MakeWemoCommandCallback(matched->handle, wemo_bridge::CommandAttribute::kLevel, seq)))
             {
-                if (entry.device.get() == static_cast<Device *>(dev))
-                {
-                    entry.commandedLevel = matterLevel;
-                    entry.commandedLevelUntil = std::chrono::steady_clock::now() + kCommandSettleWindow;
-                    break;
-                }
+                hot.CommandCompleted(position, wemo_bridge::CommandAttribute::kLevel, seq, false, std::chrono::microseconds::zero(),
+                                     now);
+                ChipLogError(DeviceLayer, "WeMo command queue full; rejecting level write for %s", dev->GetName());
+                return Protocols::InteractionModel::Status::Busy;
             }
-            std::thread([udn, wemoPercent]() { gWemoAdapter.SetLevelPercent(udn, wemoPercent); }).detach();
+        }
+
+        dev->SetLevel(matterLevel);
+        if (matched != nullptr)
+        {
+            SyncWemoLightState(*matched);
         }
     }
     else
@@ -952,11 +1277,13 @@ Protocols::InteractionModel::Status emberAfExternalAttributeWriteCallback(Endpoi
 
         if ((dev->IsReachable()) && (clusterId == OnOff::Id))
         {
-            ret = HandleWriteOnOffAttribute(static_cast<DeviceOnOff *>(dev), attributeMetadata->attributeId, buffer);
+            ret = HandleWriteOnOffAttribute(static_cast<DeviceOnOff *>(dev), FindBridgedWemoLightAtIndex(endpointIndex),
+                                            attributeMetadata->attributeId, buffer);
         }
         else if ((dev->IsReachable()) && (clusterId == LevelControl::Id))
         {
-            ret = HandleWriteLevelControlAttribute(static_cast<DeviceDimmable *>(dev), attributeMetadata->attributeId, buffer);
+            ret = HandleWriteLevelControlAttribute(static_cast<DeviceDimmable *>(dev), FindBridgedWemoLightAtIndex(endpointIndex),
+                                                   attributeMetadata->attributeId, buffer);
         }
         else if ((dev->IsReachable()) && (clusterId == BridgedDeviceBasicInformation::Id))
         {
@@ -1042,30 +1369,35 @@ void * bridge_polling_thread(void * context)
             if (ch == '2' && light2_added == false)
             {
                 // TC-BR-2 step 2, Add Light2
+                DeviceLayer::StackLock lock;
 #if !CHIP_CONFIG_USE_ENDPOINT_UNIQUE_ID
-                AddDeviceEndpoint(&Light2, &bridgedLightEndpoint, Span<const EmberAfDeviceType>(gBridgedOnOffDeviceTypes),
-                                  Span<DataVersion>(gLight2DataVersions), 1);
+                AddDeviceEndpoint(&Light2, NextTransientEndpointId(), &bridgedLightEndpoint,
+                                  Span<const EmberAfDeviceType>(gBridgedOnOffDeviceTypes), Span<DataVersion>(gLight2DataVersions), 1);
 #else
-                AddDeviceEndpoint(&Light2, &bridgedLightEndpoint, Span<const EmberAfDeviceType>(gBridgedOnOffDeviceTypes),
-                                  Span<DataVersion>(gLight2DataVersions), ""_span, 1);
+                AddDeviceEndpoint(&Light2, NextTransientEndpointId(), &bridgedLightEndpoint,
+                                  Span<const EmberAfDeviceType>(gBridgedOnOffDeviceTypes), Span<DataVersion>(gLight2DataVersions),
+                                  ""_span, 1);
 #endif
                 light2_added = true;
             }
             else if (ch == '4' && light1_added == true)
             {
                 // TC-BR-2 step 4, Remove Light 1
+                DeviceLayer::StackLock lock;
                 RemoveDeviceEndpoint(&Light1);
                 light1_added = false;
             }
             if (ch == '5' && light1_added == false)
             {
                 // TC-BR-2 step 5, Add Light 1 back
+                DeviceLayer::StackLock lock;
 #if !CHIP_CONFIG_USE_ENDPOINT_UNIQUE_ID
-                AddDeviceEndpoint(&Light2, &bridgedLightEndpoint, Span<const EmberAfDeviceType>(gBridgedOnOffDeviceTypes),
-                                  Span<DataVersion>(gLight2DataVersions), 1);
+                AddDeviceEndpoint(&Light2, NextTransientEndpointId(), &bridgedLightEndpoint,
+                                  Span<const EmberAfDeviceType>(gBridgedOnOffDeviceTypes), Span<DataVersion>(gLight2DataVersions), 1);
 #else
-                AddDeviceEndpoint(&Light1, &bridgedLightEndpoint, Span<const EmberAfDeviceType>(gBridgedOnOffDeviceTypes),
-                                  Span<DataVersion>(gLight1DataVersions), ""_span, 1);
+                AddDeviceEndpoint(&Light1, NextTransientEndpointId(), &bridgedLightEndpoint,
+                                  Span<const EmberAfDeviceType>(gBridgedOnOffDeviceTypes), Span<DataVersion>(gLight1DataVersions),
+                                  ""_span, 1);
 #endif
                 light1_added = true;
             }
@@ -1171,96 +1503,700 @@ void * bridge_polling_thread(void * context)
 
 namespace {
 
-struct WemoEventContext
+// At most one bridged WeMo light per dynamic endpoint.
+constexpr size_t kMaxBridgedWemoLights = CHIP_DEVICE_CONFIG_DYNAMIC_ENDPOINT_COUNT;
+
+// Length of one engine probe round.  Rounds repeat until wemo_ctrl answers;
+// each failed round is logged and reported to systemd.
+constexpr auto kEngineProbeRound = std::chrono::seconds(30);
+
+// Start of ApplicationInit, for the time-to-ready log.
+std::chrono::steady_clock::time_point gStartupBegin;
+
+// Microseconds since `start`, for phase timing logs.
+long long MicrosecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return static_cast<long long>(
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+// Minimal sd_notify(3): sends `state` to the socket systemd passes in
+// NOTIFY_SOCKET (Type=notify units).  A no-op when not run under systemd.
+void NotifySystemd(const char * state)
+{
+    const char * socketPath = std::getenv("NOTIFY_SOCKET");
+    if (socketPath == nullptr || (socketPath[0] != '/' && socketPath[0] != '@'))
+    {
+        return;
+    }
+
+    sockaddr_un addr {};
+    const size_t pathLen = strlen(socketPath);
+    if (pathLen >= sizeof(addr.sun_path))
+    {
+        return;
+    }
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, socketPath, pathLen);
+    if (addr.sun_path[0] == '@')
+    {
+        addr.sun_path[0] = '\0'; // abstract namespace
+    }
+
+    const int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        return;
+    }
+    const auto addrLen = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + pathLen);
+    if (sendto(fd, state, strlen(state), MSG_NOSIGNAL, reinterpret_cast<const sockaddr *>(&addr), addrLen) < 0)
+    {
+        ChipLogError(DeviceLayer, "sd_notify failed: %s", strerror(errno));
+    }
+    close(fd);
+}
+
+void DrainWemoEventsOnMatterThread(intptr_t);
+
+// Engine events waiting for the Matter thread, newest state per device.
+// Twice the light count leaves the slot hash table room for probing.
+wemo_bridge::WemoEventRing gWemoEvents(2 * kMaxBridgedWemoLights, [] {
+    TEMPORARY_RETURN_IGNORED PlatformMgr().ScheduleWork(DrainWemoEventsOnMatterThread, 0);
+});
+
+// Discovery repeats this often so devices that appear or disappear after
+// startup are picked up without a restart; zero discovers only once.
+std::chrono::seconds gDiscoveryInterval { 300 };
+
+// A light discovery has not reported for this long loses its endpoint;
+// zero keeps it published (unreachable) forever.
+std::chrono::seconds gWemoLightRemoveAfter { 3600 };
+
+// Wakes the discovery thread early at shutdown, which joins it.
+std::mutex gDiscoveryMutex;
+std::condition_variable gDiscoveryWake;
+bool gDiscoveryStopping = false;
+std::thread gDiscoveryThread;
+
+// The newest device snapshot a reconcile handed to the discovery thread and
+// that is not written yet; a newer one replaces it unwritten.
+std::vector<wemo_bridge::WemoDevice> gPendingSnapshot;
+bool gSnapshotPending = false;
+
+// UDNs that discovery offered while every endpoint was taken, so each one is
+// reported once rather than on every discovery round.
+std::unordered_set<std::string> gWemoLightsOverCapacity;
+
+// Typical heap block of a UDN ("uuid:Lightswitch-1_0-<serial>") once it no
+// longer fits the small-string buffer.
+constexpr size_t kUdnHeapBytes = 48;
+
+// Logs what one bridged light costs and what the configured capacity costs
+// in total, so WEMO_BRIDGE_MAX_DEVICES can be sized against the host's RAM.
+// Descriptor lists have no per-endpoint buffer: the SDK encodes them from
+// the endpoint metadata on every read, and external attribute reads share a
+// single SDK buffer.
+void LogEndpointCapacityPlan()
+{
+    // Preallocated for every endpoint at startup, used or not.
+    const size_t sdkEndpointBytes = sizeof(EmberAfDefinedEndpoint);
+    const size_t slotBytes =
+        sizeof(gDevices[0]) + sizeof(gWemoLightByEndpointIndex[0]) + wemo_bridge::DirtyAttributeSet::kBytesPerSlot;
+    const size_t reservedBytes    = kMaxBridgedWemoLights * (sdkEndpointBytes + slotBytes) + gWemoEvents.MemoryBytes();
+
+    // Allocated as lights are published, in slab blocks of whole cache lines.
+    const size_t entryBytes       = gWemoLightPool.BlockSize() + sizeof(gBridgedWemoLights[0]); // includes dataVersions
+    const size_t dataVersionBytes = sizeof(BridgedWemoLight::dataVersions);
+    const size_t deviceBytes      = gWemoDevicePool.BlockSize();
+    const size_t hotBytes         = wemo_bridge::LightStateTable::kBytesPerLight;
+    const size_t indexBytes  = sizeof(uint32_t) * 2 /* by wemo id, by handle */ +
+        sizeof(decltype(gWemoLightByUdn)::value_type) + 2 * sizeof(void *) /* node link, bucket */ + kUdnHeapBytes;
+    const size_t perLightBytes = entryBytes + sdkEndpointBytes + slotBytes + deviceBytes + hotBytes + indexBytes;
+
+    ChipLogProgress(DeviceLayer,
+                    "Endpoint capacity %zu: %zu B per light (entry %zu incl. DataVersions %zu, Device %zu, hot state %zu, "
+                    "index %zu, SDK endpoint %zu), %zu KiB reserved, %zu KiB at capacity",
+                    kMaxBridgedWemoLights, perLightBytes, entryBytes, dataVersionBytes, deviceBytes, hotBytes, indexBytes,
+                    sdkEndpointBytes, reservedBytes / 1024,
+                    (reservedBytes + kMaxBridgedWemoLights * (entryBytes + deviceBytes + hotBytes + indexBytes)) / 1024);
+}
+
+struct WemoReconcileContext
 {
-    int wemo_id;
-    bool is_online;
-    int state;
-    int level; // 0-100 or -1
+    std::vector<wemo_bridge::WemoDevice> devices;
+    // Parallel to devices, filled by PrepareWemoLights().  prepared[i] is
+    // null when devices[i] is expected to be bridged already.
+    std::vector<std::optional<uint16_t>> endpointIds;
+    std::vector<wemo_bridge::SlabPtr<Device>> prepared;
 };
 
-void HandleWemoEventOnMatterThread(intptr_t closure)
+// Applies a reported WeMo state to a bridged light.  A report that matches
+// a pending command confirms it; one that contradicts a command still
+// settling is a stale echo and is dropped.  Runs on the Matter thread.
+void ApplyWemoState(BridgedWemoLight & entry, bool isOnline, int state, int level)
+{
+    const auto now          = std::chrono::steady_clock::now();
+    auto * dev              = entry.device.get();
+    const uint32_t position = PositionOf(entry);
+    auto & hot              = gWemoLightState;
+
+    // Reachability always updates immediately.
+    if (dev->IsReachable() != isOnline)
+    {
+        dev->SetReachable(isOnline);
+    }
+
+    if (!isOnline)
+    {
+        SyncWemoLightState(entry);
+        return;
+    }
+
+    auto * light            = static_cast<DeviceOnOff *>(dev);
+    const bool newOn        = (state != 0);
+    const auto onOffVerdict = hot.OnReport(position, wemo_bridge::CommandAttribute::kOnOff, static_cast<int16_t>(newOn ? 1 : 0), now);
+    if (onOffVerdict == wemo_bridge::ReportVerdict::kSuppress)
+    {
+        ChipLogProgress(DeviceLayer, "Suppressing echo for %s (got %s, commanded %s)", dev->GetName(), newOn ? "ON" : "OFF",
+                        hot.pending_onoff[position].value ? "ON" : "OFF");
+    }
+    else if (light->IsOn() != newOn)
+    {
+        light->SetOnOff(newOn);
+    }
+
+    if (entry.is_dimmable && level >= 0)
+    {
+        auto * dimmer           = static_cast<DeviceDimmable *>(dev);
+        const uint8_t percent   = static_cast<uint8_t>(std::min(level, static_cast<int>(wemo_bridge::kMaxWemoPercent)));
+        const auto levelVerdict = hot.OnReport(position, wemo_bridge::CommandAttribute::kLevel, percent, now);
+        if (levelVerdict == wemo_bridge::ReportVerdict::kSuppress)
+        {
+            ChipLogProgress(DeviceLayer, "Suppressing level echo for %s (got %u%%, commanded %d%%)", dev->GetName(), percent,
+                            hot.pending_level[position].value);
+        }
+        // Compared in percent so a level the controller set is kept exactly
+        // rather than replaced by its rounded report.
+        else if (wemo_bridge::MatterLevelToWemoPercent(dimmer->GetLevel()) != percent)
+        {
+            dimmer->SetLevel(wemo_bridge::WemoPercentToMatterLevel(percent));
+        }
+    }
+    SyncWemoLightState(entry);
+}
+
+void ApplyWemoEvent(const wemo_bridge::WemoStateEvent & ev)
+{
+    if (BridgedWemoLight * entry = FindBridgedWemoLightByWemoId(ev.wemo_id))
+    {
+        ApplyWemoState(*entry, ev.is_online, ev.state, ev.level);
+    }
+}
+
+void DrainWemoEventsOnMatterThread(intptr_t)
+{
+    gWemoEvents.Drain(ApplyWemoEvent);
+}
+
+// Resolves persisted endpoint ids for `devices` in one registry transaction.
+// Devices without a UDN get std::nullopt.
+std::vector<std::optional<uint16_t>> AssignEndpointIds(const std::vector<wemo_bridge::WemoDevice> & devices)
 {
-    auto * ctx = reinterpret_cast<WemoEventContext *>(closure);
+    std::vector<std::string> registryUdns;
+    std::vector<size_t> registryIndices;
+    for (size_t i = 0; i < devices.size(); i++)
+    {
+        if (!devices[i].udn.empty())
+        {
+            registryUdns.push_back(devices[i].udn);
+            registryIndices.push_back(i);
+        }
+    }
+
+    std::vector<std::optional<uint16_t>> endpointIds(devices.size());
+    const auto assignedIds = gEndpointRegistry->GetOrAssignMany(registryUdns);
+    for (size_t i = 0; i < assignedIds.size(); i++)
+    {
+        endpointIds[registryIndices[i]] = assignedIds[i];
+    }
+    return endpointIds;
+}
+
+// An endpoint id for something published without a persisted mapping.  It
+// is reserved in the registry so no later GetOrAssign hands it to a device;
+// gCurrentEndpointId is only the fallback when the registry is unavailable.
+// Callers hold the stack lock (or run before the event loop starts).
+EndpointId NextTransientEndpointId()
+{
+    const auto reserved = gEndpointRegistry->ReserveTransient();
+    if (!reserved.has_value())
+    {
+        return gCurrentEndpointId++;
+    }
+    if (reserved.value() >= gCurrentEndpointId)
+    {
+        gCurrentEndpointId = static_cast<EndpointId>(reserved.value() + 1);
+    }
+    return reserved.value();
+}
+
+// Picks the endpoint to publish `dev` on.  Runs on the Matter thread (or
+// before the event loop starts), which owns gCurrentEndpointId.
+EndpointId EndpointIdFor(const wemo_bridge::WemoDevice & dev, const std::optional<uint16_t> & assigned)
+{
+    if (assigned.has_value())
+    {
+        // Keep transient ids (and the sample endpoints) above every
+        // registry-assigned one.
+        if (assigned.value() >= gCurrentEndpointId)
+        {
+            gCurrentEndpointId = static_cast<EndpointId>(assigned.value() + 1);
+        }
+        return assigned.value();
+    }
+
+    // No persisted mapping (empty UDN or registry unavailable): publish on a
+    // transient id.
+    const EndpointId endpointId = NextTransientEndpointId();
+    ChipLogError(DeviceLayer, "No persistent endpoint for WeMo device %s (udn=%s); using transient endpoint %d",
+                 dev.friendly_name.c_str(), dev.udn.c_str(), endpointId);
+    return endpointId;
+}
+
+// Builds the Device for `dev` in gWemoDevicePool, seeded with its reported
+// state.  Touches no Matter state, so discovery builds these off the Matter
+// thread.
+wemo_bridge::SlabPtr<Device> MakeWemoLightDevice(const wemo_bridge::WemoDevice & dev)
+{
+    const std::string name = dev.friendly_name.empty() ? std::string("WeMo Device") : dev.friendly_name;
+    if (dev.supports_level)
+    {
+        auto dimmer = wemo_bridge::MakeInSlab<DeviceDimmable>(gWemoDevicePool, name.c_str(), "WeMo");
+        dimmer->SetOnOff(dev.onoff != 0);
+        // Seed level: WeMo 0-100 -> Matter 0-254
+        dimmer->SetLevel(wemo_bridge::WemoPercentToMatterLevel(dev.level_percent));
+        dimmer->SetReachable(dev.is_online);
+        return dimmer;
+    }
+    auto light = wemo_bridge::MakeInSlab<DeviceOnOff>(gWemoDevicePool, name.c_str(), "WeMo");
+    light->SetOnOff(dev.onoff != 0);
+    light->SetReachable(dev.is_online);
+    return light;
+}
+
+// Does everything for ctx.devices that does not need the Matter thread, so
+// publishing them later only registers endpoints.  Endpoint ids come from
+// the registry (one SQLite transaction) on a helper thread while this one
+// resolves command handles in one index update and builds a Device for
+// every device whose UDN is not in `bridged`.
+void PrepareWemoLights(WemoReconcileContext & ctx, const std::unordered_set<std::string> & bridged)
+{
+    const auto start = std::chrono::steady_clock::now();
+    long long registryUs = 0;
+    auto endpointIds = std::async(std::launch::async, [&ctx, &registryUs, start] {
+        auto ids   = AssignEndpointIds(ctx.devices);
+        registryUs = MicrosecondsSince(start);
+        return ids;
+    });
+
+    std::vector<std::string> udns;
+    udns.reserve(ctx.devices.size());
+    for (const auto & dev : ctx.devices)
+    {
+        udns.push_back(dev.udn);
+    }
+    (void) gWemoAdapter.ResolveMany(udns);
+
+    size_t built = 0;
+    ctx.prepared.clear();
+    ctx.prepared.resize(ctx.devices.size());
+    for (size_t i = 0; i < ctx.devices.size(); i++)
+    {
+        if (bridged.count(ctx.devices[i].udn) == 0)
+        {
+            ctx.prepared[i] = MakeWemoLightDevice(ctx.devices[i]);
+            built++;
+        }
+    }
+    const long long buildUs = MicrosecondsSince(start);
+
+    ctx.endpointIds = endpointIds.get();
+    ChipLogProgress(DeviceLayer, "Prepared %zu WeMo devices (%zu Devices built): endpoint ids %lld us, handles and Devices %lld us, "
+                    "wall %lld us", ctx.devices.size(), built, registryUs, buildUs, MicrosecondsSince(start));
+}
+
+// Registers `dev` on `endpointId`, using `prepared` (from
+// MakeWemoLightDevice) when given and building the Device otherwise.
+// `entry` must be one of gBridgedWemoLights: the SDK keeps a pointer to its
+// DataVersion storage for the lifetime of the endpoint.  The caller holds
+// the stack lock.
+bool PublishWemoLight(BridgedWemoLight & entry, const wemo_bridge::WemoDevice & dev, EndpointId endpointId,
+                      wemo_bridge::SlabPtr<Device> prepared = nullptr)
+{
+    entry.wemo_id = dev.wemo_id;
+    entry.udn = dev.udn;
+    entry.handle = gWemoAdapter.Resolve(dev.udn);
+    entry.is_dimmable = dev.supports_level;
+    entry.device = prepared ? std::move(prepared) : MakeWemoLightDevice(dev);
+    gWemoLightState.ClearCommands(PositionOf(entry));
+    entry.dataVersions = {};
+
+    EmberAfEndpointType * epType;
+    const EmberAfDeviceType * deviceTypes;
+    size_t deviceTypesCount;
+
+    if (entry.is_dimmable)
+    {
+        epType = &bridgedDimmableLightEndpoint;
+        deviceTypes = gBridgedDimmableDeviceTypes;
+        deviceTypesCount = MATTER_ARRAY_SIZE(gBridgedDimmableDeviceTypes);
+        ChipLogProgress(DeviceLayer, "WeMo bind (dimmable): %s <- %s", entry.device->GetName(), entry.udn.c_str());
+    }
+    else
+    {
+        epType = &bridgedLightEndpoint;
+        deviceTypes = gBridgedOnOffDeviceTypes;
+        deviceTypesCount = MATTER_ARRAY_SIZE(gBridgedOnOffDeviceTypes);
+        ChipLogProgress(DeviceLayer, "WeMo bind (on/off): %s <- %s", entry.device->GetName(), entry.udn.c_str());
+    }
+
+    // DataVersion span size must match the cluster count for the endpoint type.
+    const size_t clusterCount = entry.is_dimmable
+        ? MATTER_ARRAY_SIZE(bridgedDimmableLightClusters)
+        : MATTER_ARRAY_SIZE(bridgedLightClusters);
+
+#if !CHIP_CONFIG_USE_ENDPOINT_UNIQUE_ID
+    const int addedIndex = AddDeviceEndpoint(entry.device.get(), endpointId, epType,
+                                             Span<const EmberAfDeviceType>(deviceTypes, deviceTypesCount),
+                                             Span<DataVersion>(entry.dataVersions.data(), clusterCount), 1);
+#else
+    // Use the WeMo UDN as the endpoint unique ID.  Strip the "uuid:"
+    // prefix to fit within the 32-byte buffer.  This gives each bridged
+    // device a stable identity that survives restarts.
+    std::string epUniqueId = entry.udn;
+    if (epUniqueId.rfind("uuid:", 0) == 0)
+    {
+        epUniqueId = epUniqueId.substr(5);
+    }
+    if (epUniqueId.size() > 32)
+    {
+        epUniqueId.resize(32);
+    }
+    CharSpan udnSpan(epUniqueId.c_str(), epUniqueId.size());
+    const int addedIndex = AddDeviceEndpoint(entry.device.get(), endpointId, epType,
+                                             Span<const EmberAfDeviceType>(deviceTypes, deviceTypesCount),
+                                             Span<DataVersion>(entry.dataVersions.data(), clusterCount), udnSpan, 1);
+#endif
+    if (addedIndex < 0)
+    {
+        ChipLogError(DeviceLayer, "Failed to publish WeMo device %s (udn=%s)", entry.device->GetName(), entry.udn.c_str());
+        return false;
+    }
+    IndexWemoLight(entry);
+    IndexWemoLightEndpoint(entry, addedIndex);
+    SyncWemoLightState(entry);
+
+    if (entry.is_dimmable)
+    {
+        // Dynamic endpoints don't get cluster init functions called
+        // automatically (DECLARE_DYNAMIC_CLUSTER passes NULL for the
+        // functions array).  Manually init the LevelControl server so
+        // its per-endpoint state (minLevel, maxLevel) is set up.
+        emberAfLevelControlClusterServerInitCallback(entry.device->GetEndpointId());
+
+        static_cast<DeviceDimmable *>(entry.device.get())->SetChangeCallback(&HandleDeviceDimmableStatusChanged);
+    }
+    else
+    {
+        static_cast<DeviceOnOff *>(entry.device.get())->SetChangeCallback(&HandleDeviceOnOffStatusChanged);
+    }
+    return true;
+}
+
+// Drops the Device and index entries of `entry` and parks its position for
+// reuse.  Its endpoint must already be removed (or never have been added).
+void VacateWemoLight(BridgedWemoLight & entry)
+{
+    const uint32_t position = PositionOf(entry);
+    const auto it           = gWemoLightByUdn.find(entry.udn);
+    if (it != gWemoLightByUdn.end() && it->second == position)
+    {
+        gWemoLightByUdn.erase(it);
+    }
+    entry.device.reset();
+    entry.udn.clear();
+    entry.wemo_id       = wemo_bridge::kSnapshotWemoId;
+    entry.handle        = {};
+    entry.missing_since   = {};
+    entry.failed_commands = 0;
+    gWemoLightState.state[position] = 0;
+    gWemoLightState.ClearCommands(position);
+    gVacantWemoLights.push_back(position);
+}
+
+// Publishes a bridged light for `dev` (see PublishWemoLight for
+// `prepared`), reusing a vacant entry when there is one.  Returns the new
+// entry, or nullptr when nothing was published.  The caller holds the stack
+// lock.
+BridgedWemoLight * AddWemoLight(const wemo_bridge::WemoDevice & dev, EndpointId endpointId,
+                                wemo_bridge::SlabPtr<Device> prepared = nullptr)
+{
+    if (BridgedWemoLightCount() >= kMaxBridgedWemoLights)
+    {
+        if (gWemoLightsOverCapacity.insert(dev.udn).second)
+        {
+            ChipLogError(DeviceLayer,
+                         "Not bridging WeMo device %s (udn=%s): all %zu endpoints in use, %zu device(s) left out; "
+                         "rebuild with a larger WEMO_BRIDGE_MAX_DEVICES",
+                         dev.friendly_name.c_str(), dev.udn.c_str(), kMaxBridgedWemoLights, gWemoLightsOverCapacity.size());
+        }
+        return nullptr;
+    }
+
+    // Take the entry BEFORE registering the endpoint.  The CHIP SDK stores
+    // the DataVersion span pointer for the lifetime of the endpoint, so it
+    // must point into a slab block rather than into a stack-local entry.
+    BridgedWemoLight * entry = nullptr;
+    if (!gVacantWemoLights.empty())
+    {
+        entry = gBridgedWemoLights[gVacantWemoLights.back()].get();
+        gVacantWemoLights.pop_back();
+    }
+    else
+    {
+        gBridgedWemoLights.push_back(wemo_bridge::MakeInSlab<BridgedWemoLight>(gWemoLightPool));
+        gWemoLightState.Resize(gBridgedWemoLights.size());
+        entry           = gBridgedWemoLights.back().get();
+        entry->position = static_cast<uint32_t>(gBridgedWemoLights.size() - 1);
+    }
+
+    if (!PublishWemoLight(*entry, dev, endpointId, std::move(prepared)))
+    {
+        VacateWemoLight(*entry);
+        return nullptr;
+    }
+    gWemoLightsOverCapacity.erase(dev.udn);
+    return entry;
+}
+
+// Takes a light that discovery no longer reports off the bridge.  Only its
+// own endpoint goes away; every other endpoint, and the sessions and
+// subscriptions on them, are untouched.  Its endpoint id stays in the
+// registry, so the device gets the same id if it comes back.  The caller
+// holds the stack lock.
+void RemoveWemoLight(BridgedWemoLight & entry)
+{
+    ChipLogProgress(DeviceLayer, "Removing WeMo device %s (udn=%s) from endpoint %d", entry.device->GetName(), entry.udn.c_str(),
+                    entry.device->GetEndpointId());
+    RemoveDeviceEndpoint(entry.device.get());
+    VacateWemoLight(entry);
+}
+
+BridgedWemoLight * FindBridgedWemoLight(const std::string & udn)
+{
+    const auto it = gWemoLightByUdn.find(udn);
+    if (it == gWemoLightByUdn.end())
+    {
+        return nullptr;
+    }
+    BridgedWemoLight * entry = WemoLightAt(it->second);
+    return (entry != nullptr && entry->udn == udn) ? entry : nullptr;
+}
+
+// Current published device set in snapshot form.
+std::vector<wemo_bridge::WemoDevice> SnapshotBridgedWemoLights()
+{
+    std::vector<wemo_bridge::WemoDevice> devices;
+    devices.reserve(BridgedWemoLightCount());
+    for (const auto & slot : gBridgedWemoLights)
+    {
+        const BridgedWemoLight & entry = *slot;
+        if (entry.device == nullptr)
+        {
+            continue;
+        }
+        wemo_bridge::WemoDevice device;
+        device.wemo_id        = entry.wemo_id;
+        device.udn            = entry.udn;
+        device.friendly_name  = entry.device->GetName();
+        device.supports_level = entry.is_dimmable;
+        device.is_online      = entry.device->IsReachable();
+        device.onoff          = static_cast<uint8_t>(static_cast<DeviceOnOff *>(entry.device.get())->IsOn() ? 1 : 0);
+        if (entry.is_dimmable)
+        {
+            const uint8_t matterLevel = static_cast<DeviceDimmable *>(entry.device.get())->GetLevel();
+            device.level_percent      = wemo_bridge::MatterLevelToWemoPercent(matterLevel);
+        }
+        devices.push_back(std::move(device));
+    }
+    return devices;
+}
+
+// Merges a live discovery result into the published endpoints: known UDNs
+// pick up their engine id, name and state; new UDNs are published; lights
+// discovery did not report are marked unreachable and, once they have been
+// missing for gWemoLightRemoveAfter, removed.  Each addition or removal
+// touches only that light's endpoint.
+void ReconcileWemoDevicesOnMatterThread(intptr_t closure)
+{
+    auto * ctx     = reinterpret_cast<WemoReconcileContext *>(closure);
     const auto now = std::chrono::steady_clock::now();
-    for (auto & entry : gBridgedWemoLights)
+
+    // Expected packed state for every position that existed before this
+    // pass.  Lights discovery does not report are expected to go
+    // unreachable; vacant positions stay zero.
+    const size_t known = gBridgedWemoLights.size();
+    std::vector<uint32_t> expected(known);
+    std::vector<const wemo_bridge::WemoDevice *> reportedBy(known, nullptr);
+    for (size_t i = 0; i < known; i++)
+    {
+        expected[i] = gWemoLightState.state[i] & ~wemo_bridge::kLightReachableBit;
+    }
+
+    size_t added = 0;
+    for (size_t i = 0; i < ctx->devices.size(); i++)
     {
-        if (entry.wemo_id == ctx->wemo_id)
+        const auto & dev = ctx->devices[i];
+        // Discovery repeats, so a device without a UDN is matched by its
+        // engine id rather than published again on every pass.
+        BridgedWemoLight * entry = dev.udn.empty() ? FindBridgedWemoLightByWemoId(dev.wemo_id) : FindBridgedWemoLight(dev.udn);
+        if (entry == nullptr)
         {
-            auto * dev = entry.device.get();
+            entry = AddWemoLight(dev, EndpointIdFor(dev, ctx->endpointIds[i]), std::move(ctx->prepared[i]));
+            if (entry == nullptr)
+            {
+                continue;
+            }
+            added++;
+            // A reused vacant position is already published with this state.
+            const uint32_t position = PositionOf(*entry);
+            if (position < known)
+            {
+                expected[position]   = gWemoLightState.state[position];
+                reportedBy[position] = &dev;
+            }
+            continue;
+        }
 
-            // Reachability always updates immediately.
-            if (dev->IsReachable() != ctx->is_online)
+        const uint32_t position = PositionOf(*entry);
+        entry->missing_since    = {};
+        if (entry->is_dimmable != dev.supports_level)
+        {
+            // Device type changed since the snapshot was written: re-publish
+            // on the same endpoint with the matching cluster set.
+            const EndpointId endpointId = entry->device->GetEndpointId();
+            RemoveDeviceEndpoint(entry->device.get());
+            if (!PublishWemoLight(*entry, dev, endpointId))
             {
-                dev->SetReachable(ctx->is_online);
+                VacateWemoLight(*entry);
             }
+            expected[position]   = gWemoLightState.state[position];
+            reportedBy[position] = &dev;
+            continue;
+        }
+
+        // Cold fields are compared here; the hot state is diffed below.
+        if (entry->wemo_id != dev.wemo_id)
+        {
+            entry->wemo_id = dev.wemo_id;
+            IndexWemoLight(*entry);
+        }
+        if (!dev.friendly_name.empty() && dev.friendly_name != entry->device->GetName())
+        {
+            entry->device->SetName(dev.friendly_name.c_str());
+        }
 
-            if (ctx->is_online)
+        // Offline reports only change reachability (see ApplyWemoState).
+        reportedBy[position] = &dev;
+        if (dev.is_online)
+        {
+            // A level that already rounds to the reported percent is kept.
+            uint8_t level = wemo_bridge::LightLevel(gWemoLightState.state[position]);
+            if (entry->is_dimmable && wemo_bridge::MatterLevelToWemoPercent(level) != dev.level_percent)
             {
-                auto * light = static_cast<DeviceOnOff *>(dev);
-                const bool newOn = (ctx->state != 0);
-                const int newOnInt = newOn ? 1 : 0;
-                bool suppressOnOff = false;
-
-                // OnOff: suppress contradictory state events while the command
-                // settle window is active.
-                if (entry.commandedOnOff >= 0)
-                {
-                    if (now > entry.commandedOnOffUntil)
-                    {
-                        entry.commandedOnOff = -1;
-                    }
-                    else if (newOnInt != entry.commandedOnOff)
-                    {
-                        ChipLogProgress(DeviceLayer, "Suppressing echo for %s (got %s, commanded %s)",
-                                        dev->GetName(), newOn ? "ON" : "OFF",
-                                        entry.commandedOnOff ? "ON" : "OFF");
-                        suppressOnOff = true;
-                    }
-                }
+                level = wemo_bridge::WemoPercentToMatterLevel(dev.level_percent);
+            }
+            expected[position] = wemo_bridge::PackLightState(true, dev.onoff != 0, level);
+        }
+    }
 
-                if (!suppressOnOff && light->IsOn() != newOn)
-                {
-                    light->SetOnOff(newOn);
-                }
+    // Only lights whose state differs get Device setter calls (and reports).
+    std::vector<uint32_t> changed;
+    wemo_bridge::DiffLightStates(gWemoLightState.state.data(), expected.data(), known, changed);
+    for (const uint32_t position : changed)
+    {
+        BridgedWemoLight & entry            = *gBridgedWemoLights[position];
+        const wemo_bridge::WemoDevice * dev = reportedBy[position];
+        if (dev != nullptr)
+        {
+            ApplyWemoState(entry, dev->is_online, dev->onoff, dev->supports_level ? dev->level_percent : -1);
+        }
+        else
+        {
+            ChipLogProgress(DeviceLayer, "WeMo device %s not found by discovery; marking unreachable", entry.device->GetName());
+            entry.device->SetReachable(false);
+            SyncWemoLightState(entry);
+        }
+    }
 
-                if (entry.is_dimmable && ctx->level >= 0)
-                {
-                    auto * dimmer = static_cast<DeviceDimmable *>(dev);
-                    uint8_t matterLevel = static_cast<uint8_t>(static_cast<uint16_t>(ctx->level) * 254u / 100u);
-                    bool suppressLevel = false;
-
-                    if (entry.commandedLevel >= 0)
-                    {
-                        if (now > entry.commandedLevelUntil)
-                        {
-                            entry.commandedLevel = -1;
-                        }
-                        else if (matterLevel != static_cast<uint8_t>(entry.commandedLevel))
-                        {
-                            ChipLogProgress(DeviceLayer, "Suppressing level echo for %s (got %u, commanded %d)",
-                                            dev->GetName(), matterLevel, entry.commandedLevel);
-                            suppressLevel = true;
-                        }
-                    }
-
-                    if (!suppressLevel && dimmer->GetLevel() != matterLevel)
-                    {
-                        dimmer->SetLevel(matterLevel);
-                    }
-                }
+    // An empty result is more likely a failed pass (engine restarting) than
+    // every device unplugged at once, so it never removes anything.
+    size_t removed = 0;
+    if (!ctx->devices.empty())
+    {
+        for (size_t position = 0; position < known; position++)
+        {
+            BridgedWemoLight & entry = *gBridgedWemoLights[position];
+            if (entry.device == nullptr || reportedBy[position] != nullptr)
+            {
+                continue;
+            }
+            if (entry.missing_since == std::chrono::steady_clock::time_point {})
+            {
+                entry.missing_since = now;
+            }
+            else if (gWemoLightRemoveAfter.count() > 0 && now - entry.missing_since >= gWemoLightRemoveAfter)
+            {
+                RemoveWemoLight(entry);
+                removed++;
             }
-            break;
         }
     }
+
+    ChipLogProgress(DeviceLayer,
+                    "WeMo discovery reconciled in %lld us: %zu reported, %zu changed, %zu newly published, %zu removed, %zu bridged",
+                    MicrosecondsSince(now), ctx->devices.size(), changed.size(), added, removed, BridgedWemoLightCount());
+
+    char status[64];
+    snprintf(status, sizeof(status), "STATUS=Bridging %zu WeMo devices", BridgedWemoLightCount());
+    NotifySystemd(status);
+    static bool firstPass = true;
+    if (firstPass)
+    {
+        firstPass = false;
+        ChipLogProgress(DeviceLayer, "First WeMo discovery reconciled %lld ms after start", MicrosecondsSince(gStartupBegin) / 1000);
+    }
+
+    // Written by the discovery thread, off the event loop and in order.
+    {
+        std::vector<wemo_bridge::WemoDevice> snapshot = SnapshotBridgedWemoLights();
+        std::lock_guard<std::mutex> lock(gDiscoveryMutex);
+        gPendingSnapshot = std::move(snapshot);
+        gSnapshotPending = true;
+    }
+    gDiscoveryWake.notify_all();
+
     Platform::Delete(ctx);
 }
 
-} // namespace
-
-void ApplicationInit()
+// One discovery pass: lists the devices wemo_ctrl knows, prepares the ones
+// that are new since `previousUdns` (the previous pass, or the warm start's
+// snapshot before the first one) and hands the result to the Matter thread
+// for reconciliation.
+void RunWemoDiscoveryPass(std::unordered_set<std::string> & previousUdns)
 {
-    auto discovered = gWemoAdapter.Discover();
+    const auto start = std::chrono::steady_clock::now();
+    auto discovered  = gWemoAdapter.Discover();
     std::sort(discovered.begin(), discovered.end(), [](const auto & a, const auto & b) {
         if (a.udn != b.udn)
         {
@@ -1268,11 +2204,142 @@ void ApplicationInit()
         }
         return a.friendly_name < b.friendly_name;
     });
+    const long long discoverUs = MicrosecondsSince(start);
+
+    auto * ctx    = Platform::New<WemoReconcileContext>();
+    ctx->devices  = std::move(discovered);
+    PrepareWemoLights(*ctx, previousUdns);
+
+    std::vector<std::string> seenUdns;
+    previousUdns.clear();
+    for (const auto & dev : ctx->devices)
+    {
+        previousUdns.insert(dev.udn);
+        if (!dev.udn.empty())
+        {
+            seenUdns.push_back(dev.udn);
+        }
+    }
+    gEndpointRegistry->MarkSeen(seenUdns);
+    ChipLogProgress(DeviceLayer, "WeMo discovery pass: %zu devices, discover %lld us, total %lld us", ctx->devices.size(),
+                    discoverUs, MicrosecondsSince(start));
+
+    if (PlatformMgr().ScheduleWork(ReconcileWemoDevicesOnMatterThread, reinterpret_cast<intptr_t>(ctx)) != CHIP_NO_ERROR)
+    {
+        // The event loop is gone (shutdown); nothing will run the pass.
+        Platform::Delete(ctx);
+    }
+}
+
+// Sleeps until the next discovery pass is due, writing the snapshots that
+// reconciles hand over meanwhile.  Returns false once the bridge is shutting
+// down; with periodic discovery disabled it only writes snapshots until then.
+// A snapshot still pending at shutdown is dropped: ApplicationShutdown writes
+// a newer one after joining this thread.
+bool WaitForNextWemoDiscoveryPass()
+{
+    const bool periodic = gDiscoveryInterval.count() > 0;
+    const auto due      = std::chrono::steady_clock::now() + gDiscoveryInterval;
+    const auto wake     = [] { return gDiscoveryStopping || gSnapshotPending; };
+
+    std::unique_lock<std::mutex> lock(gDiscoveryMutex);
+    while (true)
+    {
+        if (!periodic)
+        {
+            gDiscoveryWake.wait(lock, wake);
+        }
+        else if (!gDiscoveryWake.wait_until(lock, due, wake))
+        {
+            return true;
+        }
+        if (gDiscoveryStopping)
+        {
+            return false;
+        }
+
+        std::vector<wemo_bridge::WemoDevice> snapshot = std::move(gPendingSnapshot);
+        gPendingSnapshot.clear();
+        gSnapshotPending = false;
+        lock.unlock();
+        wemo_bridge::SaveDeviceSnapshot(WEMO_DEVICE_SNAPSHOT_PATH, snapshot);
+        lock.lock();
+    }
+}
+
+// First work item of the event loop: the Matter stack is serving the
+// endpoints the warm start published, which is the bridge's readiness
+// point.  wemo_ctrl may still be down; that is reported through STATUS=
+// only, so a slow engine never runs into the unit's start timeout and gets
+// the bridge (and its sessions) restarted.
+void NotifyBridgeServing(intptr_t)
+{
+    char status[96];
+    snprintf(status, sizeof(status), "READY=1\nSTATUS=Serving %zu WeMo devices from snapshot", BridgedWemoLightCount());
+    NotifySystemd(status);
+    ChipLogProgress(DeviceLayer, "WeMo bridge serving %lld ms after start", MicrosecondsSince(gStartupBegin) / 1000);
+}
+
+// Runs on its own thread: engine start-up and SSDP discovery can take
+// seconds, and the endpoints restored from the snapshot serve meanwhile.
+// After the first pass, discovery repeats in the background so devices
+// plugged in or unplugged later are bridged or removed without a restart.
+// `previousUdns` holds the devices the warm start publishes, so the first
+// pass only builds Devices for ones the snapshot did not have.
+void DiscoverWemoDevices(std::unordered_set<std::string> previousUdns)
+{
+    // Start as soon as wemo_ctrl answers instead of after a fixed delay.
+    while (!gWemoAdapter.WaitUntilReady(kEngineProbeRound))
+    {
+        {
+            std::lock_guard<std::mutex> lock(gDiscoveryMutex);
+            if (gDiscoveryStopping)
+            {
+                return;
+            }
+        }
+        ChipLogError(DeviceLayer, "wemo_ctrl engine not answering; still waiting");
+        NotifySystemd("STATUS=Waiting for wemo_ctrl engine");
+    }
+    ChipLogProgress(DeviceLayer, "wemo_ctrl engine ready %lld ms after start", MicrosecondsSince(gStartupBegin) / 1000);
+
+    // Receive state events from wemo_ctrl (called from wemo_engine IPC thread).
+    // The ring coalesces them per device and the Matter event loop applies
+    // them in batches.
+    gWemoAdapter.RegisterStateCallback([](const wemo_bridge::WemoStateEvent & ev) {
+        if (!gWemoEvents.Publish(ev))
+        {
+            ChipLogError(DeviceLayer, "WeMo event ring full; dropped event for wemo_id=%d", ev.wemo_id);
+        }
+    });
+
+    RunWemoDiscoveryPass(previousUdns);
+
+    // Events fired during Discover() named engine ids the bridge did not know
+    // yet.  This refresh causes wemo_ctrl to re-probe all devices and deliver
+    // fresh state events, which are queued behind the reconcile above.
+    // Later passes publish new devices with the state discovery reported.
+    gWemoAdapter.Refresh();
+
+    while (WaitForNextWemoDiscoveryPass())
+    {
+        RunWemoDiscoveryPass(previousUdns);
+    }
+}
+
+} // namespace
+
+void ApplicationInit()
+{
+    gStartupBegin = std::chrono::steady_clock::now();
 
     // Clear out the device database
     memset(gDevices, 0, sizeof(gDevices));
+    gEndpointSlots.Clear();
     gBridgedWemoLights.clear();
-    gWemoDeviceToUdn.clear();
+    gWemoLightState.Resize(0);
+    gVacantWemoLights.clear();
+    ResetWemoLightIndex();
 
     // Keep symbols referenced even when mock/action/temp endpoints are not published.
     (void) gLight1DataVersions;
@@ -1295,132 +2362,109 @@ void ApplicationInit()
         static_cast<int>(emberAfEndpointFromIndex(static_cast<uint16_t>(emberAfFixedEndpointCount() - 1))) + 1);
     gCurrentEndpointId = gFirstDynamicEndpointId;
 
+    // Persisted UDN -> endpoint id map.  Ids stay the same across restarts
+    // and when other devices come or go, so controllers never have to
+    // re-read descriptors of unchanged devices.
+    gEndpointRegistry = std::make_unique<wemo_bridge::EndpointRegistry>(WEMO_ENDPOINT_REGISTRY_PATH, gFirstDynamicEndpointId);
+    // Owned for as long as the bridge runs, so an offline reclaim cannot
+    // hand out ids behind its back.
+    if (!gEndpointRegistry->LockStore(true))
+    {
+        ChipLogError(DeviceLayer, "Cannot lock endpoint map %s; offline reclaim is not excluded", WEMO_ENDPOINT_REGISTRY_PATH);
+    }
+    // Transient ids reserved by a previous run are free again; without the
+    // lock another bridge may still be using them.
+    else if (!gEndpointRegistry->ReleaseTransient())
+    {
+        ChipLogError(DeviceLayer, "Cannot release transient endpoint ids in %s", WEMO_ENDPOINT_REGISTRY_PATH);
+    }
+
     // Disable last fixed endpoint, which is used as a placeholder for all of the
     // supported clusters so that ZAP will generated the requisite code.
     emberAfEndpointEnableDisable(emberAfEndpointFromIndex(static_cast<uint16_t>(emberAfFixedEndpointCount() - 1)), false);
 
-    // Publish discovered WeMo lights up to dynamic endpoint capacity.
-    const size_t endpointCapacity = CHIP_DEVICE_CONFIG_DYNAMIC_ENDPOINT_COUNT;
-    gBridgedWemoLights.reserve(std::min(discovered.size(), endpointCapacity));
+    gWemoLightsOverCapacity.clear();
+    LogEndpointCapacityPlan();
 
-    for (const auto & dev : discovered)
+    // Per-device outbound command rate; WeMo firmware drops requests when
+    // SOAP calls arrive back to back.
+    const char * ratePerSec = std::getenv("WEMO_COMMAND_RATE_PER_SEC");
+    const char * rateBurst  = std::getenv("WEMO_COMMAND_BURST");
+    if (ratePerSec != nullptr || rateBurst != nullptr)
     {
-        if (gBridgedWemoLights.size() >= endpointCapacity)
-        {
-            ChipLogError(DeviceLayer, "Skipping WeMo device %s: dynamic endpoint capacity reached (%zu)", dev.friendly_name.c_str(),
-                         endpointCapacity);
-            continue;
-        }
-
-        BridgedWemoLight bridged;
-        bridged.wemo_id = dev.wemo_id;
-        bridged.udn = dev.udn;
-        bridged.is_dimmable = dev.supports_level;
-        const std::string name = dev.friendly_name.empty() ? std::string("WeMo Device") : dev.friendly_name;
-
-        EmberAfEndpointType * epType;
-        const EmberAfDeviceType * deviceTypes;
-        size_t deviceTypesCount;
+        const double perSecond = (ratePerSec != nullptr) ? std::atof(ratePerSec)
+                                                          : wemo_bridge::WemoAdapterOpenWemo::kDefaultCommandsPerSecond;
+        const double burst = (rateBurst != nullptr) ? std::atof(rateBurst) : wemo_bridge::WemoAdapterOpenWemo::kDefaultCommandBurst;
+        gWemoAdapter.SetCommandRateLimit(perSecond, burst);
+        ChipLogProgress(DeviceLayer, "WeMo command rate limit: %.2f/s, burst %.0f", perSecond, burst);
+    }
 
-        if (dev.supports_level)
-        {
-            auto dimmer = std::make_unique<DeviceDimmable>(name.c_str(), "WeMo");
-            dimmer->SetOnOff(dev.onoff != 0);
-            // Seed level: WeMo 0-100 -> Matter 0-254
-            dimmer->SetLevel(static_cast<uint8_t>(static_cast<uint16_t>(dev.level_percent) * 254u / 100u));
-            dimmer->SetReachable(dev.is_online);
-            bridged.device = std::move(dimmer);
-            epType = &bridgedDimmableLightEndpoint;
-            deviceTypes = gBridgedDimmableDeviceTypes;
-            deviceTypesCount = MATTER_ARRAY_SIZE(gBridgedDimmableDeviceTypes);
-            ChipLogProgress(DeviceLayer, "WeMo bind (dimmable): %s <- %s", name.c_str(), bridged.udn.c_str());
-        }
-        else
+    // How many devices are commanded in parallel; a scene touching more
+    // lights than this is spread over several round trips.
+    if (const char * workers = std::getenv("WEMO_COMMAND_WORKERS"))
+    {
+        const long count = std::strtol(workers, nullptr, 10);
+        if (count > 0)
         {
-            auto light = std::make_unique<DeviceOnOff>(name.c_str(), "WeMo");
-            light->SetOnOff(dev.onoff != 0);
-            light->SetReachable(dev.is_online);
-            bridged.device = std::move(light);
-            epType = &bridgedLightEndpoint;
-            deviceTypes = gBridgedOnOffDeviceTypes;
-            deviceTypesCount = MATTER_ARRAY_SIZE(gBridgedOnOffDeviceTypes);
-            ChipLogProgress(DeviceLayer, "WeMo bind (on/off): %s <- %s", name.c_str(), bridged.udn.c_str());
+            gWemoAdapter.SetCommandConcurrency(static_cast<size_t>(count));
+            ChipLogProgress(DeviceLayer, "WeMo command workers: %ld", count);
         }
+    }
 
-        // Push into the vector BEFORE registering the endpoint.  The CHIP SDK
-        // stores the DataVersion span pointer for the lifetime of the endpoint,
-        // so it must point into the vector's heap storage (which was pre-reserved
-        // above) rather than into the stack-local `bridged` variable.
-        gBridgedWemoLights.push_back(std::move(bridged));
-        auto & stable = gBridgedWemoLights.back();
+    // Hot-plug: how often discovery repeats, and how long a device may stay
+    // unreported before its endpoint is removed.  Zero disables either.
+    if (const char * interval = std::getenv("WEMO_DISCOVERY_INTERVAL_SEC"))
+    {
+        gDiscoveryInterval = std::chrono::seconds(std::max(0L, std::strtol(interval, nullptr, 10)));
+    }
+    if (const char * removeAfter = std::getenv("WEMO_REMOVE_AFTER_SEC"))
+    {
+        gWemoLightRemoveAfter = std::chrono::seconds(std::max(0L, std::strtol(removeAfter, nullptr, 10)));
+    }
+    ChipLogProgress(DeviceLayer, "WeMo discovery every %llds, unreported devices removed after %llds",
+                    static_cast<long long>(gDiscoveryInterval.count()), static_cast<long long>(gWemoLightRemoveAfter.count()));
+    gDiscoveryStopping = false;
 
-        // DataVersion span size must match the cluster count for the endpoint type.
-        const size_t clusterCount = stable.is_dimmable
-            ? MATTER_ARRAY_SIZE(bridgedDimmableLightClusters)
-            : MATTER_ARRAY_SIZE(bridgedLightClusters);
+    // Warm start: publish the device set of the previous run right away,
+    // with its last known state, instead of waiting for wemo_ctrl and SSDP.
+    // Everything but endpoint registration happens before the stack lock is
+    // taken, and all endpoints are registered under that one lock.
+    {
+        const auto loadStart = std::chrono::steady_clock::now();
+        WemoReconcileContext warm;
+        warm.devices           = wemo_bridge::LoadDeviceSnapshot(WEMO_DEVICE_SNAPSHOT_PATH);
+        const long long loadUs = MicrosecondsSince(loadStart);
 
-#if !CHIP_CONFIG_USE_ENDPOINT_UNIQUE_ID
-        const int addedIndex = AddDeviceEndpoint(stable.device.get(), epType,
-                                                 Span<const EmberAfDeviceType>(deviceTypes, deviceTypesCount),
-                                                 Span<DataVersion>(stable.dataVersions.data(), clusterCount), 1);
-#else
-        // Use the WeMo UDN as the endpoint unique ID.  Strip the "uuid:"
-        // prefix to fit within the 32-byte buffer.  This gives each bridged
-        // device a stable identity that survives restarts.
-        std::string epUniqueId = stable.udn;
-        if (epUniqueId.rfind("uuid:", 0) == 0)
-        {
-            epUniqueId = epUniqueId.substr(5);
-        }
-        if (epUniqueId.size() > 32)
-        {
-            epUniqueId.resize(32);
-        }
-        CharSpan udnSpan(epUniqueId.c_str(), epUniqueId.size());
-        const int addedIndex = AddDeviceEndpoint(stable.device.get(), epType,
-                                                 Span<const EmberAfDeviceType>(deviceTypes, deviceTypesCount),
-                                                 Span<DataVersion>(stable.dataVersions.data(), clusterCount), udnSpan, 1);
-#endif
-        if (addedIndex < 0)
+        // Engine probing and SSDP discovery take seconds; start them now so
+        // they overlap the rest of the warm start.  Their first reconcile
+        // runs on the Matter thread once the event loop starts, after the
+        // warm start, so the snapshot's devices count as already bridged.
+        std::unordered_set<std::string> snapshotUdns;
+        for (const auto & dev : warm.devices)
         {
-            ChipLogError(DeviceLayer, "Failed to publish WeMo device %s (udn=%s)", name.c_str(), stable.udn.c_str());
-            gBridgedWemoLights.pop_back();
-            continue;
+            snapshotUdns.insert(dev.udn);
         }
+        gDiscoveryThread = std::thread(DiscoverWemoDevices, std::move(snapshotUdns));
 
-        if (stable.is_dimmable)
-        {
-            // Dynamic endpoints don't get cluster init functions called
-            // automatically (DECLARE_DYNAMIC_CLUSTER passes NULL for the
-            // functions array).  Manually init the LevelControl server so
-            // its per-endpoint state (minLevel, maxLevel) is set up.
-            emberAfLevelControlClusterServerInitCallback(stable.device->GetEndpointId());
+        const auto prepareStart = std::chrono::steady_clock::now();
+        PrepareWemoLights(warm, {});
+        const long long prepareUs = MicrosecondsSince(prepareStart);
 
-            static_cast<DeviceDimmable *>(stable.device.get())->SetChangeCallback(&HandleDeviceDimmableStatusChanged);
-        }
-        else
+        const auto publishStart = std::chrono::steady_clock::now();
         {
-            static_cast<DeviceOnOff *>(stable.device.get())->SetChangeCallback(&HandleDeviceOnOffStatusChanged);
+            DeviceLayer::StackLock lock;
+            for (size_t i = 0; i < warm.devices.size(); i++)
+            {
+                if (FindBridgedWemoLight(warm.devices[i].udn) == nullptr)
+                {
+                    AddWemoLight(warm.devices[i], EndpointIdFor(warm.devices[i], warm.endpointIds[i]), std::move(warm.prepared[i]));
+                }
+            }
         }
-        gWemoDeviceToUdn[stable.device.get()] = stable.udn;
+        ChipLogProgress(DeviceLayer, "Published %zu WeMo devices from snapshot %s: load %lld us, prepare %lld us, register %lld us",
+                        BridgedWemoLightCount(), WEMO_DEVICE_SNAPSHOT_PATH, loadUs, prepareUs, MicrosecondsSince(publishStart));
     }
-
-    // Receive state events from wemo_ctrl (called from wemo_engine IPC thread).
-    // Dispatch to the Matter event loop to update bridged device state.
-    gWemoAdapter.RegisterStateCallback([](const wemo_bridge::WemoStateEvent & ev) {
-        auto * ctx       = Platform::New<WemoEventContext>();
-        ctx->wemo_id     = ev.wemo_id;
-        ctx->is_online   = ev.is_online;
-        ctx->state       = ev.state;
-        ctx->level       = ev.level;
-        TEMPORARY_RETURN_IGNORED PlatformMgr().ScheduleWork(HandleWemoEventOnMatterThread, reinterpret_cast<intptr_t>(ctx));
-    });
-
-    // Re-trigger SSDP discovery now that the callback is registered.  Events
-    // fired during the initial Discover() call were lost (callback not yet set).
-    // This refresh causes wemo_ctrl to re-probe all devices and deliver fresh
-    // state events, so bridged devices come online quickly after startup.
-    gWemoAdapter.Refresh();
+    TEMPORARY_RETURN_IGNORED PlatformMgr().ScheduleWork(NotifyBridgeServing, 0);
 
     gRooms.clear();
     gActions.clear();
@@ -1441,7 +2485,26 @@ void ApplicationInit()
     VerifyOrDie(CodegenDataModelProvider::Instance().Registry().Register(gIdentifyClusterEp1.Registration()) == CHIP_NO_ERROR);
 }
 
-void ApplicationShutdown() {}
+void ApplicationShutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(gDiscoveryMutex);
+        gDiscoveryStopping = true;
+    }
+    gDiscoveryWake.notify_all();
+    // A pass in progress finishes first; its reconcile is dropped if the
+    // event loop is already gone.
+    if (gDiscoveryThread.joinable())
+    {
+        gDiscoveryThread.join();
+    }
+
+    // Let queued WeMo commands finish before the process exits.
+    gWemoAdapter.Shutdown();
+
+    // Persist the final state so the next start publishes it immediately.
+    wemo_bridge::SaveDeviceSnapshot(WEMO_DEVICE_SNAPSHOT_PATH, SnapshotBridgedWemoLights());
+}
 
 int main(int argc, char * argv[])
 {
@@ -0,0 +1,196 @@
+#include "wemo_bridge/command_executor.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace wemo_bridge {
+
+CommandExecutor::CommandExecutor(size_t worker_count, size_t max_pending, AdmitFn admit) :
+    mMaxPending(max_pending), mAdmit(std::move(admit))
+{
+    if (worker_count == 0)
+    {
+        worker_count = 1;
+    }
+    mWorkers.reserve(worker_count);
+    for (size_t i = 0; i < worker_count; i++)
+    {
+        mWorkers.emplace_back(&CommandExecutor::WorkerLoop, this);
+    }
+}
+
+CommandExecutor::~CommandExecutor()
+{
+    Shutdown();
+}
+
+bool CommandExecutor::TrySubmit(uint64_t key, Task task)
+{
+    return Enqueue(key, 0, std::move(task), nullptr);
+}
+
+bool CommandExecutor::TrySubmitLatest(uint64_t key, uint32_t kind, Task task, Task on_superseded)
+{
+    return Enqueue(key, kind, std::move(task), std::move(on_superseded));
+}
+
+bool CommandExecutor::Enqueue(uint64_t key, uint32_t kind, Task task, Task on_superseded)
+{
+    bool replaced_queued = false;
+    Task superseded;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (mStopping)
+        {
+            return false;
+        }
+
+        auto it = mStrands.find(key);
+        if (it != mStrands.end() && kind != 0)
+        {
+            auto & tasks  = it->second.tasks;
+            auto replaced = std::find_if(tasks.begin(), tasks.end(), [kind](const QueuedTask & queued) { return queued.kind == kind; });
+            if (replaced != tasks.end())
+            {
+                superseded = std::move(replaced->on_superseded);
+                tasks.erase(replaced);
+                tasks.push_back({ std::move(task), kind, std::move(on_superseded) });
+                replaced_queued = true;
+            }
+        }
+
+        if (!replaced_queued)
+        {
+            if (mPending >= mMaxPending)
+            {
+                return false;
+            }
+
+            mPending++;
+            if (it != mStrands.end())
+            {
+                // Already scheduled (ready, deferred) or running; the worker
+                // that finishes the running task requeues the strand.
+                it->second.tasks.push_back({ std::move(task), kind, std::move(on_superseded) });
+                return true;
+            }
+            mStrands[key].tasks.push_back({ std::move(task), kind, std::move(on_superseded) });
+            mReady.push_back(key);
+        }
+    }
+
+    if (replaced_queued)
+    {
+        // The strand is already scheduled; only tell the dropped task.
+        if (superseded)
+        {
+            superseded();
+        }
+        return true;
+    }
+    mCv.notify_one();
+    return true;
+}
+
+void CommandExecutor::Shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mCv.notify_all();
+
+    for (auto & worker : mWorkers)
+    {
+        if (worker.joinable())
+        {
+            worker.join();
+        }
+    }
+    mWorkers.clear();
+}
+
+void CommandExecutor::PromoteDueLocked(Clock::time_point now)
+{
+    while (!mDeferred.empty() && mDeferred.begin()->first <= now)
+    {
+        mReady.push_back(mDeferred.begin()->second);
+        mDeferred.erase(mDeferred.begin());
+    }
+}
+
+void CommandExecutor::WorkerLoop()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (true)
+    {
+        PromoteDueLocked(Clock::now());
+        if (mReady.empty())
+        {
+            if (mStopping && mPending == 0)
+            {
+                return;
+            }
+            if (mDeferred.empty())
+            {
+                mCv.wait(lock);
+            }
+            else
+            {
+                mCv.wait_until(lock, mDeferred.begin()->first);
+            }
+            continue;
+        }
+
+        const uint64_t key = mReady.front();
+        mReady.pop_front();
+
+        if (mAdmit)
+        {
+            lock.unlock();
+            const Clock::time_point admit_at = mAdmit(key);
+            lock.lock();
+            if (admit_at > Clock::now())
+            {
+                // Not this worker's problem any more: the strand waits in
+                // mDeferred and whoever wakes first after admit_at retries it.
+                const bool earliest = mDeferred.empty() || admit_at < mDeferred.begin()->first;
+                mDeferred.emplace(admit_at, key);
+                if (earliest)
+                {
+                    mCv.notify_all();
+                }
+                continue;
+            }
+        }
+
+        auto & tasks = mStrands[key].tasks;
+        Task task    = std::move(tasks.front().task);
+        tasks.pop_front();
+
+        lock.unlock();
+        task();
+        task = nullptr;
+        lock.lock();
+
+        mPending--;
+        auto it = mStrands.find(key);
+        if (it->second.tasks.empty())
+        {
+            mStrands.erase(it);
+        }
+        else
+        {
+            // Back of the line so one busy device cannot starve the others.
+            mReady.push_back(key);
+            mCv.notify_one();
+        }
+
+        if (mStopping && mPending == 0)
+        {
+            mCv.notify_all();
+        }
+    }
+}
+
+} // namespace wemo_bridge
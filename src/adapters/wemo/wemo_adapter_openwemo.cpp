@@ -3,9 +3,15 @@
 #include <unistd.h>
 
 #include <algorithm>
+#include <chrono>
+#include <condition_variable>
 #include <cstdio>
+#include <functional>
+#include <iterator>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
@@ -31,6 +37,11 @@ namespace {
 // WEMO_DIMMER = 4 from wemo_engine.h dev_id_t enum
 constexpr int kTypeDimmer = 4;
 
+// Engine readiness probing: first retry after kProbeInitialDelay, doubling up
+// to kProbeMaxDelay between attempts.
+constexpr auto kProbeInitialDelay = std::chrono::milliseconds(50);
+constexpr auto kProbeMaxDelay     = std::chrono::milliseconds(2000);
+
 #if HAVE_OPENWEMO_ENGINE
 void MaybeConfigureIpcTarget(const std::string & engine_socket)
 {
@@ -49,7 +60,7 @@ void MaybeConfigureIpcTarget(const std::string & engine_socket)
     }
 }
 
-bool EnsureEngineInitialized(const std::string & engine_socket)
+bool EnsureEngineInitialized(const std::string & engine_socket, bool log_failure = true)
 {
     static std::mutex init_lock;
     static bool target_configured = false;
@@ -68,7 +79,7 @@ bool EnsureEngineInitialized(const std::string & engine_socket)
     }
 
     initialized = (we_init() != 0);
-    if (!initialized)
+    if (!initialized && log_failure)
     {
         std::fprintf(stderr, "wemo_adapter: we_init failed (socket=%s)\n", engine_socket.c_str());
     }
@@ -76,16 +87,23 @@ bool EnsureEngineInitialized(const std::string & engine_socket)
     return initialized;
 }
 
-bool SendState(int wemo_id, int state, int level)
+CommandResult SendState(int wemo_id, int state, int level)
 {
     struct we_state target {};
     target.state     = state;
     target.level     = level;
     target.is_online = 1;
 
+    const auto start = std::chrono::steady_clock::now();
     const int rc_set = we_set_action(wemo_id, &target);
-    std::fprintf(stderr, "wemo_adapter: set_action wemo_id=%d state=%d level=%d rc=%d\n", wemo_id, state, level, rc_set);
-    return rc_set != 0;
+
+    CommandResult result;
+    result.status     = (rc_set != 0) ? CommandStatus::kOk : CommandStatus::kEngineError;
+    result.engine_rc  = rc_set;
+    result.round_trip = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    std::fprintf(stderr, "wemo_adapter: set_action wemo_id=%d state=%d level=%d rc=%d rtt_us=%lld\n", wemo_id, state, level, rc_set,
+                 static_cast<long long>(result.round_trip.count()));
+    return result;
 }
 
 StateEventCallback gStateCallback;
@@ -106,7 +124,177 @@ void OnWeStateEvent(int wemo_id, struct we_state * data)
 
 } // namespace
 
-WemoAdapterOpenWemo::WemoAdapterOpenWemo(std::string engine_socket) : mEngineSocket(std::move(engine_socket)) {}
+WemoAdapterOpenWemo::WemoAdapterOpenWemo(std::string engine_socket) :
+    mEngineSocket(std::move(engine_socket)), mHandles(std::make_shared<const HandleIndex>()),
+    mWemoIds(std::make_shared<const WemoIdTable>())
+{}
+
+WemoAdapterOpenWemo::~WemoAdapterOpenWemo()
+{
+    Shutdown();
+}
+
+DeviceHandle WemoAdapterOpenWemo::Resolve(const std::string & udn)
+{
+    if (udn.empty())
+    {
+        return {};
+    }
+
+    for (int attempt = 0; attempt < 2; attempt++)
+    {
+        const auto handles = std::atomic_load(&mHandles);
+        const auto it      = handles->by_udn.find(udn);
+        if (it != handles->by_udn.end())
+        {
+            return DeviceHandle { it->second };
+        }
+        if (attempt == 0)
+        {
+            PublishWemoIds({ { udn, kUnresolvedWemoId } }, false);
+        }
+    }
+    return {};
+}
+
+std::vector<DeviceHandle> WemoAdapterOpenWemo::ResolveMany(const std::vector<std::string> & udns)
+{
+    std::vector<std::pair<std::string, int>> unknown;
+    {
+        const auto handles = std::atomic_load(&mHandles);
+        for (const auto & udn : udns)
+        {
+            if (!udn.empty() && handles->by_udn.find(udn) == handles->by_udn.end())
+            {
+                unknown.emplace_back(udn, kUnresolvedWemoId);
+            }
+        }
+    }
+    if (!unknown.empty())
+    {
+        PublishWemoIds(unknown, false);
+    }
+
+    const auto handles = std::atomic_load(&mHandles);
+    std::vector<DeviceHandle> result;
+    result.reserve(udns.size());
+    for (const auto & udn : udns)
+    {
+        const auto it = handles->by_udn.find(udn);
+        result.push_back((it != handles->by_udn.end()) ? DeviceHandle { it->second } : DeviceHandle {});
+    }
+    return result;
+}
+
+std::string WemoAdapterOpenWemo::UdnOf(DeviceHandle device) const
+{
+    const auto handles = std::atomic_load(&mHandles);
+    return device.value < handles->udns.size() ? handles->udns[device.value] : std::string();
+}
+
+std::optional<int> WemoAdapterOpenWemo::LookupWemoId(DeviceHandle device) const
+{
+    const auto wemo_ids = std::atomic_load(&mWemoIds);
+    if (device.value >= wemo_ids->size())
+    {
+        return std::nullopt;
+    }
+
+    const int wemo_id = (*wemo_ids)[device.value];
+    if (wemo_id == kUnresolvedWemoId)
+    {
+        return std::nullopt;
+    }
+    return wemo_id;
+}
+
+void WemoAdapterOpenWemo::PublishWemoIds(const std::vector<std::pair<std::string, int>> & resolved, bool complete)
+{
+    std::lock_guard<std::mutex> lock(mPublishMutex);
+
+    const auto current_handles = std::atomic_load(&mHandles);
+    std::shared_ptr<HandleIndex> new_handles;
+    // A complete list starts from nothing, so a device it no longer reports
+    // loses its id instead of keeping one the engine may have reassigned.
+    const auto current_ids = std::atomic_load(&mWemoIds);
+    auto wemo_ids          = complete ? std::make_shared<WemoIdTable>(current_ids->size(), kUnresolvedWemoId)
+                                      : std::make_shared<WemoIdTable>(*current_ids);
+
+    for (const auto & [udn, wemo_id] : resolved)
+    {
+        if (udn.empty())
+        {
+            continue;
+        }
+
+        const HandleIndex & handles = new_handles ? *new_handles : *current_handles;
+        auto it                     = handles.by_udn.find(udn);
+        uint32_t handle;
+        if (it != handles.by_udn.end())
+        {
+            handle = it->second;
+        }
+        else
+        {
+            // Copy the index only when a UDN is seen for the first time.
+            if (!new_handles)
+            {
+                new_handles = std::make_shared<HandleIndex>(*current_handles);
+            }
+            handle = static_cast<uint32_t>(new_handles->udns.size());
+            new_handles->by_udn.emplace(udn, handle);
+            new_handles->udns.push_back(udn);
+            wemo_ids->push_back(kUnresolvedWemoId);
+        }
+        if (wemo_id != kUnresolvedWemoId)
+        {
+            (*wemo_ids)[handle] = wemo_id;
+        }
+    }
+
+    std::atomic_store(&mWemoIds, std::shared_ptr<const WemoIdTable>(std::move(wemo_ids)));
+    if (new_handles)
+    {
+        std::atomic_store(&mHandles, std::shared_ptr<const HandleIndex>(std::move(new_handles)));
+    }
+}
+
+bool WemoAdapterOpenWemo::WaitUntilReady(std::chrono::milliseconds budget)
+{
+#if !HAVE_OPENWEMO_ENGINE
+    // Nothing to wait for; Discover() reports no devices.
+    (void) budget;
+    return true;
+#else
+    const auto start    = std::chrono::steady_clock::now();
+    const auto deadline = start + budget;
+    auto delay          = std::chrono::duration_cast<std::chrono::milliseconds>(kProbeInitialDelay);
+    int attempts        = 0;
+
+    while (true)
+    {
+        attempts++;
+        if (EnsureEngineInitialized(mEngineSocket, false))
+        {
+            const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+            std::fprintf(stderr, "wemo_adapter: engine ready after %lld ms (%d attempts)\n", static_cast<long long>(elapsed.count()),
+                         attempts);
+            return true;
+        }
+
+        const auto now = std::chrono::steady_clock::now();
+        if (now >= deadline)
+        {
+            break;
+        }
+        std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(delay, deadline - now));
+        delay = std::min(delay * 2, std::chrono::duration_cast<std::chrono::milliseconds>(kProbeMaxDelay));
+    }
+
+    std::fprintf(stderr, "wemo_adapter: engine not answering after %d attempts (socket=%s)\n", attempts, mEngineSocket.c_str());
+    return false;
+#endif
+}
 
 std::vector<WemoDevice> WemoAdapterOpenWemo::Discover()
 {
@@ -128,10 +316,9 @@ std::vector<WemoDevice> WemoAdapterOpenWemo::Discover()
         return devices;
     }
 
-    std::lock_guard<std::mutex> lock(mCacheMutex);
-    mUdnToWemoId.clear();
-
     const int count = std::clamp(list.count, 0, WE_DEVICE_LIST_MAX_ITEMS);
+    std::vector<std::pair<std::string, int>> resolved;
+    resolved.reserve(static_cast<size_t>(count));
     for (int i = 0; i < count; i++)
     {
         const struct we_device_info & info = list.items[i];
@@ -150,13 +337,10 @@ std::vector<WemoDevice> WemoAdapterOpenWemo::Discover()
             device.level_percent = static_cast<uint8_t>(std::clamp(info.level, 0, 100));
         }
 
-        if (!device.udn.empty())
-        {
-            mUdnToWemoId[device.udn] = device.wemo_id;
-        }
-
+        resolved.emplace_back(device.udn, device.wemo_id);
         devices.push_back(std::move(device));
     }
+    PublishWemoIds(resolved, true);
 #endif
 
     return devices;
@@ -172,6 +356,80 @@ void WemoAdapterOpenWemo::Refresh()
 #endif
 }
 
+void WemoAdapterOpenWemo::SetCommandRateLimit(double per_second, double burst)
+{
+    std::lock_guard<std::mutex> lock(mRateMutex);
+    mCommandsPerSecond = per_second;
+    mCommandBurst      = std::max(burst, 1.0);
+    mTokenBuckets.clear();
+}
+
+WemoAdapterOpenWemo::TokenBucket & WemoAdapterOpenWemo::RefillTokensLocked(DeviceHandle device,
+                                                                           std::chrono::steady_clock::time_point now)
+{
+    auto [it, inserted] = mTokenBuckets.try_emplace(device.value);
+    TokenBucket & bucket = it->second;
+    if (inserted)
+    {
+        bucket.tokens = mCommandBurst;
+    }
+    else
+    {
+        const std::chrono::duration<double> elapsed = now - bucket.refilled;
+        bucket.tokens = std::min(mCommandBurst, bucket.tokens + elapsed.count() * mCommandsPerSecond);
+    }
+    bucket.refilled = now;
+    return bucket;
+}
+
+std::chrono::steady_clock::time_point WemoAdapterOpenWemo::TryTakeCommandToken(DeviceHandle device)
+{
+    std::lock_guard<std::mutex> lock(mRateMutex);
+    const auto now = std::chrono::steady_clock::now();
+    if (mCommandsPerSecond <= 0)
+    {
+        return now;
+    }
+
+    TokenBucket & bucket = RefillTokensLocked(device, now);
+    if (bucket.tokens >= 1.0)
+    {
+        bucket.tokens -= 1.0;
+        return now;
+    }
+    // Nothing is reserved: the command still queued at that time (possibly
+    // a newer one that superseded it) asks again.
+    const std::chrono::duration<double> wait((1.0 - bucket.tokens) / mCommandsPerSecond);
+    return now + std::chrono::ceil<std::chrono::steady_clock::duration>(wait);
+}
+
+void WemoAdapterOpenWemo::AwaitCommandToken(DeviceHandle device)
+{
+    std::chrono::duration<double> wait(0);
+    {
+        std::lock_guard<std::mutex> lock(mRateMutex);
+        if (mCommandsPerSecond <= 0)
+        {
+            return;
+        }
+
+        TokenBucket & bucket = RefillTokensLocked(device, std::chrono::steady_clock::now());
+
+        // Take the token now; a negative balance is a reservation that the
+        // caller pays for by sleeping until it has been refilled.
+        bucket.tokens -= 1.0;
+        if (bucket.tokens < 0)
+        {
+            wait = std::chrono::duration<double>(-bucket.tokens / mCommandsPerSecond);
+        }
+    }
+
+    if (wait.count() > 0)
+    {
+        std::this_thread::sleep_for(wait);
+    }
+}
+
 void WemoAdapterOpenWemo::RegisterStateCallback(StateEventCallback cb)
 {
 #if HAVE_OPENWEMO_ENGINE
@@ -185,101 +443,253 @@ void WemoAdapterOpenWemo::RegisterStateCallback(StateEventCallback cb)
 #endif
 }
 
-bool WemoAdapterOpenWemo::SetOnOff(const std::string & udn, bool on)
+std::optional<int> WemoAdapterOpenWemo::ResolveWemoId(DeviceHandle device)
 {
+    // Fast path: cache lookup
+    if (const auto wemo_id = LookupWemoId(device))
+    {
+        return wemo_id;
+    }
+
 #if !HAVE_OPENWEMO_ENGINE
-    (void) udn;
-    (void) on;
-    return false;
+    return std::nullopt;
 #else
-    if (!EnsureEngineInitialized(mEngineSocket))
+    const std::string udn = UdnOf(device);
+    if (udn.empty())
     {
-        return false;
+        return std::nullopt;
     }
 
-    // Fast path: cache lookup
+    std::unique_lock<std::mutex> lock(mResolveMutex);
+    const auto now      = std::chrono::steady_clock::now();
+    const auto negative = mUnresolvedUntil.find(device.value);
+    if (negative != mUnresolvedUntil.end())
     {
-        std::lock_guard<std::mutex> lock(mCacheMutex);
-        auto it = mUdnToWemoId.find(udn);
-        if (it != mUdnToWemoId.end())
+        if (now < negative->second)
         {
-            return SendState(it->second, on ? 1 : 0, -1);
+            return std::nullopt;
         }
+        mUnresolvedUntil.erase(negative);
     }
 
-    // Cache miss: refresh device list and retry
-    (void) we_discover(0);
-    struct we_device_list list {};
-    if (we_list_devices(&list) == WE_STATUS_OK)
+    if (mResolveInFlight)
     {
-        std::lock_guard<std::mutex> lock(mCacheMutex);
-        const int count = std::clamp(list.count, 0, WE_DEVICE_LIST_MAX_ITEMS);
-        for (int i = 0; i < count; i++)
+        // Share the pass that is already running instead of starting another.
+        const uint64_t generation = mResolveGeneration;
+        mResolveCv.wait(lock, [&] { return mResolveGeneration != generation; });
+    }
+    else
+    {
+        mResolveInFlight = true;
+        lock.unlock();
+
+        // Cache miss: refresh device list
+        (void) we_discover(0);
+        struct we_device_list list {};
+        if (we_list_devices(&list) == WE_STATUS_OK)
         {
-            if (list.items[i].udn[0] != '\0')
+            const int count = std::clamp(list.count, 0, WE_DEVICE_LIST_MAX_ITEMS);
+            std::vector<std::pair<std::string, int>> resolved;
+            resolved.reserve(static_cast<size_t>(count));
+            for (int i = 0; i < count; i++)
             {
-                mUdnToWemoId[list.items[i].udn] = list.items[i].wemo_id;
+                resolved.emplace_back(list.items[i].udn, list.items[i].wemo_id);
             }
+            PublishWemoIds(resolved, true);
         }
-        auto it = mUdnToWemoId.find(udn);
-        if (it != mUdnToWemoId.end())
+
+        lock.lock();
+        mResolveInFlight = false;
+        mResolveGeneration++;
+        mResolveCv.notify_all();
+    }
+
+    if (const auto wemo_id = LookupWemoId(device))
+    {
+        return wemo_id;
+    }
+
+    // Still unknown (device removed or offline): fail fast until the TTL
+    // expires or a discovery pass reports the UDN again.
+    if (mUnresolvedUntil.size() >= kMaxUnresolvedEntries)
+    {
+        for (auto it = mUnresolvedUntil.begin(); it != mUnresolvedUntil.end();)
         {
-            return SendState(it->second, on ? 1 : 0, -1);
+            it = (it->second <= now) ? mUnresolvedUntil.erase(it) : std::next(it);
         }
     }
-
-    return false;
+    if (mUnresolvedUntil.size() < kMaxUnresolvedEntries)
+    {
+        mUnresolvedUntil[device.value] = std::chrono::steady_clock::now() + kUnresolvedTtl;
+    }
+    std::fprintf(stderr, "wemo_adapter: cannot resolve udn=%s\n", udn.c_str());
+    return std::nullopt;
 #endif
 }
 
-bool WemoAdapterOpenWemo::SetLevelPercent(const std::string & udn, uint8_t percent)
+CommandResult WemoAdapterOpenWemo::SetOnOff(DeviceHandle device, bool on)
+{
+    return Send(DeviceCommand::OnOff(device, on), true);
+}
+
+CommandResult WemoAdapterOpenWemo::SetLevelPercent(DeviceHandle device, uint8_t percent)
+{
+    return Send(DeviceCommand::Level(device, percent), true);
+}
+
+CommandResult WemoAdapterOpenWemo::Send(const DeviceCommand & command, bool await_token)
 {
 #if !HAVE_OPENWEMO_ENGINE
-    (void) udn;
-    (void) percent;
-    return false;
+    (void) command;
+    (void) await_token;
+    return { CommandStatus::kEngineUnavailable };
 #else
+    if (!command.device.IsValid())
+    {
+        return { CommandStatus::kInvalidHandle };
+    }
     if (!EnsureEngineInitialized(mEngineSocket))
     {
-        return false;
+        return { CommandStatus::kEngineUnavailable };
     }
 
-    const int clamped = std::clamp(static_cast<int>(percent), 0, 100);
-    const int state   = (clamped > 0) ? 1 : 0;
+    const auto wemo_id = ResolveWemoId(command.device);
+    if (!wemo_id)
+    {
+        return { CommandStatus::kUnresolved };
+    }
 
-    // Fast path: cache lookup
+    int state = command.on ? 1 : 0;
+    int level = -1;
+    if (command.kind == DeviceCommand::Kind::kLevel)
     {
-        std::lock_guard<std::mutex> lock(mCacheMutex);
-        auto it = mUdnToWemoId.find(udn);
-        if (it != mUdnToWemoId.end())
-        {
-            return SendState(it->second, state, clamped);
-        }
+        level = std::clamp(static_cast<int>(command.level_percent), 0, 100);
+        state = (level > 0) ? 1 : 0;
     }
 
-    // Cache miss: refresh device list and retry
-    (void) we_discover(0);
-    struct we_device_list list {};
-    if (we_list_devices(&list) == WE_STATUS_OK)
+    if (await_token)
     {
-        std::lock_guard<std::mutex> lock(mCacheMutex);
-        const int count = std::clamp(list.count, 0, WE_DEVICE_LIST_MAX_ITEMS);
-        for (int i = 0; i < count; i++)
-        {
-            if (list.items[i].udn[0] != '\0')
+        AwaitCommandToken(command.device);
+    }
+    return SendState(*wemo_id, state, level);
+#endif
+}
+
+bool WemoAdapterOpenWemo::SetOnOffAsync(DeviceHandle device, bool on, CommandCallback done)
+{
+    return SubmitCommand(DeviceCommand::OnOff(device, on), kCommandKindOnOff, std::move(done));
+}
+
+bool WemoAdapterOpenWemo::SetLevelPercentAsync(DeviceHandle device, uint8_t percent, CommandCallback done)
+{
+    return SubmitCommand(DeviceCommand::Level(device, percent), kCommandKindLevel, std::move(done));
+}
+
+CommandExecutor * WemoAdapterOpenWemo::AcquireExecutor()
+{
+    std::lock_guard<std::mutex> lock(mExecutorMutex);
+    if (mShutDown)
+    {
+        return nullptr;
+    }
+    // Started lazily so one-shot CLI invocations never spawn the pool.
+    if (!mExecutor)
+    {
+        // Rate limiting happens at admission, so a strand without a token
+        // waits in the executor instead of on a worker, and the command
+        // that finally goes out is the newest one queued.
+        mExecutor = std::make_unique<CommandExecutor>(mCommandWorkers, CommandExecutor::kDefaultMaxPending, [this](uint64_t key) {
+            return TryTakeCommandToken(DeviceHandle { static_cast<uint32_t>(key) });
+        });
+    }
+    return mExecutor.get();
+}
+
+void WemoAdapterOpenWemo::SetCommandConcurrency(size_t workers)
+{
+    std::lock_guard<std::mutex> lock(mExecutorMutex);
+    mCommandWorkers = std::max<size_t>(workers, 1);
+}
+
+bool WemoAdapterOpenWemo::SubmitCommand(const DeviceCommand & command, uint32_t kind, CommandCallback done)
+{
+    CommandExecutor * executor = AcquireExecutor();
+    if (executor == nullptr)
+    {
+        return false;
+    }
+
+    CommandExecutor::Task on_superseded;
+    if (done)
+    {
+        on_superseded = [done] { done({ CommandStatus::kSuperseded }); };
+    }
+    return executor->TrySubmitLatest(
+        command.device.value, kind,
+        [this, command, done = std::move(done)] {
+            const CommandResult result = Send(command, false);
+            if (done)
             {
-                mUdnToWemoId[list.items[i].udn] = list.items[i].wemo_id;
+                done(result);
             }
-        }
-        auto it = mUdnToWemoId.find(udn);
-        if (it != mUdnToWemoId.end())
+        },
+        std::move(on_superseded));
+}
+
+std::vector<CommandResult> WemoAdapterOpenWemo::ApplyBatch(const std::vector<DeviceCommand> & commands)
+{
+    struct Batch
+    {
+        std::mutex mutex;
+        std::condition_variable cv;
+        size_t remaining = 0; // commands still queued or running
+        std::vector<CommandResult> results;
+    };
+
+    auto batch = std::make_shared<Batch>();
+    batch->results.assign(commands.size(), CommandResult { CommandStatus::kRejected });
+    batch->remaining = commands.size();
+
+    // One task per command so each one is admitted (rate limited) on its
+    // own; the device's strand keeps them in input order.
+    CommandExecutor * executor = AcquireExecutor();
+    for (size_t i = 0; i < commands.size(); i++)
+    {
+        // Each task writes only its own result slot; the batch mutex
+        // publishes it to the waiting caller.
+        const bool queued = (executor != nullptr) &&
+            executor->TrySubmit(commands[i].device.value, [this, batch, command = commands[i], i] {
+                batch->results[i] = Send(command, false);
+                std::lock_guard<std::mutex> lock(batch->mutex);
+                if (--batch->remaining == 0)
+                {
+                    batch->cv.notify_all();
+                }
+            });
+        if (!queued)
         {
-            return SendState(it->second, state, clamped);
+            std::lock_guard<std::mutex> lock(batch->mutex);
+            batch->remaining--;
         }
     }
 
-    return false;
-#endif
+    std::unique_lock<std::mutex> lock(batch->mutex);
+    batch->cv.wait(lock, [&] { return batch->remaining == 0; });
+    return std::move(batch->results);
+}
+
+void WemoAdapterOpenWemo::Shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(mExecutorMutex);
+        mShutDown = true;
+    }
+    // The executor itself lives until the destructor, so a submitter that
+    // raced with us still holds a valid pointer and is simply rejected.
+    if (mExecutor)
+    {
+        mExecutor->Shutdown();
+    }
 }
 
 } // namespace wemo_bridge
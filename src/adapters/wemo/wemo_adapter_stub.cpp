@@ -7,14 +7,19 @@ std::vector<WemoDevice> WemoAdapterStub::Discover()
     return {};
 }
 
-bool WemoAdapterStub::SetOnOff(const std::string &, bool)
+DeviceHandle WemoAdapterStub::Resolve(const std::string &)
 {
-    return false;
+    return {};
+}
+
+CommandResult WemoAdapterStub::SetOnOff(DeviceHandle, bool)
+{
+    return { CommandStatus::kUnsupported };
 }
 
-bool WemoAdapterStub::SetLevelPercent(const std::string &, uint8_t)
+CommandResult WemoAdapterStub::SetLevelPercent(DeviceHandle, uint8_t)
 {
-    return false;
+    return { CommandStatus::kUnsupported };
 }
 
 } // namespace wemo_bridge
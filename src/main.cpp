@@ -1,7 +1,9 @@
+#include <chrono>
 #include <cstdlib>
 #include <iostream>
 #include <optional>
 #include <string>
+#include <vector>
 
 #include "wemo_bridge/endpoint_registry.h"
 #include "wemo_bridge/wemo_adapter_openwemo.h"
@@ -12,9 +14,10 @@ void PrintUsage(const char * bin)
 {
     std::cout << "Usage:\n"
               << "  " << bin << " list\n"
-              << "  " << bin << " set-on <udn>\n"
-              << "  " << bin << " set-off <udn>\n"
-              << "  " << bin << " set-level <udn> <0-100>\n";
+              << "  " << bin << " set-on <udn> [<udn>...]\n"
+              << "  " << bin << " set-off <udn> [<udn>...]\n"
+              << "  " << bin << " set-level <udn> <0-100>\n"
+              << "  " << bin << " reclaim <days>\n";
 }
 
 std::optional<int> ParsePercent(const std::string & value)
@@ -39,9 +42,20 @@ int main(int argc, char ** argv)
     {
         const auto devices = adapter.Discover();
         std::cout << "discovered_devices=" << devices.size() << std::endl;
+
+        std::vector<std::string> udns;
+        udns.reserve(devices.size());
         for (const auto & device : devices)
         {
-            const auto endpoint_id = registry.GetOrAssign(device.udn);
+            udns.push_back(device.udn);
+        }
+        const auto endpoint_ids = registry.GetOrAssignMany(udns);
+        registry.MarkSeen(udns);
+
+        for (size_t i = 0; i < devices.size(); i++)
+        {
+            const auto & device      = devices[i];
+            const auto & endpoint_id = endpoint_ids[i];
             std::cout << "udn=" << device.udn << " wemo_id=" << device.wemo_id
                       << " endpoint=" << (endpoint_id.has_value() ? std::to_string(endpoint_id.value()) : "n/a")
                       << " online=" << (device.is_online ? "1" : "0")
@@ -55,17 +69,35 @@ int main(int argc, char ** argv)
     }
 
     const std::string cmd = argv[1];
-    if ((cmd == "set-on" || cmd == "set-off") && argc == 3)
+    if ((cmd == "set-on" || cmd == "set-off") && argc >= 3)
     {
-        const std::string udn = argv[2];
+        // Several UDNs go out as one batch, so every device switches within
+        // about one round trip.
         const bool on = (cmd == "set-on");
-        if (!adapter.SetOnOff(udn, on))
+        std::vector<std::string> udns(argv + 2, argv + argc);
+        std::vector<wemo_bridge::DeviceCommand> commands;
+        commands.reserve(udns.size());
+        for (const auto & udn : udns)
         {
-            std::cerr << "failed: " << cmd << " udn=" << udn << std::endl;
-            return 1;
+            commands.push_back(wemo_bridge::DeviceCommand::OnOff(adapter.Resolve(udn), on));
         }
-        std::cout << "ok: " << cmd << " udn=" << udn << std::endl;
-        return 0;
+        adapter.SetCommandConcurrency(commands.size());
+        const auto results = adapter.ApplyBatch(commands);
+
+        int status = 0;
+        for (size_t i = 0; i < udns.size(); i++)
+        {
+            const auto & result = results[i];
+            if (!result.Succeeded())
+            {
+                std::cerr << "failed: " << cmd << " udn=" << udns[i] << " status=" << wemo_bridge::CommandStatusName(result.status)
+                          << " rc=" << result.engine_rc << std::endl;
+                status = 1;
+                continue;
+            }
+            std::cout << "ok: " << cmd << " udn=" << udns[i] << " rtt_us=" << result.round_trip.count() << std::endl;
+        }
+        return status;
     }
 
     if (cmd == "set-level" && argc == 4)
@@ -77,12 +109,39 @@ int main(int argc, char ** argv)
             std::cerr << "invalid level percent: " << argv[3] << std::endl;
             return 1;
         }
-        if (!adapter.SetLevelPercent(udn, static_cast<uint8_t>(percent.value())))
+        const auto result = adapter.SetLevelPercent(udn, static_cast<uint8_t>(percent.value()));
+        if (!result.Succeeded())
+        {
+            std::cerr << "failed: set-level udn=" << udn << " percent=" << percent.value()
+                      << " status=" << wemo_bridge::CommandStatusName(result.status) << " rc=" << result.engine_rc << std::endl;
+            return 1;
+        }
+        std::cout << "ok: set-level udn=" << udn << " percent=" << percent.value()
+                  << " rtt_us=" << result.round_trip.count() << std::endl;
+        return 0;
+    }
+
+    if (cmd == "reclaim" && argc == 3)
+    {
+        char * end      = nullptr;
+        const long days = std::strtol(argv[2], &end, 10);
+        if (end == nullptr || *end != '\0' || days < 0)
         {
-            std::cerr << "failed: set-level udn=" << udn << " percent=" << percent.value() << std::endl;
+            std::cerr << "invalid day count: " << argv[2] << std::endl;
             return 1;
         }
-        std::cout << "ok: set-level udn=" << udn << " percent=" << percent.value() << std::endl;
+        // A running bridge would keep using ids released here.
+        if (!registry.LockStore(false))
+        {
+            std::cerr << "endpoint map is in use by a running bridge; stop it before reclaiming" << std::endl;
+            return 1;
+        }
+        const auto reclaimed = registry.ReclaimUnseen(std::chrono::hours(24) * days);
+        for (const auto & udn : reclaimed)
+        {
+            std::cout << "reclaimed udn=" << udn << std::endl;
+        }
+        std::cout << "ok: reclaim days=" << days << " count=" << reclaimed.size() << std::endl;
         return 0;
     }
 
@@ -0,0 +1,173 @@
+#include "wemo_bridge/device_snapshot.h"
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace wemo_bridge {
+
+namespace {
+
+// Line format (tab separated, name last so it may contain anything but tabs
+// and newlines):
+//   udn  dimmable  onoff  level_percent  reachable  friendly_name
+constexpr const char * kHeader = "# wemo-bridge device snapshot v1\n";
+constexpr size_t kFieldCount   = 6;
+
+std::string Sanitize(const std::string & value)
+{
+    std::string out = value;
+    for (char & c : out)
+    {
+        if (c == '\t' || c == '\n' || c == '\r')
+        {
+            c = ' ';
+        }
+    }
+    return out;
+}
+
+bool ParseLine(const std::string & line, WemoDevice & out)
+{
+    std::vector<std::string> fields;
+    size_t start = 0;
+    while (fields.size() + 1 < kFieldCount)
+    {
+        const size_t tab = line.find('\t', start);
+        if (tab == std::string::npos)
+        {
+            return false;
+        }
+        fields.push_back(line.substr(start, tab - start));
+        start = tab + 1;
+    }
+    fields.push_back(line.substr(start));
+
+    if (fields[0].empty())
+    {
+        return false;
+    }
+
+    const int level = std::atoi(fields[3].c_str());
+    if (level < 0 || level > 100)
+    {
+        return false;
+    }
+
+    out.wemo_id        = kSnapshotWemoId;
+    out.udn            = fields[0];
+    out.supports_level = (fields[1] == "1");
+    out.onoff          = static_cast<uint8_t>(fields[2] == "1" ? 1 : 0);
+    out.level_percent  = static_cast<uint8_t>(level);
+    out.is_online      = (fields[4] == "1");
+    out.friendly_name  = fields[5];
+    return true;
+}
+
+} // namespace
+
+std::vector<WemoDevice> LoadDeviceSnapshot(const std::string & path)
+{
+    std::vector<WemoDevice> devices;
+
+    std::FILE * file = std::fopen(path.c_str(), "r");
+    if (file == nullptr)
+    {
+        return devices;
+    }
+
+    std::string contents;
+    char buffer[4096];
+    size_t n;
+    while ((n = std::fread(buffer, 1, sizeof(buffer), file)) > 0)
+    {
+        contents.append(buffer, n);
+    }
+    std::fclose(file);
+
+    size_t start = 0;
+    while (start < contents.size())
+    {
+        size_t end = contents.find('\n', start);
+        if (end == std::string::npos)
+        {
+            // A line without its newline was never fully written.
+            break;
+        }
+
+        const std::string line = contents.substr(start, end - start);
+        start                  = end + 1;
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+
+        WemoDevice device;
+        if (ParseLine(line, device))
+        {
+            devices.push_back(std::move(device));
+        }
+        else
+        {
+            std::fprintf(stderr, "device_snapshot: skipping malformed line in %s\n", path.c_str());
+        }
+    }
+
+    return devices;
+}
+
+bool SaveDeviceSnapshot(const std::string & path, const std::vector<WemoDevice> & devices)
+{
+    // Saves may come from the discovery thread and from shutdown; they share
+    // the temporary file.
+    static std::mutex save_lock;
+    std::lock_guard<std::mutex> lock(save_lock);
+
+    std::filesystem::path snapshot_path(path);
+    if (snapshot_path.has_parent_path())
+    {
+        std::error_code ec;
+        std::filesystem::create_directories(snapshot_path.parent_path(), ec);
+    }
+
+    const std::string tmp_path = path + ".tmp";
+    std::FILE * file           = std::fopen(tmp_path.c_str(), "w");
+    if (file == nullptr)
+    {
+        std::fprintf(stderr, "device_snapshot: cannot write %s\n", tmp_path.c_str());
+        return false;
+    }
+
+    bool ok = std::fputs(kHeader, file) >= 0;
+    for (const auto & device : devices)
+    {
+        if (!ok)
+        {
+            break;
+        }
+        if (device.udn.empty())
+        {
+            continue;
+        }
+        ok = std::fprintf(file, "%s\t%d\t%d\t%u\t%d\t%s\n", Sanitize(device.udn).c_str(), device.supports_level ? 1 : 0,
+                          device.onoff ? 1 : 0, static_cast<unsigned>(device.level_percent), device.is_online ? 1 : 0,
+                          Sanitize(device.friendly_name).c_str()) >= 0;
+    }
+    ok = ok && std::fflush(file) == 0 && ::fsync(fileno(file)) == 0;
+    ok = (std::fclose(file) == 0) && ok;
+
+    if (!ok || std::rename(tmp_path.c_str(), path.c_str()) != 0)
+    {
+        std::fprintf(stderr, "device_snapshot: failed to save %s\n", path.c_str());
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+} // namespace wemo_bridge
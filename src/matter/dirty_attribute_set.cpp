@@ -0,0 +1,108 @@
+#include "wemo_bridge/dirty_attribute_set.h"
+
+#include <utility>
+
+namespace wemo_bridge {
+
+namespace {
+
+constexpr size_t kBitsPerWord = 64;
+
+size_t WordsFor(size_t bits)
+{
+    return (bits + kBitsPerWord - 1) / kBitsPerWord;
+}
+
+uint64_t BitFor(size_t index)
+{
+    return uint64_t { 1 } << (index % kBitsPerWord);
+}
+
+unsigned LowestSetBit(uint64_t word)
+{
+    return static_cast<unsigned>(__builtin_ctzll(word));
+}
+
+} // namespace
+
+DirtyAttributeSet::DirtyAttributeSet(size_t capacity, ScheduleFn schedule_flush) :
+    mCapacity(capacity), mSlotWords(WordsFor(capacity)), mSummaryWords(WordsFor(mSlotWords)),
+    mBits(new std::atomic<uint8_t>[mCapacity]), mDirtySlots(new std::atomic<uint64_t>[mSlotWords]),
+    mDirtySummary(new std::atomic<uint64_t>[mSummaryWords]), mScheduleFlush(std::move(schedule_flush))
+{
+    for (size_t i = 0; i < mCapacity; i++)
+    {
+        mBits[i].store(0, std::memory_order_relaxed);
+    }
+    for (size_t i = 0; i < mSlotWords; i++)
+    {
+        mDirtySlots[i].store(0, std::memory_order_relaxed);
+    }
+    for (size_t i = 0; i < mSummaryWords; i++)
+    {
+        mDirtySummary[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+void DirtyAttributeSet::Mark(size_t slot, uint8_t bits)
+{
+    if (slot >= mCapacity || bits == 0)
+    {
+        return;
+    }
+
+    // Bits before the slot bit before the summary bit, so a flush that sees
+    // a summary bit finds everything under it.
+    mBits[slot].fetch_or(bits, std::memory_order_release);
+    const size_t word = slot / kBitsPerWord;
+    mDirtySlots[word].fetch_or(BitFor(slot), std::memory_order_release);
+    mDirtySummary[word / kBitsPerWord].fetch_or(BitFor(word), std::memory_order_release);
+
+    if (!mFlushScheduled.exchange(true, std::memory_order_acq_rel))
+    {
+        mScheduleFlush();
+    }
+}
+
+void DirtyAttributeSet::Forget(size_t slot)
+{
+    if (slot < mCapacity)
+    {
+        mBits[slot].store(0, std::memory_order_relaxed);
+    }
+}
+
+size_t DirtyAttributeSet::Flush(const std::function<void(size_t, uint8_t)> & report)
+{
+    // Re-arm first, so a Mark() that lands after its bit was taken below
+    // schedules the next flush.
+    mFlushScheduled.exchange(false, std::memory_order_acq_rel);
+
+    size_t reported = 0;
+    for (size_t s = 0; s < mSummaryWords; s++)
+    {
+        uint64_t summary = mDirtySummary[s].exchange(0, std::memory_order_acq_rel);
+        while (summary != 0)
+        {
+            const size_t word = s * kBitsPerWord + LowestSetBit(summary);
+            summary &= summary - 1;
+
+            uint64_t slots = mDirtySlots[word].exchange(0, std::memory_order_acq_rel);
+            while (slots != 0)
+            {
+                const size_t slot = word * kBitsPerWord + LowestSetBit(slots);
+                slots &= slots - 1;
+
+                const uint8_t bits = mBits[slot].exchange(0, std::memory_order_acq_rel);
+                if (bits != 0) // zero after Forget()
+                {
+                    report(slot, bits);
+                    reported++;
+                }
+            }
+        }
+    }
+    return reported;
+}
+
+} // namespace wemo_bridge
@@ -1,193 +1,593 @@
 #include "wemo_bridge/endpoint_registry.h"
 
-#include <sqlite3.h>
-
-#include <filesystem>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
 #include <string>
 
 namespace wemo_bridge {
 
 namespace {
 
-constexpr uint16_t kFirstDynamicEndpointId = 2;
-constexpr const char * kCreateTablesSql    =
-    "CREATE TABLE IF NOT EXISTS endpoint_map ("
-    "  udn TEXT PRIMARY KEY,"
-    "  endpoint_id INTEGER NOT NULL UNIQUE"
-    ");"
-    "CREATE TABLE IF NOT EXISTS bridge_meta ("
-    "  key TEXT PRIMARY KEY,"
-    "  value TEXT NOT NULL"
-    ");";
+// 0xFFFF is the Matter invalid endpoint id; never hand it out.
+constexpr uint16_t kLastDynamicEndpointId = 0xFFFE;
+constexpr int64_t kSeenGranularitySecs    = 60 * 60;
+
+constexpr const char * kNextEndpointIdKey = "next_endpoint_id";
+constexpr const char * kFreeCountKey      = "free_endpoint_id_count";
+constexpr const char * kFreeSlotKeyPrefix = "free_endpoint_id.";
+constexpr const char * kLegacyFreeIdsKey  = "free_endpoint_ids";
+
+// Transient reservations are mappings under this prefix, which no UDN
+// carries ("uuid:...").
+constexpr const char * kTransientKeyPrefix = "transient:";
+
+int64_t NowSeconds()
+{
+    return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
 
-bool ExecSql(sqlite3 * db, const char * sql)
+std::optional<unsigned long> GetMetaNumber(EndpointStore & store, const std::string & key)
 {
-    char * error_msg = nullptr;
-    const int rc     = sqlite3_exec(db, sql, nullptr, nullptr, &error_msg);
-    if (error_msg != nullptr)
+    const auto value = store.GetMeta(key);
+    if (!value.has_value() || value->empty())
     {
-        sqlite3_free(error_msg);
+        return std::nullopt;
     }
-    return rc == SQLITE_OK;
+    return std::strtoul(value->c_str(), nullptr, 10);
+}
+
+// Source of EndpointRegistry::mIndexVersion values.  Unique across every
+// registry, so a per-thread snapshot cached for a destroyed registry never
+// matches a new one built at the same address.
+std::atomic<uint64_t> gNextIndexVersion{ 1 };
+
+std::string FreeSlotKey(size_t slot)
+{
+    return kFreeSlotKeyPrefix + std::to_string(slot);
 }
 
-std::optional<uint16_t> QueryEndpointId(sqlite3 * db, const std::string & udn)
+// Endpoint id allocator persisted in bridge_meta as a high-water mark
+// (next_endpoint_id) plus a LIFO stack of released ids, one meta row per
+// stack slot (free_endpoint_id.<n>, with free_endpoint_id_count on top).
+// Allocation and release touch a fixed number of rows, so their cost does
+// not depend on how many ids are free.  Ids are never handed out past
+// kLastDynamicEndpointId, so the counter can no longer wrap into fixed
+// endpoints or ids that are still mapped.
+//
+// Must be used inside a store transaction; Save() writes the high-water mark
+// and stack depth back.
+class EndpointIdAllocator
 {
-    sqlite3_stmt * stmt = nullptr;
-    const char * sql    = "SELECT endpoint_id FROM endpoint_map WHERE udn = ?1;";
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK)
+public:
+    EndpointIdAllocator(EndpointStore & store, uint16_t first_id) : mStore(store), mFirstId(first_id), mNextId(first_id) {}
+
+    bool Load()
     {
-        return std::nullopt;
+        mNextId    = mFirstId;
+        mFreeCount = 0;
+        mDirty     = false;
+
+        const auto next_id = GetMetaNumber(mStore, kNextEndpointIdKey);
+        if (next_id.has_value())
+        {
+            mNextId = static_cast<uint16_t>(std::clamp<unsigned long>(next_id.value(), mFirstId, kLastDynamicEndpointId + 1ul));
+        }
+
+        const auto free_count = GetMetaNumber(mStore, kFreeCountKey);
+        if (free_count.has_value())
+        {
+            mFreeCount = free_count.value();
+            return true;
+        }
+        return MigrateLegacyList();
     }
 
-    sqlite3_bind_text(stmt, 1, udn.c_str(), -1, SQLITE_TRANSIENT);
+    bool Save() const
+    {
+        if (!mDirty)
+        {
+            return true;
+        }
+        return mStore.PutMeta(kNextEndpointIdKey, std::to_string(mNextId)) &&
+            mStore.PutMeta(kFreeCountKey, std::to_string(mFreeCount));
+    }
 
-    std::optional<uint16_t> result = std::nullopt;
-    if (sqlite3_step(stmt) == SQLITE_ROW)
+    std::optional<uint16_t> Allocate()
     {
-        result = static_cast<uint16_t>(sqlite3_column_int(stmt, 0));
+        while (mFreeCount > 0)
+        {
+            mFreeCount--;
+            mDirty        = true;
+            const auto id = GetMetaNumber(mStore, FreeSlotKey(mFreeCount));
+            // Skip slots that were never written or hold an id the
+            // high-water mark has since dropped below.
+            if (id.has_value() && id.value() >= mFirstId && id.value() < mNextId)
+            {
+                return static_cast<uint16_t>(id.value());
+            }
+        }
+        if (mNextId > kLastDynamicEndpointId)
+        {
+            return std::nullopt;
+        }
+        mDirty = true;
+        return mNextId++;
     }
 
-    sqlite3_finalize(stmt);
-    return result;
-}
+    bool Release(uint16_t id)
+    {
+        // Shrink the high-water mark instead of growing the free list when
+        // the most recent id comes back, keeping the id space dense.
+        if (id < mFirstId)
+        {
+            return true;
+        }
+        mDirty = true;
+        if (static_cast<uint16_t>(id + 1) == mNextId)
+        {
+            mNextId = id;
+            return true;
+        }
+        if (!mStore.PutMeta(FreeSlotKey(mFreeCount), std::to_string(id)))
+        {
+            return false;
+        }
+        mFreeCount++;
+        return true;
+    }
 
-uint16_t QueryNextEndpointId(sqlite3 * db)
-{
-    sqlite3_stmt * stmt = nullptr;
-    const char * sql    = "SELECT value FROM bridge_meta WHERE key = 'next_endpoint_id';";
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK)
+private:
+    // Stores written before the per-slot layout kept the whole free list in
+    // one comma-separated free_endpoint_ids value.  Moves it to slots once.
+    bool MigrateLegacyList()
     {
-        return kFirstDynamicEndpointId;
+        const auto legacy = mStore.GetMeta(kLegacyFreeIdsKey);
+        if (!legacy.has_value() || legacy->empty())
+        {
+            return true;
+        }
+
+        const char * cursor = legacy->c_str();
+        while (*cursor != '\0')
+        {
+            char * end        = nullptr;
+            const auto parsed = std::strtoul(cursor, &end, 10);
+            if (end == cursor)
+            {
+                break;
+            }
+            if (parsed >= mFirstId && parsed < mNextId)
+            {
+                if (!mStore.PutMeta(FreeSlotKey(mFreeCount), std::to_string(parsed)))
+                {
+                    return false;
+                }
+                mFreeCount++;
+            }
+            cursor = (*end == ',') ? end + 1 : end;
+        }
+        mDirty = true;
+        return mStore.PutMeta(kLegacyFreeIdsKey, "");
     }
 
-    uint16_t next_id = kFirstDynamicEndpointId;
-    if (sqlite3_step(stmt) == SQLITE_ROW)
+    EndpointStore & mStore;
+    const uint16_t mFirstId;
+    uint16_t mNextId;
+    size_t mFreeCount = 0;
+    bool mDirty       = false;
+};
+
+} // namespace
+
+// Copy-on-write edit of an index snapshot: a shard is copied the first time
+// it is written, every other shard stays shared with the base snapshot.
+class EndpointRegistry::IndexEdit
+{
+public:
+    explicit IndexEdit(const Index & base) : mIndex(std::make_shared<Index>(base)) {}
+
+    Shard & ShardFor(const std::string & udn)
     {
-        const char * value = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0));
-        if (value != nullptr)
+        const size_t shard = Index::ShardOf(udn);
+        if (mCopies[shard] == nullptr)
         {
-            next_id = static_cast<uint16_t>(std::stoi(value));
+            mCopies[shard]        = std::make_shared<Shard>(*mIndex->shards[shard]);
+            mIndex->shards[shard] = mCopies[shard];
         }
+        return *mCopies[shard];
     }
-    sqlite3_finalize(stmt);
-    return next_id;
-}
 
-bool UpsertNextEndpointId(sqlite3 * db, uint16_t next_id)
+    bool Changed() const
+    {
+        return std::any_of(mCopies.begin(), mCopies.end(), [](const auto & copy) { return copy != nullptr; });
+    }
+
+    std::shared_ptr<Index> Take() { return std::move(mIndex); }
+
+private:
+    std::shared_ptr<Index> mIndex;
+    std::array<std::shared_ptr<Shard>, kIndexShards> mCopies;
+};
+
+EndpointRegistry::Index::Index()
 {
-    sqlite3_stmt * stmt = nullptr;
-    const char * sql    =
-        "INSERT INTO bridge_meta(key, value) VALUES('next_endpoint_id', ?1) "
-        "ON CONFLICT(key) DO UPDATE SET value = excluded.value;";
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK)
+    for (auto & shard : shards)
     {
-        return false;
+        shard = std::make_shared<const Shard>();
     }
+}
 
-    const std::string next_id_str = std::to_string(next_id);
-    sqlite3_bind_text(stmt, 1, next_id_str.c_str(), -1, SQLITE_TRANSIENT);
-    const bool ok = (sqlite3_step(stmt) == SQLITE_DONE);
-    sqlite3_finalize(stmt);
-    return ok;
+EndpointRegistry::EndpointRegistry(std::string path, uint16_t first_endpoint_id) :
+    EndpointRegistry(MakeEndpointStore(std::move(path)), first_endpoint_id)
+{}
+
+EndpointRegistry::EndpointRegistry(std::unique_ptr<EndpointStore> store, uint16_t first_endpoint_id) :
+    mStore(std::move(store)), mFirstEndpointId(first_endpoint_id), mIndex(std::make_shared<const Index>()),
+    mIndexVersion(gNextIndexVersion.fetch_add(1))
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mStore->Open())
+    {
+        LoadIndexLocked();
+    }
 }
 
-bool InsertMapping(sqlite3 * db, const std::string & udn, uint16_t endpoint_id)
+void EndpointRegistry::LoadIndexLocked()
 {
-    sqlite3_stmt * stmt = nullptr;
-    const char * sql    = "INSERT INTO endpoint_map(udn, endpoint_id) VALUES(?1, ?2);";
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK)
+    std::vector<EndpointMapping> mappings;
+    if (!mStore->LoadAll(mappings))
     {
-        return false;
+        return;
     }
 
-    sqlite3_bind_text(stmt, 1, udn.c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_int(stmt, 2, endpoint_id);
-    const bool ok = (sqlite3_step(stmt) == SQLITE_DONE);
-    sqlite3_finalize(stmt);
-    return ok;
+    IndexEdit edit{ Index() };
+    for (auto & mapping : mappings)
+    {
+        Shard & shard = edit.ShardFor(mapping.udn);
+        shard.emplace(std::move(mapping.udn), Entry{ mapping.endpoint_id, mapping.last_seen });
+    }
+    Publish(edit.Take());
 }
 
-} // namespace
+std::shared_ptr<const EndpointRegistry::Index> EndpointRegistry::Snapshot() const
+{
+    struct CachedSnapshot
+    {
+        const EndpointRegistry * registry = nullptr;
+        uint64_t version                  = 0;
+        std::shared_ptr<const Index> index;
+    };
+    thread_local CachedSnapshot cached;
+
+    // Acquire pairs with the release in Publish(): once the new version is
+    // seen, atomic_load returns that snapshot or a later one.
+    const uint64_t version = mIndexVersion.load(std::memory_order_acquire);
+    if (cached.registry != this || cached.version != version)
+    {
+        cached.index    = std::atomic_load(&mIndex);
+        cached.registry = this;
+        cached.version  = version;
+    }
+    return cached.index;
+}
 
-EndpointRegistry::EndpointRegistry(std::string path) : mPath(std::move(path)) {}
+void EndpointRegistry::Publish(std::shared_ptr<Index> index)
+{
+    std::atomic_store(&mIndex, std::shared_ptr<const Index>(std::move(index)));
+    mIndexVersion.store(gNextIndexVersion.fetch_add(1), std::memory_order_release);
+}
 
 std::optional<uint16_t> EndpointRegistry::Lookup(const std::string & udn) const
 {
-    std::filesystem::path db_path(mPath);
-    if (db_path.has_parent_path())
+    const auto index    = Snapshot();
+    const Shard & shard = index->ShardFor(udn);
+    const auto it       = shard.find(udn);
+    if (it == shard.end())
+    {
+        return std::nullopt;
+    }
+    return it->second.endpoint_id;
+}
+
+std::optional<uint16_t> EndpointRegistry::GetOrAssign(const std::string & udn)
+{
+    return GetOrAssignMany({ udn }).front();
+}
+
+std::vector<std::optional<uint16_t>> EndpointRegistry::GetOrAssignMany(const std::vector<std::string> & udns)
+{
+    std::vector<std::optional<uint16_t>> endpoint_ids(udns.size());
+
+    // Fast path: everything is already in the index, no transaction needed.
+    {
+        const auto index = Snapshot();
+        bool all_known   = true;
+        for (size_t i = 0; i < udns.size() && all_known; i++)
+        {
+            const Shard & shard = index->ShardFor(udns[i]);
+            const auto it       = shard.find(udns[i]);
+            all_known           = (it != shard.end());
+            if (all_known)
+            {
+                endpoint_ids[i] = it->second.endpoint_id;
+            }
+        }
+        if (all_known)
+        {
+            return endpoint_ids;
+        }
+    }
+
+    const int64_t now = NowSeconds();
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (!mStore->Open() || !mStore->Begin())
+    {
+        std::fill(endpoint_ids.begin(), endpoint_ids.end(), std::nullopt);
+        return endpoint_ids;
+    }
+
+    if (!AssignAllLocked(udns, endpoint_ids, now) || !mStore->Commit())
+    {
+        mStore->Rollback();
+        std::fill(endpoint_ids.begin(), endpoint_ids.end(), std::nullopt);
+        return endpoint_ids;
+    }
+
+    // Publish a new snapshot including anything assigned here or by another
+    // process sharing the database.
+    const auto base = Snapshot();
+    IndexEdit edit(*base);
+    for (size_t i = 0; i < udns.size(); i++)
+    {
+        const Shard & shard = base->ShardFor(udns[i]);
+        const auto it       = shard.find(udns[i]);
+        if (it == shard.end() || it->second.endpoint_id != endpoint_ids[i].value())
+        {
+            edit.ShardFor(udns[i])[udns[i]] = Entry{ endpoint_ids[i].value(), now };
+        }
+    }
+    if (edit.Changed())
     {
-        std::error_code ec;
-        std::filesystem::create_directories(db_path.parent_path(), ec);
+        Publish(edit.Take());
     }
 
-    sqlite3 * db = nullptr;
-    if (sqlite3_open(mPath.c_str(), &db) != SQLITE_OK)
+    return endpoint_ids;
+}
+
+bool EndpointRegistry::AssignAllLocked(const std::vector<std::string> & udns, std::vector<std::optional<uint16_t>> & out,
+                                       int64_t now)
+{
+    EndpointIdAllocator allocator(*mStore, mFirstEndpointId);
+    bool allocator_loaded = false;
+
+    for (size_t i = 0; i < udns.size(); i++)
     {
-        if (db != nullptr)
+        // Already resolved from the index on the fast path.
+        if (out[i].has_value())
+        {
+            continue;
+        }
+
+        out[i] = mStore->FindEndpointId(udns[i]);
+        if (out[i].has_value())
+        {
+            continue;
+        }
+
+        if (!allocator_loaded)
+        {
+            if (!allocator.Load())
+            {
+                return false;
+            }
+            allocator_loaded = true;
+        }
+
+        out[i] = allocator.Allocate();
+        if (!out[i].has_value())
+        {
+            std::fprintf(stderr, "endpoint_registry: endpoint id space exhausted\n");
+            return false;
+        }
+        if (!mStore->InsertMapping(udns[i], out[i].value(), now))
         {
-            sqlite3_close(db);
+            return false;
         }
+    }
+
+    return !allocator_loaded || allocator.Save();
+}
+
+std::optional<uint16_t> EndpointRegistry::ReserveTransient()
+{
+    const int64_t now = NowSeconds();
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (!mStore->Open() || !mStore->Begin())
+    {
         return std::nullopt;
     }
 
-    if (!ExecSql(db, kCreateTablesSql))
+    EndpointIdAllocator allocator(*mStore, mFirstEndpointId);
+    std::optional<uint16_t> endpoint_id;
+    std::string key;
+    if (allocator.Load())
+    {
+        endpoint_id = allocator.Allocate();
+    }
+    if (endpoint_id.has_value())
     {
-        sqlite3_close(db);
+        key = kTransientKeyPrefix + std::to_string(endpoint_id.value());
+    }
+    if (!endpoint_id.has_value() || !mStore->InsertMapping(key, endpoint_id.value(), now) || !allocator.Save() ||
+        !mStore->Commit())
+    {
+        mStore->Rollback();
         return std::nullopt;
     }
 
-    const auto endpoint_id = QueryEndpointId(db, udn);
-    sqlite3_close(db);
+    IndexEdit edit(*Snapshot());
+    edit.ShardFor(key)[key] = Entry{ endpoint_id.value(), now };
+    Publish(edit.Take());
     return endpoint_id;
 }
 
-std::optional<uint16_t> EndpointRegistry::GetOrAssign(const std::string & udn)
+bool EndpointRegistry::ReleaseTransient()
 {
-    std::filesystem::path db_path(mPath);
-    if (db_path.has_parent_path())
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::vector<std::string> transient;
+    for (const auto & shard : Snapshot()->shards)
     {
-        std::error_code ec;
-        std::filesystem::create_directories(db_path.parent_path(), ec);
+        for (const auto & entry : *shard)
+        {
+            if (entry.first.compare(0, std::char_traits<char>::length(kTransientKeyPrefix), kTransientKeyPrefix) == 0)
+            {
+                transient.push_back(entry.first);
+            }
+        }
     }
+    return transient.empty() || ReleaseAllLocked(transient);
+}
 
-    sqlite3 * db = nullptr;
-    if (sqlite3_open(mPath.c_str(), &db) != SQLITE_OK)
+bool EndpointRegistry::MarkSeen(const std::vector<std::string> & udns)
+{
+    const int64_t now = NowSeconds();
+
+    std::vector<std::string> stale;
     {
-        if (db != nullptr)
+        const auto index = Snapshot();
+        for (const auto & udn : udns)
         {
-            sqlite3_close(db);
+            const Shard & shard = index->ShardFor(udn);
+            const auto it       = shard.find(udn);
+            if (it != shard.end() && now - it->second.last_seen >= kSeenGranularitySecs)
+            {
+                stale.push_back(udn);
+            }
         }
-        return std::nullopt;
+    }
+    if (stale.empty())
+    {
+        return true;
     }
 
-    if (!ExecSql(db, kCreateTablesSql) || !ExecSql(db, "BEGIN IMMEDIATE TRANSACTION;"))
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (!mStore->Open() || !mStore->Begin())
     {
-        sqlite3_close(db);
-        return std::nullopt;
+        return false;
+    }
+    for (const auto & udn : stale)
+    {
+        if (!mStore->TouchMapping(udn, now))
+        {
+            mStore->Rollback();
+            return false;
+        }
+    }
+    if (!mStore->Commit())
+    {
+        mStore->Rollback();
+        return false;
     }
 
-    const auto existing = QueryEndpointId(db, udn);
-    if (existing.has_value())
+    IndexEdit edit(*Snapshot());
+    for (const auto & udn : stale)
     {
-        ExecSql(db, "COMMIT;");
-        sqlite3_close(db);
-        return existing;
+        Shard & shard = edit.ShardFor(udn);
+        auto it       = shard.find(udn);
+        if (it != shard.end())
+        {
+            it->second.last_seen = now;
+        }
     }
+    Publish(edit.Take());
+    return true;
+}
 
-    const uint16_t endpoint_id = QueryNextEndpointId(db);
-    const uint16_t next_id     = static_cast<uint16_t>(endpoint_id + 1);
+bool EndpointRegistry::Release(const std::string & udn)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return ReleaseAllLocked({ udn });
+}
 
-    if (!InsertMapping(db, udn, endpoint_id) || !UpsertNextEndpointId(db, next_id))
+bool EndpointRegistry::ReleaseMany(const std::vector<std::string> & udns)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return udns.empty() || ReleaseAllLocked(udns);
+}
+
+bool EndpointRegistry::LockStore(bool wait)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mStore->LockOwner(wait);
+}
+
+std::vector<std::string> EndpointRegistry::ReclaimUnseen(std::chrono::seconds max_age)
+{
+    const int64_t cutoff = NowSeconds() - max_age.count();
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (!mStore->LockOwner(false))
     {
-        ExecSql(db, "ROLLBACK;");
-        sqlite3_close(db);
-        return std::nullopt;
+        std::fprintf(stderr, "endpoint_registry: store is in use by another process (running bridge?); not reclaiming\n");
+        return {};
     }
 
-    ExecSql(db, "COMMIT;");
-    sqlite3_close(db);
-    return endpoint_id;
+    std::vector<std::string> expired;
+    for (const auto & shard : Snapshot()->shards)
+    {
+        for (const auto & entry : *shard)
+        {
+            if (entry.second.last_seen < cutoff)
+            {
+                expired.push_back(entry.first);
+            }
+        }
+    }
+
+    if (expired.empty() || !ReleaseAllLocked(expired))
+    {
+        return {};
+    }
+    return expired;
+}
+
+bool EndpointRegistry::ReleaseAllLocked(const std::vector<std::string> & udns)
+{
+    if (!mStore->Open() || !mStore->Begin())
+    {
+        return false;
+    }
+
+    EndpointIdAllocator allocator(*mStore, mFirstEndpointId);
+    bool ok = allocator.Load();
+    for (size_t i = 0; i < udns.size() && ok; i++)
+    {
+        const auto endpoint_id = mStore->FindEndpointId(udns[i]);
+        if (!endpoint_id.has_value())
+        {
+            continue;
+        }
+        ok = mStore->EraseMapping(udns[i]) && allocator.Release(endpoint_id.value());
+    }
+
+    if (!ok || !allocator.Save() || !mStore->Commit())
+    {
+        mStore->Rollback();
+        return false;
+    }
+
+    IndexEdit edit(*Snapshot());
+    for (const auto & udn : udns)
+    {
+        edit.ShardFor(udn).erase(udn);
+    }
+    Publish(edit.Take());
+    return true;
 }
 
 } // namespace wemo_bridge
@@ -0,0 +1,94 @@
+#include "wemo_bridge/endpoint_slots.h"
+
+namespace wemo_bridge {
+
+namespace {
+
+constexpr size_t kBitsPerWord = 64;
+
+size_t WordsFor(size_t bits)
+{
+    return (bits + kBitsPerWord - 1) / kBitsPerWord;
+}
+
+// Words with the low `bits` bits set and any bits past them clear.
+void FillBits(std::vector<uint64_t> & words, size_t bits)
+{
+    words.assign(WordsFor(bits), ~uint64_t { 0 });
+    if (bits % kBitsPerWord != 0)
+    {
+        words.back() = (uint64_t { 1 } << (bits % kBitsPerWord)) - 1;
+    }
+}
+
+unsigned LowestSetBit(uint64_t word)
+{
+    return static_cast<unsigned>(__builtin_ctzll(word));
+}
+
+} // namespace
+
+EndpointSlots::EndpointSlots(size_t capacity) : mCapacity(capacity < kNoSlot ? capacity : kNoSlot - 1)
+{
+    mSlotByOwner.reserve(mCapacity);
+    Clear();
+}
+
+uint16_t EndpointSlots::Acquire(const void * owner)
+{
+    if (owner == nullptr || mSlotByOwner.count(owner) != 0)
+    {
+        return kNoSlot;
+    }
+
+    for (size_t s = 0; s < mSummary.size(); s++)
+    {
+        if (mSummary[s] == 0)
+        {
+            continue;
+        }
+        const size_t word = s * kBitsPerWord + LowestSetBit(mSummary[s]);
+        const size_t bit  = LowestSetBit(mFree[word]);
+        mFree[word] &= ~(uint64_t { 1 } << bit);
+        if (mFree[word] == 0)
+        {
+            mSummary[s] &= ~(uint64_t { 1 } << (word % kBitsPerWord));
+        }
+
+        const auto slot = static_cast<uint16_t>(word * kBitsPerWord + bit);
+        mSlotByOwner.emplace(owner, slot);
+        return slot;
+    }
+    return kNoSlot;
+}
+
+uint16_t EndpointSlots::Release(const void * owner)
+{
+    const auto it = mSlotByOwner.find(owner);
+    if (it == mSlotByOwner.end())
+    {
+        return kNoSlot;
+    }
+
+    const uint16_t slot = it->second;
+    mSlotByOwner.erase(it);
+    const size_t word = slot / kBitsPerWord;
+    mFree[word] |= uint64_t { 1 } << (slot % kBitsPerWord);
+    mSummary[word / kBitsPerWord] |= uint64_t { 1 } << (word % kBitsPerWord);
+    return slot;
+}
+
+uint16_t EndpointSlots::SlotOf(const void * owner) const
+{
+    const auto it = mSlotByOwner.find(owner);
+    return (it != mSlotByOwner.end()) ? it->second : kNoSlot;
+}
+
+void EndpointSlots::Clear()
+{
+    FillBits(mFree, mCapacity);
+    FillBits(mSummary, mFree.size());
+    mSlotByOwner.clear();
+}
+
+} // namespace wemo_bridge
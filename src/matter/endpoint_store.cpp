@@ -0,0 +1,20 @@
+#include "wemo_bridge/endpoint_store.h"
+
+#include "wemo_bridge/endpoint_store_log.h"
+#include "wemo_bridge/endpoint_store_sqlite.h"
+
+namespace wemo_bridge {
+
+std::unique_ptr<EndpointStore> MakeEndpointStore(std::string path)
+{
+    constexpr const char kLogSuffix[] = ".log";
+    constexpr size_t kLogSuffixLen    = sizeof(kLogSuffix) - 1;
+
+    if (path.size() > kLogSuffixLen && path.compare(path.size() - kLogSuffixLen, kLogSuffixLen, kLogSuffix) == 0)
+    {
+        return std::make_unique<EndpointStoreLog>(std::move(path));
+    }
+    return std::make_unique<EndpointStoreSqlite>(std::move(path));
+}
+
+} // namespace wemo_bridge
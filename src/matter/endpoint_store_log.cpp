@@ -0,0 +1,818 @@
+#include "wemo_bridge/endpoint_store_log.h"
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+namespace wemo_bridge {
+
+namespace {
+
+// File layout:
+//   header: 8-byte magic
+//   frames: [u32 magic][u32 payload_len][u32 crc32(payload)][payload]
+//   payload: records of [u8 type][u16 key_len][key][u16 value_len][value]
+// All integers are little-endian.  Space past the last frame is zero-filled.
+constexpr uint8_t kFileMagic[8]      = { 'W', 'E', 'P', 'L', 'O', 'G', '0', '1' };
+constexpr size_t kFileHeaderSize     = sizeof(kFileMagic);
+constexpr uint32_t kFrameMagic       = 0x31524657; // "WFR1"
+constexpr size_t kFrameHeaderSize    = 12;
+constexpr size_t kInitialCapacity    = 64 * 1024;
+constexpr size_t kCompactMinBytes    = 256 * 1024;
+constexpr size_t kCompactGrowthRatio = 4;
+
+enum RecordType : uint8_t
+{
+    kRecordMapping      = 1, // value: u16 endpoint_id, i64 last_seen
+    kRecordMeta         = 2, // value: raw bytes
+    kRecordEraseMapping = 3, // value: empty
+};
+
+constexpr size_t kMappingValueSize = 10;
+
+const std::array<uint32_t, 256> & Crc32Table()
+{
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> t {};
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++)
+            {
+                c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+            }
+            t[i] = c;
+        }
+        return t;
+    }();
+    return table;
+}
+
+uint32_t Crc32(const uint8_t * data, size_t len)
+{
+    const auto & table = Crc32Table();
+    uint32_t crc       = 0xFFFFFFFFu;
+    for (size_t i = 0; i < len; i++)
+    {
+        crc = table[(crc ^ data[i]) & 0xFFu] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+void PutU16(std::vector<uint8_t> & out, uint16_t v)
+{
+    out.push_back(static_cast<uint8_t>(v & 0xFF));
+    out.push_back(static_cast<uint8_t>(v >> 8));
+}
+
+void StoreU64(uint8_t * p, uint64_t v)
+{
+    for (int i = 0; i < 8; i++)
+    {
+        p[i] = static_cast<uint8_t>((v >> (8 * i)) & 0xFF);
+    }
+}
+
+void StoreU32(uint8_t * p, uint32_t v)
+{
+    p[0] = static_cast<uint8_t>(v & 0xFF);
+    p[1] = static_cast<uint8_t>((v >> 8) & 0xFF);
+    p[2] = static_cast<uint8_t>((v >> 16) & 0xFF);
+    p[3] = static_cast<uint8_t>(v >> 24);
+}
+
+uint16_t LoadU16(const uint8_t * p)
+{
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+uint32_t LoadU32(const uint8_t * p)
+{
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) | (static_cast<uint32_t>(p[2]) << 16) |
+        (static_cast<uint32_t>(p[3]) << 24);
+}
+
+uint64_t LoadU64(const uint8_t * p)
+{
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--)
+    {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+size_t RecordSize(size_t key_len, size_t value_len)
+{
+    return 1 + 2 + key_len + 2 + value_len;
+}
+
+bool EncodeRecord(std::vector<uint8_t> & out, RecordType type, const std::string & key, const uint8_t * value, size_t value_len)
+{
+    if (key.size() > UINT16_MAX || value_len > UINT16_MAX)
+    {
+        return false;
+    }
+    out.push_back(type);
+    PutU16(out, static_cast<uint16_t>(key.size()));
+    out.insert(out.end(), key.begin(), key.end());
+    PutU16(out, static_cast<uint16_t>(value_len));
+    out.insert(out.end(), value, value + value_len);
+    return true;
+}
+
+bool EncodeMapping(std::vector<uint8_t> & out, const std::string & udn, uint16_t endpoint_id, int64_t last_seen)
+{
+    uint8_t value[kMappingValueSize];
+    value[0] = static_cast<uint8_t>(endpoint_id & 0xFF);
+    value[1] = static_cast<uint8_t>(endpoint_id >> 8);
+    StoreU64(value + 2, static_cast<uint64_t>(last_seen));
+    return EncodeRecord(out, kRecordMapping, udn, value, sizeof(value));
+}
+
+bool EncodeEraseMapping(std::vector<uint8_t> & out, const std::string & udn)
+{
+    return EncodeRecord(out, kRecordEraseMapping, udn, nullptr, 0);
+}
+
+bool EncodeMeta(std::vector<uint8_t> & out, const std::string & key, const std::string & value)
+{
+    return EncodeRecord(out, kRecordMeta, key, reinterpret_cast<const uint8_t *>(value.data()), value.size());
+}
+
+size_t PageFloor(size_t offset)
+{
+    static const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return offset - (offset % page);
+}
+
+// Maps `size` bytes of fd, or returns nullptr.
+uint8_t * MapFile(int fd, size_t size)
+{
+    void * map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        std::fprintf(stderr, "endpoint_store_log: mmap failed: %s\n", std::strerror(errno));
+        return nullptr;
+    }
+    return static_cast<uint8_t *>(map);
+}
+
+void SyncDirectoryOf(const std::string & path)
+{
+    std::filesystem::path parent = std::filesystem::path(path).parent_path();
+    if (parent.empty())
+    {
+        parent = ".";
+    }
+    const int dir_fd = open(parent.c_str(), O_RDONLY | O_CLOEXEC);
+    if (dir_fd >= 0)
+    {
+        fsync(dir_fd);
+        close(dir_fd);
+    }
+}
+
+} // namespace
+
+EndpointStoreLog::EndpointStoreLog(std::string path) : mPath(std::move(path)) {}
+
+EndpointStoreLog::~EndpointStoreLog()
+{
+    StopCompaction();
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    UnmapLocked();
+}
+
+void EndpointStoreLog::StopCompaction()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mCompactCv.notify_all();
+    if (mCompactThread.joinable())
+    {
+        mCompactThread.join();
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mStopping         = false;
+    mCompactRequested = false;
+}
+
+bool EndpointStoreLog::LockOwner(bool wait)
+{
+    // The exclusive file lock taken by Open() doubles as the owner lock.
+    // It never waits: a process that is locked out cannot use the log at
+    // all, and waiting would only hide that.
+    (void) wait;
+    return Open();
+}
+
+bool EndpointStoreLog::Open()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (mFd >= 0)
+        {
+            return true;
+        }
+    }
+    // A previous Open() that lost its file leaves its compaction thread
+    // behind; it must be gone before a new one starts.
+    StopCompaction();
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mFd >= 0)
+    {
+        return true;
+    }
+
+    std::filesystem::path log_path(mPath);
+    if (log_path.has_parent_path())
+    {
+        std::error_code ec;
+        std::filesystem::create_directories(log_path.parent_path(), ec);
+    }
+
+    const int fd = open(mPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        std::fprintf(stderr, "endpoint_store_log: cannot open %s: %s\n", mPath.c_str(), std::strerror(errno));
+        return false;
+    }
+    if (flock(fd, LOCK_EX | LOCK_NB) != 0)
+    {
+        std::fprintf(stderr, "endpoint_store_log: %s is in use by another process\n", mPath.c_str());
+        close(fd);
+        return false;
+    }
+
+    struct stat st {};
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    const bool fresh = (st.st_size == 0);
+    if (fresh && (ftruncate(fd, static_cast<off_t>(kInitialCapacity)) != 0 || fsync(fd) != 0))
+    {
+        close(fd);
+        return false;
+    }
+
+    if (!MapFileLocked(fd))
+    {
+        close(fd);
+        return false;
+    }
+
+    if (fresh)
+    {
+        std::memcpy(mMap, kFileMagic, kFileHeaderSize);
+        msync(mMap, kFileHeaderSize, MS_SYNC);
+    }
+    else if (mCapacity < kFileHeaderSize || std::memcmp(mMap, kFileMagic, kFileHeaderSize) != 0)
+    {
+        std::fprintf(stderr, "endpoint_store_log: %s is not an endpoint log\n", mPath.c_str());
+        UnmapLocked();
+        return false;
+    }
+
+    ReplayLocked();
+    mCompactThread = std::thread(&EndpointStoreLog::CompactionLoop, this);
+    return true;
+}
+
+bool EndpointStoreLog::MapFileLocked(int fd)
+{
+    struct stat st {};
+    if (fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+        return false;
+    }
+
+    uint8_t * map = MapFile(fd, static_cast<size_t>(st.st_size));
+    if (map == nullptr)
+    {
+        return false;
+    }
+
+    mFd       = fd;
+    mMap      = map;
+    mCapacity = static_cast<size_t>(st.st_size);
+    return true;
+}
+
+void EndpointStoreLog::UnmapLocked()
+{
+    if (mMap != nullptr)
+    {
+        munmap(mMap, mCapacity);
+        mMap = nullptr;
+    }
+    if (mFd >= 0)
+    {
+        close(mFd);
+        mFd = -1;
+    }
+    mCapacity = 0;
+}
+
+void EndpointStoreLog::ReplayLocked()
+{
+    mState = State {};
+    size_t offset = kFileHeaderSize;
+
+    while (mCapacity - offset >= kFrameHeaderSize)
+    {
+        const uint8_t * frame = mMap + offset;
+        if (LoadU32(frame) != kFrameMagic)
+        {
+            break;
+        }
+        const size_t payload_len = LoadU32(frame + 4);
+        if (payload_len > mCapacity - offset - kFrameHeaderSize)
+        {
+            break;
+        }
+        const uint8_t * payload = frame + kFrameHeaderSize;
+        if (Crc32(payload, payload_len) != LoadU32(frame + 8))
+        {
+            break;
+        }
+
+        // Decode into a scratch delta first so a malformed frame is applied
+        // all-or-nothing.
+        State delta;
+        size_t pos     = 0;
+        bool malformed = false;
+        while (pos < payload_len && !malformed)
+        {
+            if (payload_len - pos < 3)
+            {
+                malformed = true;
+                break;
+            }
+            const uint8_t type    = payload[pos];
+            const size_t key_len  = LoadU16(payload + pos + 1);
+            pos += 3;
+            if (payload_len - pos < key_len + 2)
+            {
+                malformed = true;
+                break;
+            }
+            std::string key(reinterpret_cast<const char *>(payload + pos), key_len);
+            pos += key_len;
+            const size_t value_len = LoadU16(payload + pos);
+            pos += 2;
+            if (payload_len - pos < value_len)
+            {
+                malformed = true;
+                break;
+            }
+
+            if (type == kRecordMapping && value_len == kMappingValueSize)
+            {
+                delta.mappings[std::move(key)] = { LoadU16(payload + pos), static_cast<int64_t>(LoadU64(payload + pos + 2)), false };
+            }
+            else if (type == kRecordEraseMapping && value_len == 0)
+            {
+                delta.mappings[std::move(key)] = { 0, 0, true };
+            }
+            else if (type == kRecordMeta)
+            {
+                delta.meta[std::move(key)] = std::string(reinterpret_cast<const char *>(payload + pos), value_len);
+            }
+            else
+            {
+                malformed = true;
+            }
+            pos += value_len;
+        }
+        if (malformed)
+        {
+            break;
+        }
+
+        for (auto & entry : delta.mappings)
+        {
+            if (entry.second.erased)
+            {
+                mState.mappings.erase(entry.first);
+            }
+            else
+            {
+                mState.mappings[entry.first] = entry.second;
+            }
+        }
+        for (auto & entry : delta.meta)
+        {
+            mState.meta[entry.first] = std::move(entry.second);
+        }
+        offset += kFrameHeaderSize + payload_len;
+    }
+    mEnd = offset;
+
+    // Drop whatever a crash left behind the last good frame so it can never
+    // be mistaken for a frame once new data is appended in front of it.
+    const uint8_t * tail = mMap + mEnd;
+    if (std::any_of(tail, tail + (mCapacity - mEnd), [](uint8_t b) { return b != 0; }))
+    {
+        std::fprintf(stderr, "endpoint_store_log: discarding torn data after offset %zu in %s\n", mEnd, mPath.c_str());
+        std::memset(mMap + mEnd, 0, mCapacity - mEnd);
+        msync(mMap + PageFloor(mEnd), mCapacity - PageFloor(mEnd), MS_SYNC);
+    }
+
+    mLiveBytes = 0;
+    for (const auto & entry : mState.mappings)
+    {
+        mLiveBytes += RecordSize(entry.first.size(), kMappingValueSize);
+    }
+    for (const auto & entry : mState.meta)
+    {
+        mLiveBytes += RecordSize(entry.first.size(), entry.second.size());
+    }
+}
+
+bool EndpointStoreLog::EnsureCapacityLocked(size_t bytes)
+{
+    if (bytes <= mCapacity)
+    {
+        return true;
+    }
+
+    size_t capacity = std::max(mCapacity, kInitialCapacity);
+    while (capacity < bytes)
+    {
+        capacity *= 2;
+    }
+
+    // Growing the file leaves the current mapping valid, so the store keeps
+    // working at its old capacity if the larger mapping cannot be made.
+    if (ftruncate(mFd, static_cast<off_t>(capacity)) != 0 || fsync(mFd) != 0)
+    {
+        std::fprintf(stderr, "endpoint_store_log: cannot grow %s: %s\n", mPath.c_str(), std::strerror(errno));
+        return false;
+    }
+    uint8_t * map = MapFile(mFd, capacity);
+    if (map == nullptr)
+    {
+        return false;
+    }
+
+    munmap(mMap, mCapacity);
+    mMap      = map;
+    mCapacity = capacity;
+    return true;
+}
+
+bool EndpointStoreLog::AppendFrameLocked(const std::vector<uint8_t> & payload)
+{
+    if (mMap == nullptr || !EnsureCapacityLocked(mEnd + kFrameHeaderSize + payload.size()))
+    {
+        return false;
+    }
+
+    uint8_t * frame = mMap + mEnd;
+    StoreU32(frame, kFrameMagic);
+    StoreU32(frame + 4, static_cast<uint32_t>(payload.size()));
+    StoreU32(frame + 8, Crc32(payload.data(), payload.size()));
+    std::memcpy(frame + kFrameHeaderSize, payload.data(), payload.size());
+
+    const size_t frame_end  = mEnd + kFrameHeaderSize + payload.size();
+    const size_t sync_start = PageFloor(mEnd);
+    if (msync(mMap + sync_start, frame_end - sync_start, MS_SYNC) != 0)
+    {
+        std::memset(frame, 0, frame_end - mEnd);
+        return false;
+    }
+
+    mEnd = frame_end;
+    return true;
+}
+
+bool EndpointStoreLog::LoadAll(std::vector<EndpointMapping> & out)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mMap == nullptr)
+    {
+        return false;
+    }
+
+    out.reserve(out.size() + mState.mappings.size());
+    for (const auto & entry : mState.mappings)
+    {
+        out.push_back({ entry.first, entry.second.endpoint_id, entry.second.last_seen });
+    }
+    return true;
+}
+
+bool EndpointStoreLog::Begin()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mMap == nullptr || mInTransaction)
+    {
+        return false;
+    }
+
+    mInTransaction = true;
+    mPending       = State {};
+    mPendingRecords.clear();
+    return true;
+}
+
+bool EndpointStoreLog::Commit()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (!mInTransaction)
+    {
+        return false;
+    }
+
+    if (!mPendingRecords.empty() && !AppendFrameLocked(mPendingRecords))
+    {
+        return false;
+    }
+
+    for (auto & entry : mPending.mappings)
+    {
+        auto it = mState.mappings.find(entry.first);
+        if (entry.second.erased)
+        {
+            if (it != mState.mappings.end())
+            {
+                mLiveBytes -= RecordSize(entry.first.size(), kMappingValueSize);
+                mState.mappings.erase(it);
+            }
+            continue;
+        }
+        if (it == mState.mappings.end())
+        {
+            mLiveBytes += RecordSize(entry.first.size(), kMappingValueSize);
+        }
+        mState.mappings[entry.first] = entry.second;
+    }
+    for (auto & entry : mPending.meta)
+    {
+        auto it = mState.meta.find(entry.first);
+        if (it != mState.meta.end())
+        {
+            mLiveBytes -= RecordSize(entry.first.size(), it->second.size());
+        }
+        mLiveBytes += RecordSize(entry.first.size(), entry.second.size());
+        mState.meta[entry.first] = std::move(entry.second);
+    }
+
+    mInTransaction = false;
+    mPending       = State {};
+    mPendingRecords.clear();
+
+    if (mEnd > kCompactMinBytes && mEnd > kCompactGrowthRatio * (kFileHeaderSize + kFrameHeaderSize + mLiveBytes))
+    {
+        mCompactRequested = true;
+        mCompactCv.notify_one();
+    }
+    return true;
+}
+
+void EndpointStoreLog::Rollback()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mInTransaction = false;
+    mPending       = State {};
+    mPendingRecords.clear();
+}
+
+const EndpointStoreLog::MappingEntry * EndpointStoreLog::FindMappingLocked(const std::string & udn) const
+{
+    auto pending = mPending.mappings.find(udn);
+    if (pending != mPending.mappings.end())
+    {
+        return pending->second.erased ? nullptr : &pending->second;
+    }
+    auto it = mState.mappings.find(udn);
+    return (it != mState.mappings.end()) ? &it->second : nullptr;
+}
+
+bool EndpointStoreLog::PutMappingLocked(const std::string & udn, const MappingEntry & entry)
+{
+    const bool encoded = entry.erased ? EncodeEraseMapping(mPendingRecords, udn)
+                                      : EncodeMapping(mPendingRecords, udn, entry.endpoint_id, entry.last_seen);
+    if (!encoded)
+    {
+        return false;
+    }
+    mPending.mappings[udn] = entry;
+    return true;
+}
+
+std::optional<uint16_t> EndpointStoreLog::FindEndpointId(const std::string & udn)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    const MappingEntry * entry = FindMappingLocked(udn);
+    if (entry == nullptr)
+    {
+        return std::nullopt;
+    }
+    return entry->endpoint_id;
+}
+
+bool EndpointStoreLog::InsertMapping(const std::string & udn, uint16_t endpoint_id, int64_t last_seen)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (!mInTransaction || FindMappingLocked(udn) != nullptr)
+    {
+        return false;
+    }
+    return PutMappingLocked(udn, { endpoint_id, last_seen, false });
+}
+
+bool EndpointStoreLog::TouchMapping(const std::string & udn, int64_t last_seen)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (!mInTransaction)
+    {
+        return false;
+    }
+    const MappingEntry * entry = FindMappingLocked(udn);
+    if (entry == nullptr)
+    {
+        return true;
+    }
+    return PutMappingLocked(udn, { entry->endpoint_id, last_seen, false });
+}
+
+bool EndpointStoreLog::EraseMapping(const std::string & udn)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (!mInTransaction)
+    {
+        return false;
+    }
+    if (FindMappingLocked(udn) == nullptr)
+    {
+        return true;
+    }
+    return PutMappingLocked(udn, { 0, 0, true });
+}
+
+std::optional<std::string> EndpointStoreLog::GetMeta(const std::string & key)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto pending = mPending.meta.find(key);
+    if (pending != mPending.meta.end())
+    {
+        return pending->second;
+    }
+    auto it = mState.meta.find(key);
+    if (it != mState.meta.end())
+    {
+        return it->second;
+    }
+    return std::nullopt;
+}
+
+bool EndpointStoreLog::PutMeta(const std::string & key, const std::string & value)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (!mInTransaction || !EncodeMeta(mPendingRecords, key, value))
+    {
+        return false;
+    }
+    mPending.meta[key] = value;
+    return true;
+}
+
+void EndpointStoreLog::CompactionLoop()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (true)
+    {
+        mCompactCv.wait(lock, [this] { return mStopping || mCompactRequested; });
+        if (mStopping)
+        {
+            return;
+        }
+        mCompactRequested = false;
+
+        lock.unlock();
+        if (!CompactOnce())
+        {
+            std::fprintf(stderr, "endpoint_store_log: compaction of %s failed\n", mPath.c_str());
+        }
+        lock.lock();
+    }
+}
+
+bool EndpointStoreLog::CompactOnce()
+{
+    // Phase 1: snapshot live state and the current end of log.
+    State snapshot;
+    size_t snapshot_end   = 0;
+    size_t snapshot_bytes = 0;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (mMap == nullptr)
+        {
+            return false;
+        }
+        snapshot       = mState;
+        snapshot_end   = mEnd;
+        snapshot_bytes = mLiveBytes;
+    }
+
+    // Phase 2 (unlocked): write the snapshot as a single frame to a side file.
+    std::vector<uint8_t> payload;
+    payload.reserve(snapshot_bytes);
+    for (const auto & entry : snapshot.mappings)
+    {
+        EncodeMapping(payload, entry.first, entry.second.endpoint_id, entry.second.last_seen);
+    }
+    for (const auto & entry : snapshot.meta)
+    {
+        EncodeMeta(payload, entry.first, entry.second);
+    }
+
+    std::vector<uint8_t> image(kFileHeaderSize + kFrameHeaderSize);
+    std::memcpy(image.data(), kFileMagic, kFileHeaderSize);
+    StoreU32(image.data() + kFileHeaderSize, kFrameMagic);
+    StoreU32(image.data() + kFileHeaderSize + 4, static_cast<uint32_t>(payload.size()));
+    StoreU32(image.data() + kFileHeaderSize + 8, Crc32(payload.data(), payload.size()));
+    image.insert(image.end(), payload.begin(), payload.end());
+
+    const std::string tmp_path = mPath + ".compact";
+    const int fd               = open(tmp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        return false;
+    }
+    if (flock(fd, LOCK_EX | LOCK_NB) != 0 || pwrite(fd, image.data(), image.size(), 0) != static_cast<ssize_t>(image.size()))
+    {
+        close(fd);
+        unlink(tmp_path.c_str());
+        return false;
+    }
+
+    // Phase 3 (locked): carry over frames committed since the snapshot, make
+    // the side file durable, and swap it in.
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mMap == nullptr || mEnd < snapshot_end)
+    {
+        close(fd);
+        unlink(tmp_path.c_str());
+        return false;
+    }
+
+    const size_t tail_len = mEnd - snapshot_end;
+    const size_t new_end  = image.size() + tail_len;
+    size_t capacity       = kInitialCapacity;
+    while (capacity < new_end * 2)
+    {
+        capacity *= 2;
+    }
+
+    const bool written = (tail_len == 0 ||
+                          pwrite(fd, mMap + snapshot_end, tail_len, static_cast<off_t>(image.size())) ==
+                              static_cast<ssize_t>(tail_len)) &&
+        ftruncate(fd, static_cast<off_t>(capacity)) == 0 && fsync(fd) == 0;
+
+    // Map the side file before it replaces the log, so any failure up to the
+    // swap leaves the old file and mapping in use.
+    uint8_t * map = written ? MapFile(fd, capacity) : nullptr;
+    if (map == nullptr || rename(tmp_path.c_str(), mPath.c_str()) != 0)
+    {
+        if (map != nullptr)
+        {
+            munmap(map, capacity);
+        }
+        close(fd);
+        unlink(tmp_path.c_str());
+        return false;
+    }
+    SyncDirectoryOf(mPath);
+
+    const size_t old_end = mEnd;
+    UnmapLocked();
+    mFd       = fd;
+    mMap      = map;
+    mCapacity = capacity;
+    mEnd      = new_end;
+
+    std::fprintf(stderr, "endpoint_store_log: compacted %s from %zu to %zu bytes\n", mPath.c_str(), old_end, new_end);
+    return true;
+}
+
+} // namespace wemo_bridge
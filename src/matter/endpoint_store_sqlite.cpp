@@ -0,0 +1,315 @@
+#include "wemo_bridge/endpoint_store_sqlite.h"
+
+#include <fcntl.h>
+#include <sqlite3.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+
+namespace wemo_bridge {
+
+namespace {
+
+// Wait this long for a competing writer (CLI vs. bridge) before giving up.
+constexpr int kBusyTimeoutMs = 5000;
+
+constexpr const char * kConnectionSetupSql =
+    "PRAGMA journal_mode=WAL;"
+    "PRAGMA synchronous=NORMAL;";
+constexpr const char * kCreateTablesSql =
+    "CREATE TABLE IF NOT EXISTS endpoint_map ("
+    "  udn TEXT PRIMARY KEY,"
+    "  endpoint_id INTEGER NOT NULL UNIQUE,"
+    "  last_seen INTEGER NOT NULL DEFAULT 0"
+    ");"
+    "CREATE TABLE IF NOT EXISTS bridge_meta ("
+    "  key TEXT PRIMARY KEY,"
+    "  value TEXT NOT NULL"
+    ");";
+// Databases created before last_seen existed get the column added, with
+// existing rows treated as seen at migration time.
+constexpr const char * kMigrateLastSeenSql =
+    "ALTER TABLE endpoint_map ADD COLUMN last_seen INTEGER NOT NULL DEFAULT 0;"
+    "UPDATE endpoint_map SET last_seen = CAST(strftime('%s', 'now') AS INTEGER);";
+constexpr const char * kSelectAllSql      = "SELECT udn, endpoint_id, last_seen FROM endpoint_map;";
+constexpr const char * kSelectEndpointSql = "SELECT endpoint_id FROM endpoint_map WHERE udn = ?1;";
+constexpr const char * kInsertMappingSql  = "INSERT INTO endpoint_map(udn, endpoint_id, last_seen) VALUES(?1, ?2, ?3);";
+constexpr const char * kTouchMappingSql   = "UPDATE endpoint_map SET last_seen = ?2 WHERE udn = ?1;";
+constexpr const char * kDeleteMappingSql  = "DELETE FROM endpoint_map WHERE udn = ?1;";
+constexpr const char * kSelectMetaSql     = "SELECT value FROM bridge_meta WHERE key = ?1;";
+constexpr const char * kUpsertMetaSql     =
+    "INSERT INTO bridge_meta(key, value) VALUES(?1, ?2) "
+    "ON CONFLICT(key) DO UPDATE SET value = excluded.value;";
+
+bool ExecSql(sqlite3 * db, const char * sql)
+{
+    char * error_msg = nullptr;
+    const int rc     = sqlite3_exec(db, sql, nullptr, nullptr, &error_msg);
+    if (error_msg != nullptr)
+    {
+        std::fprintf(stderr, "endpoint_store: %s\n", error_msg);
+        sqlite3_free(error_msg);
+    }
+    return rc == SQLITE_OK;
+}
+
+bool Prepare(sqlite3 * db, const char * sql, sqlite3_stmt ** stmt)
+{
+    if (sqlite3_prepare_v3(db, sql, -1, SQLITE_PREPARE_PERSISTENT, stmt, nullptr) != SQLITE_OK)
+    {
+        std::fprintf(stderr, "endpoint_store: prepare failed: %s\n", sqlite3_errmsg(db));
+        return false;
+    }
+    return true;
+}
+
+// Returns a cached statement to its initial state when leaving scope so the
+// next caller can bind fresh parameters.
+class StatementScope
+{
+public:
+    explicit StatementScope(sqlite3_stmt * stmt) : mStmt(stmt) {}
+    ~StatementScope()
+    {
+        sqlite3_reset(mStmt);
+        sqlite3_clear_bindings(mStmt);
+    }
+
+    StatementScope(const StatementScope &)             = delete;
+    StatementScope & operator=(const StatementScope &) = delete;
+
+private:
+    sqlite3_stmt * mStmt;
+};
+
+void BindText(sqlite3_stmt * stmt, int index, const std::string & value)
+{
+    sqlite3_bind_text(stmt, index, value.c_str(), static_cast<int>(value.size()), SQLITE_STATIC);
+}
+
+} // namespace
+
+EndpointStoreSqlite::EndpointStoreSqlite(std::string path) : mPath(std::move(path)) {}
+
+EndpointStoreSqlite::~EndpointStoreSqlite()
+{
+    Close();
+    if (mOwnerFd >= 0)
+    {
+        close(mOwnerFd);
+    }
+}
+
+bool EndpointStoreSqlite::Open()
+{
+    if (mDb != nullptr)
+    {
+        return true;
+    }
+
+    std::filesystem::path db_path(mPath);
+    if (db_path.has_parent_path())
+    {
+        std::error_code ec;
+        std::filesystem::create_directories(db_path.parent_path(), ec);
+    }
+
+    if (sqlite3_open(mPath.c_str(), &mDb) != SQLITE_OK)
+    {
+        std::fprintf(stderr, "endpoint_store: cannot open %s\n", mPath.c_str());
+        Close();
+        return false;
+    }
+
+    sqlite3_busy_timeout(mDb, kBusyTimeoutMs);
+
+    if (!ExecSql(mDb, kConnectionSetupSql) || !ExecSql(mDb, kCreateTablesSql) || !MigrateSchema() ||
+        !Prepare(mDb, kSelectEndpointSql, &mSelectStmt) || !Prepare(mDb, kInsertMappingSql, &mInsertStmt) ||
+        !Prepare(mDb, kTouchMappingSql, &mTouchStmt) || !Prepare(mDb, kDeleteMappingSql, &mDeleteStmt) ||
+        !Prepare(mDb, kSelectMetaSql, &mSelectMetaStmt) || !Prepare(mDb, kUpsertMetaSql, &mUpsertMetaStmt))
+    {
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+bool EndpointStoreSqlite::LockOwner(bool wait)
+{
+    if (mOwnerFd >= 0)
+    {
+        return true;
+    }
+
+    const std::string owner_path = mPath + "-owner";
+    std::filesystem::path db_path(mPath);
+    if (db_path.has_parent_path())
+    {
+        std::error_code ec;
+        std::filesystem::create_directories(db_path.parent_path(), ec);
+    }
+
+    const int fd = open(owner_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        std::fprintf(stderr, "endpoint_store: cannot open %s\n", owner_path.c_str());
+        return false;
+    }
+    int rc;
+    do
+    {
+        rc = flock(fd, LOCK_EX | (wait ? 0 : LOCK_NB));
+    } while (rc != 0 && errno == EINTR);
+    if (rc != 0)
+    {
+        close(fd);
+        return false;
+    }
+    mOwnerFd = fd;
+    return true;
+}
+
+bool EndpointStoreSqlite::MigrateSchema()
+{
+    sqlite3_stmt * stmt = nullptr;
+    if (sqlite3_prepare_v2(mDb, "SELECT 1 FROM pragma_table_info('endpoint_map') WHERE name = 'last_seen';", -1, &stmt, nullptr) !=
+        SQLITE_OK)
+    {
+        return false;
+    }
+    const bool has_last_seen = (sqlite3_step(stmt) == SQLITE_ROW);
+    sqlite3_finalize(stmt);
+
+    if (has_last_seen)
+    {
+        return true;
+    }
+
+    if (!ExecSql(mDb, "BEGIN IMMEDIATE TRANSACTION;"))
+    {
+        return false;
+    }
+    if (!ExecSql(mDb, kMigrateLastSeenSql) || !ExecSql(mDb, "COMMIT;"))
+    {
+        ExecSql(mDb, "ROLLBACK;");
+        return false;
+    }
+    return true;
+}
+
+void EndpointStoreSqlite::Close()
+{
+    for (sqlite3_stmt ** stmt : { &mSelectStmt, &mInsertStmt, &mTouchStmt, &mDeleteStmt, &mSelectMetaStmt, &mUpsertMetaStmt })
+    {
+        sqlite3_finalize(*stmt);
+        *stmt = nullptr;
+    }
+
+    if (mDb != nullptr)
+    {
+        sqlite3_close(mDb);
+        mDb = nullptr;
+    }
+}
+
+bool EndpointStoreSqlite::LoadAll(std::vector<EndpointMapping> & out)
+{
+    sqlite3_stmt * stmt = nullptr;
+    if (mDb == nullptr || sqlite3_prepare_v2(mDb, kSelectAllSql, -1, &stmt, nullptr) != SQLITE_OK)
+    {
+        return false;
+    }
+
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        const char * udn = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0));
+        if (udn != nullptr)
+        {
+            out.push_back({ udn, static_cast<uint16_t>(sqlite3_column_int(stmt, 1)), sqlite3_column_int64(stmt, 2) });
+        }
+    }
+    sqlite3_finalize(stmt);
+    return true;
+}
+
+bool EndpointStoreSqlite::Begin()
+{
+    return ExecSql(mDb, "BEGIN IMMEDIATE TRANSACTION;");
+}
+
+bool EndpointStoreSqlite::Commit()
+{
+    return ExecSql(mDb, "COMMIT;");
+}
+
+void EndpointStoreSqlite::Rollback()
+{
+    ExecSql(mDb, "ROLLBACK;");
+}
+
+std::optional<uint16_t> EndpointStoreSqlite::FindEndpointId(const std::string & udn)
+{
+    StatementScope scope(mSelectStmt);
+    BindText(mSelectStmt, 1, udn);
+
+    if (sqlite3_step(mSelectStmt) == SQLITE_ROW)
+    {
+        return static_cast<uint16_t>(sqlite3_column_int(mSelectStmt, 0));
+    }
+    return std::nullopt;
+}
+
+bool EndpointStoreSqlite::InsertMapping(const std::string & udn, uint16_t endpoint_id, int64_t last_seen)
+{
+    StatementScope scope(mInsertStmt);
+    BindText(mInsertStmt, 1, udn);
+    sqlite3_bind_int(mInsertStmt, 2, endpoint_id);
+    sqlite3_bind_int64(mInsertStmt, 3, last_seen);
+    return sqlite3_step(mInsertStmt) == SQLITE_DONE;
+}
+
+bool EndpointStoreSqlite::TouchMapping(const std::string & udn, int64_t last_seen)
+{
+    StatementScope scope(mTouchStmt);
+    BindText(mTouchStmt, 1, udn);
+    sqlite3_bind_int64(mTouchStmt, 2, last_seen);
+    return sqlite3_step(mTouchStmt) == SQLITE_DONE;
+}
+
+bool EndpointStoreSqlite::EraseMapping(const std::string & udn)
+{
+    StatementScope scope(mDeleteStmt);
+    BindText(mDeleteStmt, 1, udn);
+    return sqlite3_step(mDeleteStmt) == SQLITE_DONE;
+}
+
+std::optional<std::string> EndpointStoreSqlite::GetMeta(const std::string & key)
+{
+    StatementScope scope(mSelectMetaStmt);
+    BindText(mSelectMetaStmt, 1, key);
+
+    if (sqlite3_step(mSelectMetaStmt) == SQLITE_ROW)
+    {
+        const char * value = reinterpret_cast<const char *>(sqlite3_column_text(mSelectMetaStmt, 0));
+        if (value != nullptr)
+        {
+            return std::string(value);
+        }
+    }
+    return std::nullopt;
+}
+
+bool EndpointStoreSqlite::PutMeta(const std::string & key, const std::string & value)
+{
+    StatementScope scope(mUpsertMetaStmt);
+    BindText(mUpsertMetaStmt, 1, key);
+    BindText(mUpsertMetaStmt, 2, value);
+    return sqlite3_step(mUpsertMetaStmt) == SQLITE_DONE;
+}
+
+} // namespace wemo_bridge
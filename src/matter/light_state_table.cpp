@@ -0,0 +1,158 @@
+#include "wemo_bridge/light_state_table.h"
+
+#include <algorithm>
+
+namespace wemo_bridge {
+
+namespace {
+
+// Words per reduction block: four 128-bit or two 256-bit vectors.
+constexpr size_t kDiffBlock = 16;
+
+void AppendChanged(const uint32_t * current, const uint32_t * reported, size_t begin, size_t end, std::vector<uint32_t> & changed)
+{
+    for (size_t i = begin; i < end; i++)
+    {
+        if (current[i] != reported[i])
+        {
+            changed.push_back(static_cast<uint32_t>(i));
+        }
+    }
+}
+
+} // namespace
+
+void LightStateTable::Resize(size_t count)
+{
+    state.resize(count, 0);
+    pending_onoff.resize(count);
+    pending_level.resize(count);
+    next_seq.resize(count, 0);
+    srtt_us.resize(count, 0);
+    rttvar_us.resize(count, 0);
+}
+
+void LightStateTable::ClearCommands(size_t position)
+{
+    pending_onoff[position] = PendingCommand {};
+    pending_level[position] = PendingCommand {};
+}
+
+uint32_t LightStateTable::BeginCommand(size_t position, CommandAttribute attribute, int16_t value, TimePoint now)
+{
+    uint32_t seq = ++next_seq[position];
+    if (seq == 0)
+    {
+        seq = next_seq[position] = 1; // 0 means "none"
+    }
+
+    PendingCommand & pending = Pending(position, attribute);
+    pending.seq              = seq;
+    pending.value            = value;
+    pending.issued           = now;
+    pending.until            = now + SettleTimeout(position);
+    return seq;
+}
+
+void LightStateTable::CommandCompleted(size_t position, CommandAttribute attribute, uint32_t seq, bool acknowledged,
+                                       std::chrono::microseconds round_trip, TimePoint now)
+{
+    if (acknowledged)
+    {
+        AddRttSample(position, round_trip);
+    }
+
+    PendingCommand & pending = Pending(position, attribute);
+    if (pending.seq != seq || pending.value < 0)
+    {
+        return; // superseded by a newer command, or already confirmed
+    }
+    if (!acknowledged)
+    {
+        pending = PendingCommand {};
+        return;
+    }
+    // The device has the command, so a contradicting report can only be one
+    // the engine sent before it landed, and that is already on its way.
+    const TimePoint echoDeadline = now + kEventSlack;
+    if (echoDeadline < pending.until)
+    {
+        pending.until = echoDeadline;
+    }
+}
+
+ReportVerdict LightStateTable::OnReport(size_t position, CommandAttribute attribute, int16_t value, TimePoint now)
+{
+    PendingCommand & pending = Pending(position, attribute);
+    if (pending.value < 0)
+    {
+        return ReportVerdict::kApply;
+    }
+    if (now > pending.until)
+    {
+        pending.value = -1; // never confirmed; the device's word wins
+        return ReportVerdict::kApply;
+    }
+    if (value == pending.value)
+    {
+        pending.value = -1;
+        return ReportVerdict::kConfirmed;
+    }
+    return ReportVerdict::kSuppress;
+}
+
+bool LightStateTable::RecentOnOffCommand(size_t position, TimePoint now) const
+{
+    const PendingCommand & pending = pending_onoff[position];
+    return pending.issued != TimePoint {} && now <= pending.issued + SettleTimeout(position);
+}
+
+std::chrono::microseconds LightStateTable::SettleTimeout(size_t position) const
+{
+    if (srtt_us[position] == 0)
+    {
+        return kDefaultSettleTimeout;
+    }
+    const std::chrono::microseconds timeout(uint64_t { srtt_us[position] } + 4 * uint64_t { rttvar_us[position] });
+    return std::min<std::chrono::microseconds>(std::max<std::chrono::microseconds>(timeout + kEventSlack, kMinSettleTimeout),
+                                               kMaxSettleTimeout);
+}
+
+void LightStateTable::AddRttSample(size_t position, std::chrono::microseconds round_trip)
+{
+    constexpr int64_t kMaxSampleUs = 60 * 1000 * 1000;
+    const int64_t sample           = std::min<int64_t>(std::max<int64_t>(round_trip.count(), 1), kMaxSampleUs);
+
+    if (srtt_us[position] == 0)
+    {
+        srtt_us[position]   = static_cast<uint32_t>(sample);
+        rttvar_us[position] = static_cast<uint32_t>(sample / 2);
+        return;
+    }
+    const int64_t srtt      = srtt_us[position];
+    const int64_t deviation = (srtt > sample) ? srtt - sample : sample - srtt;
+    rttvar_us[position]     = static_cast<uint32_t>((3 * int64_t { rttvar_us[position] } + deviation) / 4);
+    srtt_us[position]       = static_cast<uint32_t>((7 * srtt + sample) / 8);
+}
+
+size_t DiffLightStates(const uint32_t * current, const uint32_t * reported, size_t count, std::vector<uint32_t> & changed)
+{
+    const size_t before = changed.size();
+    size_t block        = 0;
+    for (; block + kDiffBlock <= count; block += kDiffBlock)
+    {
+        uint32_t any = 0;
+        for (size_t i = 0; i < kDiffBlock; i++)
+        {
+            any |= current[block + i] ^ reported[block + i];
+        }
+        if (any != 0)
+        {
+            AppendChanged(current, reported, block, block + kDiffBlock, changed);
+        }
+    }
+    AppendChanged(current, reported, block, count, changed);
+    return changed.size() - before;
+}
+
+} // namespace wemo_bridge
@@ -0,0 +1,70 @@
+#include "wemo_bridge/slab_pool.h"
+
+namespace wemo_bridge {
+
+namespace {
+
+size_t RoundUpToCacheLine(size_t size)
+{
+    const size_t lines = (size + SlabPool::kCacheLine - 1) / SlabPool::kCacheLine;
+    return (lines > 0 ? lines : 1) * SlabPool::kCacheLine;
+}
+
+} // namespace
+
+SlabPool::SlabPool(size_t block_size, size_t blocks_per_chunk) :
+    mBlockSize(RoundUpToCacheLine(block_size)), mBlocksPerChunk(blocks_per_chunk > 0 ? blocks_per_chunk : 1)
+{}
+
+SlabPool::~SlabPool()
+{
+    for (void * chunk : mChunks)
+    {
+        ::operator delete(chunk, std::align_val_t(kCacheLine));
+    }
+}
+
+void * SlabPool::Allocate()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mFreeBlocks.empty())
+    {
+        auto * chunk = static_cast<unsigned char *>(::operator new(mBlockSize * mBlocksPerChunk, std::align_val_t(kCacheLine)));
+        mChunks.push_back(chunk);
+        // Pushed in reverse so blocks are handed out in address order.
+        for (size_t i = mBlocksPerChunk; i > 0; i--)
+        {
+            mFreeBlocks.push_back(chunk + (i - 1) * mBlockSize);
+        }
+    }
+
+    void * block = mFreeBlocks.back();
+    mFreeBlocks.pop_back();
+    mInUse++;
+    return block;
+}
+
+void SlabPool::Free(void * block)
+{
+    if (block == nullptr)
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mMutex);
+    mFreeBlocks.push_back(block);
+    mInUse--;
+}
+
+size_t SlabPool::ChunkCount() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mChunks.size();
+}
+
+size_t SlabPool::InUse() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mInUse;
+}
+
+} // namespace wemo_bridge
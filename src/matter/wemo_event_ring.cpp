@@ -0,0 +1,171 @@
+#include "wemo_bridge/wemo_event_ring.h"
+
+#include <thread>
+#include <utility>
+
+namespace wemo_bridge {
+
+namespace {
+
+// Slot state layout: state in bits 0-31, level in bits 32-47 (two's
+// complement, -1 = unknown), online in bit 48.
+constexpr uint64_t kOnlineBit = uint64_t { 1 } << 48;
+constexpr uint64_t kQueuedBit = uint64_t { 1 } << 63;
+
+uint64_t PackState(const WemoStateEvent & ev)
+{
+    return static_cast<uint64_t>(static_cast<uint32_t>(ev.state)) |
+        (static_cast<uint64_t>(static_cast<uint16_t>(ev.level)) << 32) | (ev.is_online ? kOnlineBit : 0);
+}
+
+WemoStateEvent UnpackState(int wemo_id, uint64_t packed)
+{
+    WemoStateEvent ev;
+    ev.wemo_id   = wemo_id;
+    ev.is_online = (packed & kOnlineBit) != 0;
+    ev.state     = static_cast<int32_t>(static_cast<uint32_t>(packed & 0xFFFFFFFFu));
+    ev.level     = static_cast<int16_t>(static_cast<uint16_t>((packed >> 32) & 0xFFFFu));
+    return ev;
+}
+
+size_t RoundUpToPowerOfTwo(size_t value)
+{
+    size_t result = 2;
+    while (result < value)
+    {
+        result <<= 1;
+    }
+    return result;
+}
+
+} // namespace
+
+WemoEventRing::WemoEventRing(size_t capacity, ScheduleFn schedule_drain) :
+    mMask(RoundUpToPowerOfTwo(capacity) - 1), mSlots(new Slot[mMask + 1]), mCells(new Cell[mMask + 1]),
+    mScheduleDrain(std::move(schedule_drain))
+{
+    for (size_t i = 0; i <= mMask; i++)
+    {
+        mCells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+WemoEventRing::Slot * WemoEventRing::FindOrClaimSlot(int wemo_id)
+{
+    // Open addressing with linear probing.  Slots are claimed once and never
+    // released, so a lookup can stop at the first empty slot.
+    const size_t start = (static_cast<uint32_t>(wemo_id) * 2654435761u) & mMask;
+    for (size_t probe = 0; probe <= mMask; probe++)
+    {
+        Slot & slot = mSlots[(start + probe) & mMask];
+        int current = slot.wemo_id.load(std::memory_order_acquire);
+        if (current == kEmptyWemoId && slot.wemo_id.compare_exchange_strong(current, wemo_id, std::memory_order_acq_rel))
+        {
+            return &slot;
+        }
+        // Either taken before, or claimed by a racing publisher just now.
+        if (current == wemo_id)
+        {
+            return &slot;
+        }
+    }
+    return nullptr;
+}
+
+bool WemoEventRing::Publish(const WemoStateEvent & ev)
+{
+    Slot * slot = (ev.wemo_id != kEmptyWemoId) ? FindOrClaimSlot(ev.wemo_id) : nullptr;
+    if (slot == nullptr)
+    {
+        mDropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // Overwrite whatever the consumer has not picked up yet; only the
+    // publisher that flips the slot to queued puts it in the queue.
+    const uint64_t previous = slot->state.exchange(PackState(ev) | kQueuedBit, std::memory_order_acq_rel);
+    if ((previous & kQueuedBit) != 0)
+    {
+        return true;
+    }
+
+    Enqueue(static_cast<uint32_t>(slot - mSlots.get()));
+    if (!mDrainScheduled.exchange(true, std::memory_order_acq_rel))
+    {
+        mScheduleDrain();
+    }
+    return true;
+}
+
+size_t WemoEventRing::Drain(const std::function<void(const WemoStateEvent &)> & apply)
+{
+    // Re-arm before looking at the queue, so a publisher that enqueues after
+    // the queue was seen empty schedules the next drain.
+    mDrainScheduled.exchange(false, std::memory_order_acq_rel);
+
+    // Bounded so a device that never stops reporting cannot keep the Matter
+    // thread in here; anything left over gets its own drain.
+    size_t applied = 0;
+    uint32_t index = 0;
+    while (applied <= mMask && Dequeue(index))
+    {
+        Slot & slot          = mSlots[index];
+        const uint64_t state = slot.state.fetch_and(~kQueuedBit, std::memory_order_acq_rel);
+        apply(UnpackState(slot.wemo_id.load(std::memory_order_relaxed), state));
+        applied++;
+    }
+
+    if (applied > mMask && !mDrainScheduled.exchange(true, std::memory_order_acq_rel))
+    {
+        mScheduleDrain();
+    }
+    return applied;
+}
+
+void WemoEventRing::Enqueue(uint32_t slot)
+{
+    size_t pos = mEnqueuePos.load(std::memory_order_relaxed);
+    while (true)
+    {
+        Cell & cell       = mCells[pos & mMask];
+        const size_t seq  = cell.sequence.load(std::memory_order_acquire);
+        const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+        if (diff == 0)
+        {
+            if (mEnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            {
+                cell.slot = slot;
+                cell.sequence.store(pos + 1, std::memory_order_release);
+                return;
+            }
+        }
+        else
+        {
+            // diff < 0 would mean a full queue, which cannot happen: every
+            // slot is queued at most once and the queue has a cell per slot.
+            // The consumer may still be releasing the cell, so retry.
+            if (diff < 0)
+            {
+                std::this_thread::yield();
+            }
+            pos = mEnqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+bool WemoEventRing::Dequeue(uint32_t & slot)
+{
+    Cell & cell      = mCells[mDequeuePos & mMask];
+    const size_t seq = cell.sequence.load(std::memory_order_acquire);
+    if (seq != mDequeuePos + 1)
+    {
+        return false;
+    }
+
+    slot = cell.slot;
+    cell.sequence.store(mDequeuePos + mMask + 1, std::memory_order_release);
+    mDequeuePos++;
+    return true;
+}
+
+} // namespace wemo_bridge
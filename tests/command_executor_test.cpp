@@ -0,0 +1,154 @@
+#include "test_harness.h"
+
+#include "wemo_bridge/command_executor.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using wemo_bridge::CommandExecutor;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Blocks tasks until Open(), so a test can keep work queued behind them.
+class Gate
+{
+public:
+    void Wait()
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mCv.wait(lock, [this] { return mOpen; });
+    }
+    void Open()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mOpen = true;
+        }
+        mCv.notify_all();
+    }
+
+private:
+    std::mutex mMutex;
+    std::condition_variable mCv;
+    bool mOpen = false;
+};
+
+} // namespace
+
+TEST_CASE(CommandExecutor_StrandRunsInSubmissionOrder)
+{
+    std::mutex mutex;
+    std::vector<int> order;
+    {
+        CommandExecutor executor(4);
+        for (int i = 0; i < 100; i++)
+        {
+            REQUIRE(executor.TrySubmit(7, [&, i] {
+                std::lock_guard<std::mutex> lock(mutex);
+                order.push_back(i);
+            }));
+        }
+        executor.Shutdown();
+    }
+    REQUIRE(order.size() == 100);
+    for (int i = 0; i < 100; i++)
+    {
+        CHECK_EQ(order[static_cast<size_t>(i)], i);
+    }
+}
+
+TEST_CASE(CommandExecutor_KeysRunInParallel)
+{
+    // Two tasks that each wait for the other can only finish if they run at
+    // the same time.
+    CommandExecutor executor(2);
+    std::atomic<int> arrived { 0 };
+    std::atomic<int> finished { 0 };
+    for (uint64_t key = 1; key <= 2; key++)
+    {
+        REQUIRE(executor.TrySubmit(key, [&] {
+            arrived++;
+            const auto deadline = Clock::now() + std::chrono::seconds(5);
+            while (arrived.load() < 2 && Clock::now() < deadline)
+            {
+                std::this_thread::yield();
+            }
+            if (arrived.load() == 2)
+            {
+                finished++;
+            }
+        }));
+    }
+    executor.Shutdown();
+    CHECK_EQ(finished.load(), 2);
+}
+
+TEST_CASE(CommandExecutor_RejectsPastMaxPending)
+{
+    Gate gate;
+    CommandExecutor executor(1, 3);
+    CHECK(executor.TrySubmit(1, [&] { gate.Wait(); }));
+    CHECK(executor.TrySubmit(1, [] {}));
+    CHECK(executor.TrySubmit(2, [] {}));
+    CHECK(!executor.TrySubmit(3, [] {}));
+    gate.Open();
+    executor.Shutdown();
+    CHECK(!executor.TrySubmit(1, [] {}));
+}
+
+TEST_CASE(CommandExecutor_LatestReplacesQueuedTaskOfSameKind)
+{
+    Gate gate;
+    std::vector<int> ran;
+    int superseded = 0;
+    {
+        CommandExecutor executor(1);
+        REQUIRE(executor.TrySubmit(1, [&] { gate.Wait(); }));
+        REQUIRE(executor.TrySubmitLatest(1, 10, [&] { ran.push_back(1); }, [&] { superseded++; }));
+        REQUIRE(executor.TrySubmitLatest(1, 20, [&] { ran.push_back(2); }));
+        // Replaces kind 10 and moves behind kind 20.
+        REQUIRE(executor.TrySubmitLatest(1, 10, [&] { ran.push_back(3); }));
+        gate.Open();
+        executor.Shutdown();
+    }
+    CHECK_EQ(superseded, 1);
+    REQUIRE(ran.size() == 2);
+    CHECK_EQ(ran[0], 2);
+    CHECK_EQ(ran[1], 3);
+}
+
+TEST_CASE(CommandExecutor_DeferredStrandHoldsNoWorker)
+{
+    const auto start    = Clock::now();
+    const auto admit_at = start + std::chrono::milliseconds(150);
+    std::atomic<bool> other_ran { false };
+    std::atomic<int> value_sent { -1 };
+    Clock::time_point sent_at {};
+    {
+        // One worker: if the deferred strand held it, key 2 could not run
+        // before key 1's admission time.
+        CommandExecutor executor(1, CommandExecutor::kDefaultMaxPending,
+                                 [&](uint64_t key) { return key == 1 ? admit_at : Clock::time_point {}; });
+        REQUIRE(executor.TrySubmitLatest(1, 1, [&] {
+            value_sent = 1;
+            sent_at    = Clock::now();
+        }));
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        REQUIRE(executor.TrySubmit(2, [&] { other_ran = Clock::now() < admit_at; }));
+        // Still queued while deferred, so a newer command replaces it.
+        REQUIRE(executor.TrySubmitLatest(1, 1, [&] {
+            value_sent = 2;
+            sent_at    = Clock::now();
+        }));
+        executor.Shutdown();
+    }
+    CHECK(other_ran.load());
+    CHECK_EQ(value_sent.load(), 2);
+    CHECK(sent_at >= admit_at);
+}
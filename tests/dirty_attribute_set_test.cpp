@@ -0,0 +1,98 @@
+#include "test_harness.h"
+
+#include "wemo_bridge/dirty_attribute_set.h"
+
+#include <atomic>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using wemo_bridge::DirtyAttributeSet;
+
+namespace {
+
+std::vector<std::pair<size_t, uint8_t>> FlushAll(DirtyAttributeSet & set)
+{
+    std::vector<std::pair<size_t, uint8_t>> reported;
+    set.Flush([&](size_t slot, uint8_t bits) { reported.emplace_back(slot, bits); });
+    return reported;
+}
+
+} // namespace
+
+TEST_CASE(DirtyAttributeSet_MergesBitsAndReportsInSlotOrder)
+{
+    int scheduled = 0;
+    DirtyAttributeSet set(10000, [&] { scheduled++; });
+    set.Mark(9000, 0x01);
+    set.Mark(3, 0x02);
+    set.Mark(3, 0x04);
+    set.Mark(64, 0x01);
+    set.Mark(10000, 0x01); // out of range
+    set.Mark(5, 0);        // nothing to mark
+    CHECK_EQ(scheduled, 1);
+
+    const auto reported = FlushAll(set);
+    REQUIRE(reported.size() == 3);
+    CHECK(reported[0] == std::make_pair(size_t { 3 }, uint8_t { 0x06 }));
+    CHECK(reported[1] == std::make_pair(size_t { 64 }, uint8_t { 0x01 }));
+    CHECK(reported[2] == std::make_pair(size_t { 9000 }, uint8_t { 0x01 }));
+
+    CHECK(FlushAll(set).empty());
+    set.Mark(7, 0x08);
+    CHECK_EQ(scheduled, 2);
+}
+
+TEST_CASE(DirtyAttributeSet_ForgetDropsPendingBits)
+{
+    DirtyAttributeSet set(128, [] {});
+    set.Mark(10, 0x03);
+    set.Mark(11, 0x01);
+    set.Forget(10);
+    set.Forget(500); // out of range
+
+    const auto reported = FlushAll(set);
+    REQUIRE(reported.size() == 1);
+    CHECK_EQ(reported[0].first, 11u);
+}
+
+TEST_CASE(DirtyAttributeSet_ConcurrentMarksAreAllReported)
+{
+    constexpr size_t kSlots  = 4096;
+    constexpr int kProducers = 4;
+
+    std::atomic<int> scheduled { 0 };
+    DirtyAttributeSet set(kSlots, [&] { scheduled++; });
+    std::vector<uint8_t> seen(kSlots, 0);
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducers; p++)
+    {
+        producers.emplace_back([&, p] {
+            for (size_t slot = 0; slot < kSlots; slot++)
+            {
+                set.Mark(slot, static_cast<uint8_t>(1u << p));
+            }
+        });
+    }
+    std::atomic<bool> done { false };
+    std::thread consumer([&] {
+        while (!done.load())
+        {
+            set.Flush([&](size_t slot, uint8_t bits) { seen[slot] |= bits; });
+        }
+    });
+    for (auto & producer : producers)
+    {
+        producer.join();
+    }
+    done = true;
+    consumer.join();
+    set.Flush([&](size_t slot, uint8_t bits) { seen[slot] |= bits; });
+
+    CHECK(scheduled.load() >= 1);
+    for (size_t slot = 0; slot < kSlots; slot++)
+    {
+        REQUIRE(seen[slot] == (1u << kProducers) - 1);
+    }
+}
@@ -0,0 +1,286 @@
+#include "test_harness.h"
+
+#include "wemo_bridge/endpoint_registry.h"
+#include "wemo_bridge/endpoint_store.h"
+
+#include <atomic>
+#include <chrono>
+#include <optional>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using wemo_bridge::EndpointRegistry;
+
+namespace {
+
+constexpr uint16_t kFirstId = 2;
+
+std::string Udn(int i)
+{
+    return "uuid:Lightswitch-1_0-" + std::to_string(1000000 + i);
+}
+
+// A negative age puts the cutoff in the future, so everything is reclaimed,
+// including what was seen a moment ago.
+constexpr std::chrono::seconds kReclaimEverything { -60 };
+
+void ReclaimRefusedWhileOwned(const std::string & path)
+{
+    {
+        EndpointRegistry owner(wemo_bridge::MakeEndpointStore(path), kFirstId);
+        REQUIRE(owner.GetOrAssign(Udn(0)).has_value());
+        REQUIRE(owner.LockStore(false));
+        CHECK(owner.LockStore(false)); // idempotent
+
+        EndpointRegistry cli(wemo_bridge::MakeEndpointStore(path), kFirstId);
+        CHECK(!cli.LockStore(false));
+        CHECK(cli.ReclaimUnseen(kReclaimEverything).empty());
+        CHECK(owner.Lookup(Udn(0)).has_value());
+    }
+
+    // Once the owner is gone the store is free again.
+    EndpointRegistry cli(wemo_bridge::MakeEndpointStore(path), kFirstId);
+    const auto reclaimed = cli.ReclaimUnseen(kReclaimEverything);
+    REQUIRE(reclaimed.size() == 1);
+    CHECK_EQ(reclaimed[0], Udn(0));
+    CHECK(!cli.Lookup(Udn(0)).has_value());
+}
+
+// Streams 100k distinct UDNs through the registry, keeping at most two
+// batches mapped at a time.  Released ids must be reused (there are fewer
+// than 65k of them), no two mapped UDNs may share an id, and a reopened
+// registry must see exactly the surviving mappings.
+void ChurnThroughIds(const std::string & path)
+{
+    constexpr int kTotalUdns = 100000;
+    constexpr int kBatch     = 1000;
+
+    std::unordered_map<std::string, uint16_t> live;
+    {
+        EndpointRegistry registry(wemo_bridge::MakeEndpointStore(path), kFirstId);
+        std::vector<std::string> previous;
+        for (int first = 0; first < kTotalUdns; first += kBatch)
+        {
+            std::vector<std::string> batch;
+            for (int i = first; i < first + kBatch; i++)
+            {
+                batch.push_back(Udn(i));
+            }
+            const auto ids = registry.GetOrAssignMany(batch);
+            REQUIRE(ids.size() == batch.size());
+            for (size_t i = 0; i < batch.size(); i++)
+            {
+                REQUIRE(ids[i].has_value());
+                // Two batches live at most, so ids never climb past them.
+                REQUIRE(ids[i].value() >= kFirstId && ids[i].value() < kFirstId + 2 * kBatch);
+                live[batch[i]] = ids[i].value();
+            }
+
+            std::set<uint16_t> distinct;
+            for (const auto & entry : live)
+            {
+                distinct.insert(entry.second);
+            }
+            REQUIRE(distinct.size() == live.size());
+
+            // One UDN of every batch goes through the single-UDN path; the
+            // batch release then skips it as already unmapped.
+            if (!previous.empty())
+            {
+                REQUIRE(registry.Release(previous.back()));
+            }
+            REQUIRE(registry.ReleaseMany(previous));
+            for (const auto & udn : previous)
+            {
+                live.erase(udn);
+                REQUIRE(!registry.Lookup(udn).has_value());
+            }
+            previous = std::move(batch);
+        }
+    }
+
+    EndpointRegistry reopened(wemo_bridge::MakeEndpointStore(path), kFirstId);
+    for (const auto & entry : live)
+    {
+        const auto id = reopened.Lookup(entry.first);
+        REQUIRE(id.has_value());
+        CHECK_EQ(id.value(), entry.second);
+    }
+    CHECK(!reopened.Lookup(Udn(0)).has_value());
+    CHECK(!reopened.Lookup(Udn(kTotalUdns - 2 * kBatch)).has_value());
+}
+
+// A store written with the old single-value free list keeps its free ids:
+// they are moved to per-slot rows on the first allocation and handed out
+// last-released first before the high-water mark grows.
+void MigratesLegacyFreeList(const std::string & path)
+{
+    {
+        auto store = wemo_bridge::MakeEndpointStore(path);
+        REQUIRE(store->Open());
+        REQUIRE(store->Begin());
+        REQUIRE(store->InsertMapping(Udn(0), 2, 0));
+        REQUIRE(store->InsertMapping(Udn(1), 4, 0));
+        REQUIRE(store->PutMeta("next_endpoint_id", "6"));
+        REQUIRE(store->PutMeta("free_endpoint_ids", "3,5,99"));
+        REQUIRE(store->Commit());
+    }
+
+    {
+        EndpointRegistry registry(wemo_bridge::MakeEndpointStore(path), kFirstId);
+        CHECK_EQ(registry.GetOrAssign(Udn(2)).value_or(0), 5);
+        CHECK_EQ(registry.Lookup(Udn(1)).value_or(0), 4);
+    }
+
+    EndpointRegistry reopened(wemo_bridge::MakeEndpointStore(path), kFirstId);
+    CHECK_EQ(reopened.GetOrAssign(Udn(3)).value_or(0), 3);
+    CHECK_EQ(reopened.GetOrAssign(Udn(4)).value_or(0), 6); // 99 was past the high-water mark
+    REQUIRE(reopened.Release(Udn(1)));
+    CHECK_EQ(reopened.GetOrAssign(Udn(5)).value_or(0), 4);
+}
+
+// Transient ids are never handed to a UDN while reserved, including by a
+// registry reopened on the same store (the next bridge run, or the CLI),
+// and ReleaseTransient() gives them back.
+void TransientIdsAreReserved(const std::string & path)
+{
+    std::set<uint16_t> transient;
+    {
+        EndpointRegistry registry(wemo_bridge::MakeEndpointStore(path), kFirstId);
+        REQUIRE(registry.GetOrAssign(Udn(0)).has_value());
+        for (int i = 0; i < 3; i++)
+        {
+            const auto id = registry.ReserveTransient();
+            REQUIRE(id.has_value());
+            CHECK(id.value() >= kFirstId);
+            transient.insert(id.value());
+        }
+        REQUIRE(transient.size() == 3);
+        CHECK(transient.count(registry.Lookup(Udn(0)).value_or(0)) == 0);
+        for (int i = 1; i < 10; i++)
+        {
+            CHECK(transient.count(registry.GetOrAssign(Udn(i)).value_or(0)) == 0);
+        }
+    }
+
+    EndpointRegistry reopened(wemo_bridge::MakeEndpointStore(path), kFirstId);
+    for (int i = 10; i < 20; i++)
+    {
+        CHECK(transient.count(reopened.GetOrAssign(Udn(i)).value_or(0)) == 0);
+    }
+    REQUIRE(reopened.ReleaseTransient());
+    CHECK(reopened.ReleaseTransient()); // nothing left
+
+    std::set<uint16_t> reused;
+    for (int i = 20; i < 23; i++)
+    {
+        reused.insert(reopened.GetOrAssign(Udn(i)).value_or(0));
+    }
+    CHECK(reused == transient);
+}
+
+} // namespace
+
+// Lookups serve a per-thread copy of the index; once an assignment has
+// returned, every thread must see it on its next lookup.
+TEST_CASE(EndpointRegistry_LookupsSeeEveryPublish)
+{
+    constexpr int kUdns    = 300;
+    constexpr int kReaders = 4;
+
+    const std::string dir = wemo_bridge_test::MakeTempDir();
+    EndpointRegistry registry(wemo_bridge::MakeEndpointStore(dir + "/map.log"), kFirstId);
+    std::atomic<int> assigned{ -1 };
+    std::atomic<int> misses{ 0 };
+
+    std::vector<std::thread> readers;
+    for (int r = 0; r < kReaders; r++)
+    {
+        readers.emplace_back([&] {
+            int seen = -1;
+            while (seen < kUdns - 1)
+            {
+                seen = assigned.load(std::memory_order_acquire);
+                if (seen >= 0 && !registry.Lookup(Udn(seen)).has_value())
+                {
+                    misses++;
+                }
+            }
+        });
+    }
+    for (int i = 0; i < kUdns; i++)
+    {
+        REQUIRE(registry.GetOrAssign(Udn(i)).has_value());
+        assigned.store(i, std::memory_order_release);
+    }
+    for (auto & reader : readers)
+    {
+        reader.join();
+    }
+    CHECK_EQ(misses.load(), 0);
+
+    // A second registry read from the same thread gets its own snapshot.
+    EndpointRegistry other(wemo_bridge::MakeEndpointStore(dir + "/other.log"), kFirstId);
+    CHECK(!other.Lookup(Udn(0)).has_value());
+    CHECK(registry.Lookup(Udn(0)).has_value());
+    wemo_bridge_test::RemoveTree(dir);
+}
+
+TEST_CASE(EndpointRegistry_ReclaimRefusedWhileOwned_Sqlite)
+{
+    const std::string dir = wemo_bridge_test::MakeTempDir();
+    ReclaimRefusedWhileOwned(dir + "/map.sqlite3");
+    wemo_bridge_test::RemoveTree(dir);
+}
+
+TEST_CASE(EndpointRegistry_ReclaimRefusedWhileOwned_Log)
+{
+    const std::string dir = wemo_bridge_test::MakeTempDir();
+    ReclaimRefusedWhileOwned(dir + "/map.log");
+    wemo_bridge_test::RemoveTree(dir);
+}
+
+TEST_CASE(EndpointRegistry_ChurnThroughIds_Sqlite)
+{
+    const std::string dir = wemo_bridge_test::MakeTempDir();
+    ChurnThroughIds(dir + "/map.sqlite3");
+    wemo_bridge_test::RemoveTree(dir);
+}
+
+TEST_CASE(EndpointRegistry_ChurnThroughIds_Log)
+{
+    const std::string dir = wemo_bridge_test::MakeTempDir();
+    ChurnThroughIds(dir + "/map.log");
+    wemo_bridge_test::RemoveTree(dir);
+}
+
+TEST_CASE(EndpointRegistry_MigratesLegacyFreeList_Sqlite)
+{
+    const std::string dir = wemo_bridge_test::MakeTempDir();
+    MigratesLegacyFreeList(dir + "/map.sqlite3");
+    wemo_bridge_test::RemoveTree(dir);
+}
+
+TEST_CASE(EndpointRegistry_MigratesLegacyFreeList_Log)
+{
+    const std::string dir = wemo_bridge_test::MakeTempDir();
+    MigratesLegacyFreeList(dir + "/map.log");
+    wemo_bridge_test::RemoveTree(dir);
+}
+
+TEST_CASE(EndpointRegistry_TransientIdsAreReserved_Sqlite)
+{
+    const std::string dir = wemo_bridge_test::MakeTempDir();
+    TransientIdsAreReserved(dir + "/map.sqlite3");
+    wemo_bridge_test::RemoveTree(dir);
+}
+
+TEST_CASE(EndpointRegistry_TransientIdsAreReserved_Log)
+{
+    const std::string dir = wemo_bridge_test::MakeTempDir();
+    TransientIdsAreReserved(dir + "/map.log");
+    wemo_bridge_test::RemoveTree(dir);
+}
@@ -0,0 +1,60 @@
+#include "test_harness.h"
+
+#include "wemo_bridge/endpoint_slots.h"
+
+#include <vector>
+
+using wemo_bridge::EndpointSlots;
+
+TEST_CASE(EndpointSlots_HandsOutLowestFreeSlot)
+{
+    EndpointSlots slots(5);
+    int owners[6];
+    for (uint16_t i = 0; i < 5; i++)
+    {
+        CHECK_EQ(slots.Acquire(&owners[i]), i);
+    }
+    CHECK_EQ(slots.Acquire(&owners[5]), EndpointSlots::kNoSlot);
+    CHECK_EQ(slots.InUse(), 5u);
+
+    CHECK_EQ(slots.Release(&owners[3]), 3);
+    CHECK_EQ(slots.Release(&owners[1]), 1);
+    CHECK_EQ(slots.Release(&owners[1]), EndpointSlots::kNoSlot);
+    CHECK_EQ(slots.SlotOf(&owners[1]), EndpointSlots::kNoSlot);
+    CHECK_EQ(slots.Acquire(&owners[5]), 1);
+    CHECK_EQ(slots.SlotOf(&owners[5]), 1);
+    CHECK_EQ(slots.Acquire(&owners[1]), 3);
+}
+
+TEST_CASE(EndpointSlots_OwnerHoldsOneSlot)
+{
+    EndpointSlots slots(4);
+    int owner = 0;
+    CHECK_EQ(slots.Acquire(&owner), 0);
+    CHECK_EQ(slots.Acquire(&owner), EndpointSlots::kNoSlot);
+    CHECK_EQ(slots.InUse(), 1u);
+}
+
+TEST_CASE(EndpointSlots_SpansManyWords)
+{
+    // Past 64 * 64 slots the summary needs a second word.
+    constexpr size_t kCapacity = 64 * 64 + 70;
+    EndpointSlots slots(kCapacity);
+    std::vector<char> owners(kCapacity);
+    for (size_t i = 0; i < kCapacity; i++)
+    {
+        REQUIRE(slots.Acquire(&owners[i]) == i);
+    }
+    CHECK_EQ(slots.Acquire(&slots), EndpointSlots::kNoSlot);
+
+    CHECK_EQ(slots.Release(&owners[kCapacity - 1]), kCapacity - 1);
+    CHECK_EQ(slots.Release(&owners[4100]), 4100);
+    CHECK_EQ(slots.Release(&owners[63]), 63);
+    CHECK_EQ(slots.Acquire(&slots), 63);
+    CHECK_EQ(slots.Release(&slots), 63);
+
+    slots.Clear();
+    CHECK_EQ(slots.InUse(), 0u);
+    CHECK_EQ(slots.SlotOf(&owners[0]), EndpointSlots::kNoSlot);
+    CHECK_EQ(slots.Acquire(&owners[10]), 0);
+}
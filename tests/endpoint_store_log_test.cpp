@@ -0,0 +1,297 @@
+#include "test_harness.h"
+
+#include "wemo_bridge/endpoint_store_log.h"
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <vector>
+
+using wemo_bridge::EndpointMapping;
+using wemo_bridge::EndpointStoreLog;
+
+namespace {
+
+std::vector<uint8_t> ReadFile(const std::string & path)
+{
+    std::ifstream in(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+void WriteFile(const std::string & path, const std::vector<uint8_t> & bytes)
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char *>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+}
+
+std::map<std::string, uint16_t> Load(const std::string & path)
+{
+    EndpointStoreLog store(path);
+    std::map<std::string, uint16_t> out;
+    std::vector<EndpointMapping> mappings;
+    if (!store.Open() || !store.LoadAll(mappings))
+    {
+        return out;
+    }
+    for (const auto & m : mappings)
+    {
+        out[m.udn] = m.endpoint_id;
+    }
+    return out;
+}
+
+bool InsertAll(EndpointStoreLog & store, const std::map<std::string, uint16_t> & mappings)
+{
+    if (!store.Begin())
+    {
+        return false;
+    }
+    for (const auto & m : mappings)
+    {
+        if (!store.InsertMapping(m.first, m.second, 1000))
+        {
+            store.Rollback();
+            return false;
+        }
+    }
+    return store.Commit();
+}
+
+std::string Udn(int i)
+{
+    return "uuid:Lightswitch-1_0-" + std::to_string(100000 + i);
+}
+
+} // namespace
+
+TEST_CASE(EndpointStoreLog_ReopenSeesCommittedState)
+{
+    const std::string dir  = wemo_bridge_test::MakeTempDir();
+    const std::string path = dir + "/map.log";
+    {
+        EndpointStoreLog store(path);
+        REQUIRE(store.Open());
+        CHECK(store.Open()); // idempotent
+        CHECK(InsertAll(store, { { Udn(1), 3 }, { Udn(2), 4 } }));
+        CHECK(store.Begin());
+        CHECK(store.EraseMapping(Udn(1)));
+        CHECK(store.PutMeta("next_id", "5"));
+        CHECK(store.Commit());
+
+        // Rolled back work never reaches the file.
+        CHECK(store.Begin());
+        CHECK(store.InsertMapping(Udn(9), 9, 1));
+        store.Rollback();
+    }
+
+    const auto state = Load(path);
+    CHECK_EQ(state.size(), 1u);
+    CHECK_EQ(state.count(Udn(2)), 1u);
+
+    EndpointStoreLog store(path);
+    REQUIRE(store.Open());
+    CHECK(store.GetMeta("next_id") == std::optional<std::string>("5"));
+    wemo_bridge_test::RemoveTree(dir);
+}
+
+TEST_CASE(EndpointStoreLog_SecondOpenerIsLockedOut)
+{
+    const std::string dir  = wemo_bridge_test::MakeTempDir();
+    const std::string path = dir + "/map.log";
+    EndpointStoreLog first(path);
+    REQUIRE(first.Open());
+    EndpointStoreLog second(path);
+    CHECK(!second.Open());
+    wemo_bridge_test::RemoveTree(dir);
+}
+
+// Cuts the last transaction's frame at every byte and flips every byte of it:
+// each torn or corrupt copy must reopen to exactly the previous transaction,
+// and must keep accepting commits afterwards.
+TEST_CASE(EndpointStoreLog_TornLastFrameIsDiscarded)
+{
+    const std::string dir  = wemo_bridge_test::MakeTempDir();
+    const std::string path = dir + "/map.log";
+    const std::map<std::string, uint16_t> first  = { { Udn(1), 3 } };
+    const std::map<std::string, uint16_t> second = { { Udn(2), 4 }, { Udn(3), 5 } };
+
+    std::vector<uint8_t> afterFirst;
+    std::vector<uint8_t> afterSecond;
+    {
+        EndpointStoreLog store(path);
+        REQUIRE(store.Open());
+        REQUIRE(InsertAll(store, first));
+        afterFirst = ReadFile(path);
+        REQUIRE(InsertAll(store, second));
+        afterSecond = ReadFile(path);
+    }
+    REQUIRE(afterFirst.size() == afterSecond.size());
+
+    size_t begin = 0;
+    while (begin < afterFirst.size() && afterFirst[begin] == afterSecond[begin])
+    {
+        begin++;
+    }
+    size_t end = afterFirst.size();
+    while (end > begin && afterFirst[end - 1] == afterSecond[end - 1])
+    {
+        end--;
+    }
+    REQUIRE(begin < end);
+
+    std::map<std::string, uint16_t> both = first;
+    both.insert(second.begin(), second.end());
+    CHECK(Load(path) == both);
+
+    const std::string torn = dir + "/torn.log";
+    for (size_t cut = begin; cut < end; cut++)
+    {
+        std::vector<uint8_t> bytes = afterSecond;
+        std::fill(bytes.begin() + static_cast<long>(cut), bytes.begin() + static_cast<long>(end), 0);
+        WriteFile(torn, bytes);
+        if (!CHECK(Load(torn) == first))
+        {
+            std::fprintf(stderr, "  cut at offset %zu\n", cut);
+            break;
+        }
+
+        bytes = afterSecond;
+        bytes[cut] ^= 0x5A;
+        WriteFile(torn, bytes);
+        if (!CHECK(Load(torn) == first))
+        {
+            std::fprintf(stderr, "  flipped offset %zu\n", cut);
+            break;
+        }
+    }
+
+    // Appending over the discarded tail must produce a clean log.
+    {
+        EndpointStoreLog store(torn);
+        REQUIRE(store.Open());
+        CHECK(InsertAll(store, { { Udn(7), 9 } }));
+    }
+    std::map<std::string, uint16_t> expected = first;
+    expected[Udn(7)]                         = 9;
+    CHECK(Load(torn) == expected);
+    wemo_bridge_test::RemoveTree(dir);
+}
+
+// Kills a writer process at an arbitrary point of a long run of commits.
+// Every commit it acknowledged must survive, and at most the one in flight
+// may be missing; nothing half-applied may appear.
+TEST_CASE(EndpointStoreLog_SurvivesWriterKilledMidCommit)
+{
+    const std::string dir  = wemo_bridge_test::MakeTempDir();
+    const std::string path = dir + "/map.log";
+
+    for (int round = 0; round < 3; round++)
+    {
+        int acks[2];
+        REQUIRE(pipe(acks) == 0);
+        const pid_t child = fork();
+        REQUIRE(child >= 0);
+        if (child == 0)
+        {
+            close(acks[0]);
+            EndpointStoreLog store(path);
+            if (!store.Open())
+            {
+                _exit(2);
+            }
+            for (int i = round * 100000;; i++)
+            {
+                // Two records per transaction: both or neither must survive.
+                if (!InsertAll(store, { { Udn(i) + "-a", static_cast<uint16_t>(i % 60000 + 1) },
+                                        { Udn(i) + "-b", static_cast<uint16_t>(i % 60000 + 1) } }))
+                {
+                    _exit(3);
+                }
+                const int acked = i;
+                if (write(acks[1], &acked, sizeof(acked)) != sizeof(acked))
+                {
+                    _exit(4);
+                }
+            }
+        }
+
+        close(acks[1]);
+        int lastAcked = -1;
+        int acked     = 0;
+        int count     = 0;
+        while (count < 150 + 100 * round && read(acks[0], &acked, sizeof(acked)) == sizeof(acked))
+        {
+            lastAcked = acked;
+            count++;
+        }
+        kill(child, SIGKILL);
+        int status = 0;
+        waitpid(child, &status, 0);
+        close(acks[0]);
+        REQUIRE(count > 0);
+
+        const auto state = Load(path);
+        for (int i = round * 100000; i <= lastAcked; i++)
+        {
+            if (!CHECK(state.count(Udn(i) + "-a") == 1 && state.count(Udn(i) + "-b") == 1))
+            {
+                std::fprintf(stderr, "  round %d lost acknowledged commit %d\n", round, i);
+                break;
+            }
+        }
+        for (const auto & m : state)
+        {
+            const std::string base  = m.first.substr(0, m.first.size() - 2);
+            const bool hasPartner   = state.count(base + "-a") == 1 && state.count(base + "-b") == 1;
+            if (!CHECK(hasPartner))
+            {
+                std::fprintf(stderr, "  half-applied transaction for %s\n", base.c_str());
+                break;
+            }
+        }
+    }
+    wemo_bridge_test::RemoveTree(dir);
+}
+
+// Enough rewrites of the same keys to grow the file and trigger background
+// compaction; the compacted log must reopen to the same state.
+TEST_CASE(EndpointStoreLog_CompactionKeepsState)
+{
+    const std::string dir  = wemo_bridge_test::MakeTempDir();
+    const std::string path = dir + "/map.log";
+    // ~54-byte frames: 8000 of them need a 512 KiB file uncompacted; after a
+    // compaction at the 256 KiB threshold the rest fit in 256 KiB.
+    constexpr size_t kCompactedCapacity = 256 * 1024;
+    std::map<std::string, uint16_t> expected;
+    {
+        EndpointStoreLog store(path);
+        REQUIRE(store.Open());
+        for (int i = 0; i < 16; i++)
+        {
+            expected[Udn(i)] = static_cast<uint16_t>(i + 2);
+        }
+        REQUIRE(InsertAll(store, expected));
+        for (int pass = 0; pass < 8000; pass++)
+        {
+            REQUIRE(store.Begin());
+            REQUIRE(store.TouchMapping(Udn(pass % 16), 2000 + pass));
+            REQUIRE(store.Commit());
+        }
+
+        // Compaction runs in the background; give it a moment to land.
+        for (int wait = 0; wait < 500 && ReadFile(path).size() > kCompactedCapacity; wait++)
+        {
+            usleep(10 * 1000);
+        }
+    }
+
+    CHECK(ReadFile(path).size() <= kCompactedCapacity);
+    CHECK(Load(path) == expected);
+    wemo_bridge_test::RemoveTree(dir);
+}
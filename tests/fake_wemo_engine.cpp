@@ -0,0 +1,146 @@
+#include "fake_wemo_engine/fake_wemo_engine.h"
+
+#include <cstdio>
+#include <mutex>
+#include <thread>
+
+extern "C" {
+#include "fake_wemo_engine/wemo_engine.h"
+}
+
+namespace fake_wemo_engine {
+
+namespace {
+
+std::mutex gMutex;
+std::vector<std::pair<std::string, int>> gDevices;
+std::vector<int> gActions;
+std::vector<int> gActionLevels;
+int gListCalls = 0;
+std::chrono::milliseconds gListDelay { 0 };
+std::chrono::milliseconds gActionDelay { 0 };
+int gActionResult = 1;
+
+} // namespace
+
+void SetDevices(const std::vector<std::pair<std::string, int>> & devices)
+{
+    std::lock_guard<std::mutex> lock(gMutex);
+    gDevices = devices;
+}
+
+void SetListDelay(std::chrono::milliseconds delay)
+{
+    std::lock_guard<std::mutex> lock(gMutex);
+    gListDelay = delay;
+}
+
+void SetActionDelay(std::chrono::milliseconds delay)
+{
+    std::lock_guard<std::mutex> lock(gMutex);
+    gActionDelay = delay;
+}
+
+void SetActionResult(int rc)
+{
+    std::lock_guard<std::mutex> lock(gMutex);
+    gActionResult = rc;
+}
+
+void ResetCounters()
+{
+    std::lock_guard<std::mutex> lock(gMutex);
+    gActions.clear();
+    gActionLevels.clear();
+    gListCalls = 0;
+}
+
+int ListCalls()
+{
+    std::lock_guard<std::mutex> lock(gMutex);
+    return gListCalls;
+}
+
+std::vector<int> Actions()
+{
+    std::lock_guard<std::mutex> lock(gMutex);
+    return gActions;
+}
+
+std::vector<int> ActionLevels()
+{
+    std::lock_guard<std::mutex> lock(gMutex);
+    return gActionLevels;
+}
+
+} // namespace fake_wemo_engine
+
+using namespace fake_wemo_engine;
+
+extern "C" {
+
+int we_init(void)
+{
+    return 1;
+}
+
+int we_set_ipc_target(const char *, int)
+{
+    return 1;
+}
+
+int we_discover(int)
+{
+    return WE_STATUS_OK;
+}
+
+int we_list_devices(struct we_device_list * list)
+{
+    std::chrono::milliseconds delay;
+    {
+        std::lock_guard<std::mutex> lock(gMutex);
+        gListCalls++;
+        delay = gListDelay;
+    }
+    std::this_thread::sleep_for(delay);
+
+    std::lock_guard<std::mutex> lock(gMutex);
+    *list       = {};
+    list->count = 0;
+    for (const auto & device : gDevices)
+    {
+        if (list->count == WE_DEVICE_LIST_MAX_ITEMS)
+        {
+            break;
+        }
+        struct we_device_info & info = list->items[list->count++];
+        info.wemo_id                 = device.second;
+        std::snprintf(info.udn, sizeof(info.udn), "%s", device.first.c_str());
+        std::snprintf(info.friendly_name, sizeof(info.friendly_name), "Fake %d", device.second);
+        info.is_online = 1;
+        info.level     = -1;
+    }
+    return WE_STATUS_OK;
+}
+
+int we_set_action(int wemo_id, struct we_state * state)
+{
+    std::chrono::milliseconds delay;
+    {
+        std::lock_guard<std::mutex> lock(gMutex);
+        delay = gActionDelay;
+    }
+    std::this_thread::sleep_for(delay);
+
+    std::lock_guard<std::mutex> lock(gMutex);
+    gActions.push_back(wemo_id);
+    gActionLevels.push_back(state->level);
+    return gActionResult;
+}
+
+int we_register_event_callback(we_event_cb)
+{
+    return 1;
+}
+
+} // extern "C"
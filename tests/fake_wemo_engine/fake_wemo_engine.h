@@ -0,0 +1,32 @@
+#pragma once
+
+// Control side of the fake engine behind tests/fake_wemo_engine/wemo_engine.h.
+
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace fake_wemo_engine {
+
+// (udn, wemo_id) of every device the engine reports, in list order.
+void SetDevices(const std::vector<std::pair<std::string, int>> & devices);
+
+// How long each we_list_devices() call takes.
+void SetListDelay(std::chrono::milliseconds delay);
+
+// How long each we_set_action() call takes, i.e. the device round trip.
+void SetActionDelay(std::chrono::milliseconds delay);
+
+// What we_set_action() returns; nonzero is success.
+void SetActionResult(int rc);
+
+// Clears the counters below.
+void ResetCounters();
+int ListCalls();
+// wemo ids passed to we_set_action(), in call order.
+std::vector<int> Actions();
+// Levels passed to we_set_action(), in call order.
+std::vector<int> ActionLevels();
+
+} // namespace fake_wemo_engine
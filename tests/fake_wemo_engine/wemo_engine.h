@@ -0,0 +1,41 @@
+#pragma once
+
+/* The subset of the openwemo engine API the adapter uses, backed by an
+ * in-process fake (tests/fake_wemo_engine.cpp) so the adapter can be unit
+ * tested without wemo_ctrl. */
+
+#define WE_STATUS_OK 0
+#define WE_DEVICE_LIST_MAX_ITEMS 64
+
+struct we_state
+{
+    int state;
+    int level;
+    int is_online;
+};
+
+struct we_device_info
+{
+    int wemo_id;
+    char udn[128];
+    char friendly_name[64];
+    int is_online;
+    int state;
+    int device_type;
+    int level;
+};
+
+struct we_device_list
+{
+    int count;
+    struct we_device_info items[WE_DEVICE_LIST_MAX_ITEMS];
+};
+
+typedef void (*we_event_cb)(int, struct we_state *);
+
+int we_init(void);
+int we_set_ipc_target(const char * host, int port);
+int we_discover(int);
+int we_list_devices(struct we_device_list * list);
+int we_set_action(int wemo_id, struct we_state * state);
+int we_register_event_callback(we_event_cb cb);
@@ -0,0 +1,211 @@
+#include "test_harness.h"
+
+#include "wemo_bridge/level_map.h"
+#include "wemo_bridge/light_state_table.h"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace std::chrono_literals;
+using wemo_bridge::CommandAttribute;
+using wemo_bridge::LightStateTable;
+using wemo_bridge::ReportVerdict;
+
+namespace {
+
+using TimePoint = LightStateTable::TimePoint;
+
+const TimePoint kT0 = TimePoint {} + 1h;
+
+} // namespace
+
+TEST_CASE(LightStateTable_ReportsAgainstPendingCommand)
+{
+    LightStateTable table;
+    table.Resize(2);
+
+    CHECK(table.OnReport(0, CommandAttribute::kOnOff, 1, kT0) == ReportVerdict::kApply);
+
+    table.BeginCommand(0, CommandAttribute::kOnOff, 1, kT0);
+    // A stale echo of the old state is held back while the command settles.
+    CHECK(table.OnReport(0, CommandAttribute::kOnOff, 0, kT0 + 10ms) == ReportVerdict::kSuppress);
+    CHECK(table.OnReport(0, CommandAttribute::kOnOff, 1, kT0 + 20ms) == ReportVerdict::kConfirmed);
+    CHECK(table.OnReport(0, CommandAttribute::kOnOff, 0, kT0 + 30ms) == ReportVerdict::kApply);
+
+    // Attributes and positions are independent.
+    table.BeginCommand(0, CommandAttribute::kLevel, 50, kT0);
+    CHECK(table.OnReport(0, CommandAttribute::kOnOff, 0, kT0 + 1ms) == ReportVerdict::kApply);
+    CHECK(table.OnReport(1, CommandAttribute::kLevel, 10, kT0 + 1ms) == ReportVerdict::kApply);
+
+    // Never confirmed: after the window the device's word wins.
+    CHECK(table.OnReport(0, CommandAttribute::kLevel, 20, kT0 + wemo_bridge::kDefaultSettleTimeout + 1ms) ==
+          ReportVerdict::kApply);
+    CHECK(table.OnReport(0, CommandAttribute::kLevel, 30, kT0 + wemo_bridge::kDefaultSettleTimeout + 2ms) ==
+          ReportVerdict::kApply);
+}
+
+TEST_CASE(LightStateTable_CompletionShortensOrDropsCommand)
+{
+    LightStateTable table;
+    table.Resize(1);
+
+    // Acknowledged: the window shrinks to the event slack.
+    const uint32_t acked = table.BeginCommand(0, CommandAttribute::kOnOff, 1, kT0);
+    table.CommandCompleted(0, CommandAttribute::kOnOff, acked, true, 100ms, kT0 + 100ms);
+    CHECK(table.OnReport(0, CommandAttribute::kOnOff, 0, kT0 + 100ms + wemo_bridge::kEventSlack - 1ms) ==
+          ReportVerdict::kSuppress);
+    CHECK(table.OnReport(0, CommandAttribute::kOnOff, 0, kT0 + 100ms + wemo_bridge::kEventSlack + 1ms) ==
+          ReportVerdict::kApply);
+
+    // Failed: the command is gone at once.
+    const uint32_t failed = table.BeginCommand(0, CommandAttribute::kOnOff, 1, kT0 + 1s);
+    table.CommandCompleted(0, CommandAttribute::kOnOff, failed, false, 0us, kT0 + 1s);
+    CHECK(table.OnReport(0, CommandAttribute::kOnOff, 0, kT0 + 1s) == ReportVerdict::kApply);
+
+    // A completion for a superseded command leaves the newer one alone.
+    const uint32_t older = table.BeginCommand(0, CommandAttribute::kOnOff, 0, kT0 + 2s);
+    const uint32_t newer = table.BeginCommand(0, CommandAttribute::kOnOff, 1, kT0 + 2s);
+    CHECK(newer != older);
+    table.CommandCompleted(0, CommandAttribute::kOnOff, older, false, 0us, kT0 + 2s);
+    CHECK(table.OnReport(0, CommandAttribute::kOnOff, 0, kT0 + 2s) == ReportVerdict::kSuppress);
+
+    table.ClearCommands(0);
+    CHECK(table.OnReport(0, CommandAttribute::kOnOff, 0, kT0 + 2s) == ReportVerdict::kApply);
+}
+
+TEST_CASE(LightStateTable_SettleTimeoutFollowsRoundTrips)
+{
+    LightStateTable table;
+    table.Resize(1);
+    CHECK(table.SettleTimeout(0) == wemo_bridge::kDefaultSettleTimeout);
+
+    // A fast, steady device is clamped to the minimum.
+    for (int i = 0; i < 32; i++)
+    {
+        const uint32_t seq = table.BeginCommand(0, CommandAttribute::kOnOff, 1, kT0);
+        table.CommandCompleted(0, CommandAttribute::kOnOff, seq, true, 1ms, kT0);
+    }
+    CHECK(table.SettleTimeout(0) == wemo_bridge::kMinSettleTimeout);
+
+    // A very slow one is clamped to the maximum.
+    for (int i = 0; i < 32; i++)
+    {
+        const uint32_t seq = table.BeginCommand(0, CommandAttribute::kOnOff, 1, kT0);
+        table.CommandCompleted(0, CommandAttribute::kOnOff, seq, true, 30s, kT0);
+    }
+    CHECK(table.SettleTimeout(0) == wemo_bridge::kMaxSettleTimeout);
+
+    // Failures are not round trip samples.
+    LightStateTable fresh;
+    fresh.Resize(1);
+    const uint32_t seq = fresh.BeginCommand(0, CommandAttribute::kOnOff, 1, kT0);
+    fresh.CommandCompleted(0, CommandAttribute::kOnOff, seq, false, 10s, kT0);
+    CHECK(fresh.SettleTimeout(0) == wemo_bridge::kDefaultSettleTimeout);
+}
+
+TEST_CASE(LightStateTable_SettleTimeoutTracksRoundTripAndJitter)
+{
+    LightStateTable table;
+    table.Resize(2);
+
+    // Steady ~90 ms: a little above one round trip plus the event slack.
+    for (int i = 0; i < 32; i++)
+    {
+        const uint32_t seq = table.BeginCommand(0, CommandAttribute::kOnOff, 1, kT0);
+        table.CommandCompleted(0, CommandAttribute::kOnOff, seq, true, std::chrono::microseconds(88000 + (i % 5) * 1000), kT0);
+    }
+    CHECK(table.SettleTimeout(0) > 90ms + wemo_bridge::kEventSlack);
+    CHECK(table.SettleTimeout(0) < 500ms);
+
+    // 0.9-1.5 s with jitter: the deviation term keeps it well above the mean.
+    for (int i = 0; i < 32; i++)
+    {
+        const uint32_t seq = table.BeginCommand(1, CommandAttribute::kOnOff, 1, kT0);
+        table.CommandCompleted(1, CommandAttribute::kOnOff, seq, true, (i % 2) ? 900ms : 1500ms, kT0);
+    }
+    CHECK(table.SettleTimeout(1) > 1500ms + wemo_bridge::kEventSlack);
+    CHECK(table.SettleTimeout(1) < wemo_bridge::kMaxSettleTimeout);
+}
+
+TEST_CASE(LightStateTable_RecentOnOffCommand)
+{
+    LightStateTable table;
+    table.Resize(1);
+    CHECK(!table.RecentOnOffCommand(0, kT0));
+    table.BeginCommand(0, CommandAttribute::kOnOff, 1, kT0);
+    CHECK(table.OnReport(0, CommandAttribute::kOnOff, 1, kT0 + 1ms) == ReportVerdict::kConfirmed);
+    // Still recent after confirmation.
+    CHECK(table.RecentOnOffCommand(0, kT0 + 1s));
+    CHECK(!table.RecentOnOffCommand(0, kT0 + wemo_bridge::kDefaultSettleTimeout + 1ms));
+}
+
+TEST_CASE(LightStateTable_DiffMatchesElementwiseCompare)
+{
+    std::mt19937 rng(1234);
+    for (const size_t count : { size_t { 0 }, size_t { 1 }, size_t { 15 }, size_t { 16 }, size_t { 17 }, size_t { 1000 } })
+    {
+        std::vector<uint32_t> current(count);
+        for (auto & word : current)
+        {
+            word = wemo_bridge::PackLightState(rng() & 1, rng() & 1, static_cast<uint8_t>(rng() % 255));
+        }
+        std::vector<uint32_t> reported = current;
+        std::vector<uint32_t> expected;
+        for (size_t i = 0; i < count; i++)
+        {
+            if (rng() % 7 == 0)
+            {
+                reported[i] ^= wemo_bridge::kLightOnBit;
+                expected.push_back(static_cast<uint32_t>(i));
+            }
+        }
+
+        std::vector<uint32_t> changed { 99999 }; // appended to, not replaced
+        CHECK_EQ(wemo_bridge::DiffLightStates(current.data(), reported.data(), count, changed), expected.size());
+        expected.insert(expected.begin(), 99999);
+        CHECK(changed == expected);
+    }
+}
+
+TEST_CASE(LightStateTable_EveryLevelCommandConfirms)
+{
+    // Level commands are tracked in WeMo percent, the unit the device
+    // reports, so every Matter level a controller writes is confirmed by
+    // the device reporting it back.
+    LightStateTable table;
+    table.Resize(1);
+    TimePoint now = kT0;
+    for (int level = 1; level <= wemo_bridge::kMaxMatterLevel; level++)
+    {
+        now += 10s;
+        const uint8_t percent = wemo_bridge::MatterLevelToWemoPercent(static_cast<uint8_t>(level));
+        table.BeginCommand(0, CommandAttribute::kLevel, percent, now);
+        if (!CHECK(table.OnReport(0, CommandAttribute::kLevel, percent, now + 50ms) == ReportVerdict::kConfirmed))
+        {
+            std::fprintf(stderr, "  Matter level %d (%d %%) not confirmed\n", level, percent);
+        }
+        // Showing the reported level and writing it back is a no-op.
+        CHECK_EQ(wemo_bridge::MatterLevelToWemoPercent(wemo_bridge::WemoPercentToMatterLevel(percent)), percent);
+
+        // A physical change after the confirmation is the device's state.
+        CHECK(table.OnReport(0, CommandAttribute::kLevel, percent == 100 ? 20 : 100, now + 800ms) == ReportVerdict::kApply);
+    }
+}
+
+TEST_CASE(LightStateTable_PackAndLevelMap)
+{
+    const uint32_t state = wemo_bridge::PackLightState(true, false, 200);
+    CHECK(state & wemo_bridge::kLightReachableBit);
+    CHECK(!(state & wemo_bridge::kLightOnBit));
+    CHECK_EQ(wemo_bridge::LightLevel(state), 200);
+
+    CHECK_EQ(wemo_bridge::WemoPercentToMatterLevel(0), 0);
+    CHECK_EQ(wemo_bridge::WemoPercentToMatterLevel(100), 254);
+    CHECK_EQ(wemo_bridge::WemoPercentToMatterLevel(150), 254);
+    CHECK_EQ(wemo_bridge::WemoPercentToMatterLevel(-5), 0);
+    // A dim but non-zero level must not turn the light off.
+    CHECK_EQ(wemo_bridge::MatterLevelToWemoPercent(1), 1);
+    CHECK_EQ(wemo_bridge::MatterLevelToWemoPercent(254), 100);
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+// Minimal self-contained test registry, so the unit tests build anywhere the
+// bridge sources do.  TEST_CASE registers a function; CHECK records a failure
+// and keeps going, REQUIRE returns from the test on failure.
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace wemo_bridge_test {
+
+struct TestCase
+{
+    const char * name;
+    void (*fn)();
+};
+
+inline std::vector<TestCase> & Registry()
+{
+    static std::vector<TestCase> tests;
+    return tests;
+}
+
+inline int & FailureCount()
+{
+    static int failures = 0;
+    return failures;
+}
+
+struct Registrar
+{
+    Registrar(const char * name, void (*fn)()) { Registry().push_back({ name, fn }); }
+};
+
+inline bool Check(bool ok, const char * expr, const char * file, int line)
+{
+    if (!ok)
+    {
+        FailureCount()++;
+        std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", file, line, expr);
+    }
+    return ok;
+}
+
+// Scratch directory under the build tree's temp dir, removed by the caller.
+std::string MakeTempDir();
+void RemoveTree(const std::string & path);
+
+} // namespace wemo_bridge_test
+
+#define WB_TEST_CONCAT2(a, b) a##b
+#define WB_TEST_CONCAT(a, b) WB_TEST_CONCAT2(a, b)
+
+#define TEST_CASE(name)                                                                                                           \
+    static void name();                                                                                                           \
+    static const ::wemo_bridge_test::Registrar WB_TEST_CONCAT(name, _registrar)(#name, &name);                                   \
+    static void name()
+
+#define CHECK(expr) ::wemo_bridge_test::Check(static_cast<bool>(expr), #expr, __FILE__, __LINE__)
+#define CHECK_EQ(a, b) CHECK((a) == (b))
+#define REQUIRE(expr)                                                                                                             \
+    do                                                                                                                            \
+    {                                                                                                                             \
+        if (!CHECK(expr))                                                                                                         \
+        {                                                                                                                         \
+            return;                                                                                                               \
+        }                                                                                                                         \
+    } while (0)
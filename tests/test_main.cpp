@@ -0,0 +1,48 @@
+#include "test_harness.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+
+namespace wemo_bridge_test {
+
+std::string MakeTempDir()
+{
+    std::string pattern = (std::filesystem::temp_directory_path() / "wemo-bridge-test-XXXXXX").string();
+    if (mkdtemp(pattern.data()) == nullptr)
+    {
+        std::perror("mkdtemp");
+        std::abort();
+    }
+    return pattern;
+}
+
+void RemoveTree(const std::string & path)
+{
+    std::error_code ec;
+    std::filesystem::remove_all(path, ec);
+}
+
+} // namespace wemo_bridge_test
+
+// Runs every registered test, or only those whose name contains argv[1].
+int main(int argc, char ** argv)
+{
+    using namespace wemo_bridge_test;
+
+    const char * filter = (argc > 1) ? argv[1] : nullptr;
+    int run             = 0;
+    for (const TestCase & test : Registry())
+    {
+        if (filter != nullptr && std::strstr(test.name, filter) == nullptr)
+        {
+            continue;
+        }
+        const int before = FailureCount();
+        test.fn();
+        run++;
+        std::printf("%s %s\n", (FailureCount() == before) ? "[ OK ]" : "[FAIL]", test.name);
+    }
+    std::printf("%d test(s), %d failed check(s)\n", run, FailureCount());
+    return (FailureCount() == 0 && run > 0) ? 0 : 1;
+}
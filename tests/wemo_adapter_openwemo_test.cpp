@@ -0,0 +1,181 @@
+#include "test_harness.h"
+
+#include "fake_wemo_engine/fake_wemo_engine.h"
+#include "wemo_bridge/wemo_adapter_openwemo.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using wemo_bridge::CommandStatus;
+using wemo_bridge::WemoAdapterOpenWemo;
+
+namespace {
+
+const std::string kUdnA = "uuid:Lightswitch-1_0-A";
+const std::string kUdnB = "uuid:Lightswitch-1_0-B";
+
+// Unlimited command rate, so synchronous commands never wait for tokens.
+void Unthrottle(WemoAdapterOpenWemo & adapter)
+{
+    adapter.SetCommandRateLimit(0, 1);
+}
+
+bool Sent(int wemo_id)
+{
+    const auto actions = fake_wemo_engine::Actions();
+    return std::find(actions.begin(), actions.end(), wemo_id) != actions.end();
+}
+
+} // namespace
+
+TEST_CASE(WemoAdapterOpenWemo_DeviceMissingFromDiscoveryNoLongerResolves)
+{
+    WemoAdapterOpenWemo adapter("127.0.0.1:49153");
+    Unthrottle(adapter);
+
+    fake_wemo_engine::SetDevices({ { kUdnA, 1 }, { kUdnB, 2 } });
+    REQUIRE(adapter.Discover().size() == 2);
+    const auto a = adapter.Resolve(kUdnA);
+    const auto b = adapter.Resolve(kUdnB);
+    fake_wemo_engine::ResetCounters();
+    CHECK(adapter.SetOnOff(b, true).Succeeded());
+    CHECK(Sent(2));
+
+    // B leaves and the engine renumbers A onto B's old id.
+    fake_wemo_engine::SetDevices({ { kUdnA, 2 } });
+    REQUIRE(adapter.Discover().size() == 1);
+    fake_wemo_engine::ResetCounters();
+
+    CHECK(adapter.SetOnOff(b, true).status == CommandStatus::kUnresolved);
+    CHECK(fake_wemo_engine::Actions().empty());
+    CHECK(adapter.Resolve(kUdnB) == b); // the handle itself stays valid
+
+    CHECK(adapter.SetOnOff(a, false).Succeeded());
+    CHECK(Sent(2));
+
+    // B comes back and resolves again.
+    fake_wemo_engine::SetDevices({ { kUdnA, 2 }, { kUdnB, 7 } });
+    REQUIRE(adapter.Discover().size() == 2);
+    fake_wemo_engine::ResetCounters();
+    CHECK(adapter.SetOnOff(b, true).Succeeded());
+    CHECK(Sent(7));
+}
+
+TEST_CASE(WemoAdapterOpenWemo_DepartedDeviceFailsFast)
+{
+    WemoAdapterOpenWemo adapter("127.0.0.1:49153");
+    Unthrottle(adapter);
+
+    fake_wemo_engine::SetDevices({ { kUdnA, 1 }, { kUdnB, 2 } });
+    REQUIRE(adapter.Discover().size() == 2);
+    const auto b = adapter.Resolve(kUdnB);
+    fake_wemo_engine::SetDevices({ { kUdnA, 1 } });
+    REQUIRE(adapter.Discover().size() == 1);
+
+    // Concurrent commands for the departed device share one slow pass.
+    fake_wemo_engine::SetListDelay(std::chrono::milliseconds(200));
+    fake_wemo_engine::ResetCounters();
+    std::atomic<int> unresolved { 0 };
+    std::vector<std::thread> senders;
+    for (int i = 0; i < 8; i++)
+    {
+        senders.emplace_back([&] {
+            if (adapter.SetOnOff(b, true).status == CommandStatus::kUnresolved)
+            {
+                unresolved++;
+            }
+        });
+    }
+    for (auto & sender : senders)
+    {
+        sender.join();
+    }
+    CHECK_EQ(unresolved.load(), 8);
+    CHECK_EQ(fake_wemo_engine::ListCalls(), 1);
+
+    // Then the negative cache answers without asking the engine.
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 100; i++)
+    {
+        CHECK(adapter.SetOnOff(b, false).status == CommandStatus::kUnresolved);
+    }
+    CHECK(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(200));
+    CHECK_EQ(fake_wemo_engine::ListCalls(), 1);
+    CHECK(fake_wemo_engine::Actions().empty());
+    fake_wemo_engine::SetListDelay(std::chrono::milliseconds(0));
+}
+
+TEST_CASE(WemoAdapterOpenWemo_AsyncLevelWritesCoalesce)
+{
+    WemoAdapterOpenWemo adapter("127.0.0.1:49153");
+    Unthrottle(adapter);
+    fake_wemo_engine::SetDevices({ { kUdnA, 1 } });
+    REQUIRE(adapter.Discover().size() == 1);
+    const auto a = adapter.Resolve(kUdnA);
+    fake_wemo_engine::SetActionDelay(std::chrono::milliseconds(20));
+    fake_wemo_engine::ResetCounters();
+
+    // A drag: every write lands while the first one is still in flight.
+    std::mutex mutex;
+    std::vector<CommandStatus> statuses;
+    for (uint8_t level = 1; level <= 50; level++)
+    {
+        CHECK(adapter.SetLevelPercentAsync(a, level, [&](const wemo_bridge::CommandResult & result) {
+            std::lock_guard<std::mutex> lock(mutex);
+            statuses.push_back(result.status);
+        }));
+    }
+    adapter.Shutdown();
+    fake_wemo_engine::SetActionDelay(std::chrono::milliseconds(0));
+
+    REQUIRE(statuses.size() == 50);
+    const auto sent       = fake_wemo_engine::ActionLevels();
+    const auto superseded = std::count(statuses.begin(), statuses.end(), CommandStatus::kSuperseded);
+    CHECK_EQ(std::count(statuses.begin(), statuses.end(), CommandStatus::kOk), static_cast<long>(sent.size()));
+    CHECK_EQ(superseded + static_cast<long>(sent.size()), 50);
+    CHECK(sent.size() <= 3);
+    REQUIRE(!sent.empty());
+    CHECK_EQ(sent.back(), 50);
+}
+
+TEST_CASE(WemoAdapterOpenWemo_AsyncFailuresCompleteBeforeShutdown)
+{
+    WemoAdapterOpenWemo adapter("127.0.0.1:49153");
+    Unthrottle(adapter);
+    fake_wemo_engine::SetDevices({ { kUdnA, 1 } });
+    REQUIRE(adapter.Discover().size() == 1);
+    const auto a       = adapter.Resolve(kUdnA);
+    const auto unknown = adapter.Resolve("uuid:Lightswitch-1_0-NotDiscovered");
+    fake_wemo_engine::SetActionResult(0);
+
+    std::mutex mutex;
+    std::vector<std::pair<int, CommandStatus>> completed;
+    const auto record = [&](int which) {
+        return [&, which](const wemo_bridge::CommandResult & result) {
+            std::lock_guard<std::mutex> lock(mutex);
+            completed.emplace_back(which, result.status);
+        };
+    };
+    CHECK(adapter.SetOnOffAsync(a, true, record(0)));
+    CHECK(adapter.SetOnOffAsync(unknown, true, record(1)));
+    CHECK(adapter.SetLevelPercentAsync(wemo_bridge::DeviceHandle {}, 40, record(2)));
+    adapter.Shutdown();
+    fake_wemo_engine::SetActionResult(1);
+
+    // Every callback has run by the time Shutdown() returns.
+    std::sort(completed.begin(), completed.end());
+    REQUIRE(completed.size() == 3);
+    CHECK(completed[0].second == CommandStatus::kEngineError);
+    CHECK(completed[1].second == CommandStatus::kUnresolved);
+    CHECK(completed[2].second == CommandStatus::kInvalidHandle);
+
+    bool called = false;
+    CHECK(!adapter.SetOnOffAsync(a, false, [&](const wemo_bridge::CommandResult &) { called = true; }));
+    CHECK(!called);
+}
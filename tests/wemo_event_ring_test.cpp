@@ -0,0 +1,107 @@
+#include "test_harness.h"
+
+#include "wemo_bridge/wemo_event_ring.h"
+
+#include <atomic>
+#include <map>
+#include <thread>
+#include <vector>
+
+using wemo_bridge::WemoEventRing;
+using wemo_bridge::WemoStateEvent;
+
+namespace {
+
+WemoStateEvent Event(int wemo_id, int state, int level = -1, bool online = true)
+{
+    return WemoStateEvent { wemo_id, online, state, level };
+}
+
+} // namespace
+
+TEST_CASE(WemoEventRing_CoalescesPerDeviceInFirstChangeOrder)
+{
+    int scheduled = 0;
+    WemoEventRing ring(8, [&] { scheduled++; });
+    CHECK(ring.Publish(Event(5, 1, 40)));
+    CHECK(ring.Publish(Event(-3, 0)));
+    CHECK(ring.Publish(Event(5, 0, 70, false)));
+    CHECK_EQ(scheduled, 1);
+
+    std::vector<WemoStateEvent> applied;
+    CHECK_EQ(ring.Drain([&](const WemoStateEvent & ev) { applied.push_back(ev); }), 2u);
+    REQUIRE(applied.size() == 2);
+    CHECK_EQ(applied[0].wemo_id, 5);
+    CHECK_EQ(applied[0].state, 0);
+    CHECK_EQ(applied[0].level, 70);
+    CHECK(!applied[0].is_online);
+    CHECK_EQ(applied[1].wemo_id, -3);
+    CHECK_EQ(applied[1].level, -1);
+    CHECK(applied[1].is_online);
+
+    // Drained: nothing left, and the next event schedules again.
+    CHECK_EQ(ring.Drain([](const WemoStateEvent &) {}), 0u);
+    CHECK(ring.Publish(Event(5, 1)));
+    CHECK_EQ(scheduled, 2);
+}
+
+TEST_CASE(WemoEventRing_DropsWhenEverySlotIsTaken)
+{
+    WemoEventRing ring(4, [] {});
+    for (int id = 0; id < 4; id++)
+    {
+        CHECK(ring.Publish(Event(id, 1)));
+    }
+    CHECK(!ring.Publish(Event(99, 1)));
+    CHECK_EQ(ring.DroppedCount(), 1u);
+    // Known ids still get through.
+    CHECK(ring.Publish(Event(2, 0)));
+}
+
+TEST_CASE(WemoEventRing_ConcurrentProducersKeepNewestState)
+{
+    constexpr int kProducers = 4;
+    constexpr int kDevices   = 64;
+    constexpr int kRounds    = 2000;
+
+    std::atomic<int> scheduled { 0 };
+    WemoEventRing ring(kDevices, [&] { scheduled++; });
+    std::map<int, int> latest;
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducers; p++)
+    {
+        producers.emplace_back([&, p] {
+            // Each producer owns a quarter of the devices, so the last state
+            // it publishes for a device is that device's final state.
+            for (int round = 0; round < kRounds; round++)
+            {
+                for (int id = p; id < kDevices; id += kProducers)
+                {
+                    ring.Publish(Event(id, round));
+                }
+            }
+        });
+    }
+    std::atomic<bool> done { false };
+    std::thread consumer([&] {
+        while (!done.load())
+        {
+            ring.Drain([&](const WemoStateEvent & ev) { latest[ev.wemo_id] = ev.state; });
+        }
+    });
+    for (auto & producer : producers)
+    {
+        producer.join();
+    }
+    done = true;
+    consumer.join();
+    ring.Drain([&](const WemoStateEvent & ev) { latest[ev.wemo_id] = ev.state; });
+
+    CHECK_EQ(ring.DroppedCount(), 0u);
+    REQUIRE(latest.size() == static_cast<size_t>(kDevices));
+    for (const auto & entry : latest)
+    {
+        CHECK_EQ(entry.second, kRounds - 1);
+    }
+}